@@ -0,0 +1,22 @@
+#!/bin/bash
+
+# Unit tests for edge-adaptive oversampling
+
+# load environment-dependent definitions for CXXTESTGEN, CPP, etc.
+. ./define_unittest_vars.sh
+
+# 
+echo
+echo "Generating and compiling unit tests for edge-adaptive oversampling..."
+$CXXTESTGEN --error-printer -o test_runner_config.cpp unit_tests/unittest_adaptive_sampling.t.h
+$CPP -std=c++17 -o test_runner_config test_runner_config.cpp src/adaptive_sampling.cpp \
+-I. -Isrc -I/usr/local/include -I$CXXTEST
+if [ $? -eq 0 ]
+then
+  echo "Running unit tests for edge-adaptive oversampling:"
+  ./test_runner_config
+  exit
+else
+  echo "Compilation of unit tests for edge-adaptive oversampling failed."
+  exit 1
+fi
@@ -0,0 +1,22 @@
+#!/bin/bash
+
+# Unit tests for the denoising filter
+
+# load environment-dependent definitions for CXXTESTGEN, CPP, etc.
+. ./define_unittest_vars.sh
+
+# 
+echo
+echo "Generating and compiling unit tests for the denoising filter..."
+$CXXTESTGEN --error-printer -o test_runner_config.cpp unit_tests/unittest_denoise.t.h
+$CPP -std=c++17 -o test_runner_config test_runner_config.cpp src/denoise.cpp \
+-I. -Isrc -I/usr/local/include -I$CXXTEST
+if [ $? -eq 0 ]
+then
+  echo "Running unit tests for the denoising filter:"
+  ./test_runner_config
+  exit
+else
+  echo "Compilation of unit tests for the denoising filter failed."
+  exit 1
+fi
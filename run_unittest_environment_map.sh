@@ -0,0 +1,23 @@
+#!/bin/bash
+
+# Unit tests for environment maps
+
+# load environment-dependent definitions for CXXTESTGEN, CPP, etc.
+. ./define_unittest_vars.sh
+
+# 
+echo
+echo "Generating and compiling unit tests for environment maps..."
+$CXXTESTGEN --error-printer -o test_runner_config.cpp unit_tests/unittest_environment_map.t.h
+$CPP -std=c++17 -o test_runner_config test_runner_config.cpp src/environment_map.cpp \
+src/mipmap.cpp src/texture_file.cpp src/image_io.cpp src/utilities.cpp \
+-I. -Isrc -I/usr/local/include -I$CXXTEST -lIlmImf -lz -lpthread
+if [ $? -eq 0 ]
+then
+  echo "Running unit tests for environment maps:"
+  ./test_runner_config
+  exit
+else
+  echo "Compilation of unit tests for environment maps failed."
+  exit 1
+fi
@@ -9,8 +9,8 @@
 echo
 echo "Generating and compiling unit tests for image_io.h/cpp functions..."
 $CXXTESTGEN --error-printer -o test_runner_config.cpp unit_tests/unittest_image_io.t.h
-$CPP -std=c++11 -o test_runner_config test_runner_config.cpp src/image_io.cpp  \
--I. -I./src -I/usr/local/include -I$CXXTEST -lIlmImf
+$CPP -std=c++17 -o test_runner_config test_runner_config.cpp src/image_io.cpp src/exr_tile_writer.cpp \
+-I. -I./src -I/usr/local/include -I$CXXTEST -lIlmImf -lz -lpthread
 if [ $? -eq 0 ]
 then
   echo "Running unit tests for image_io.h/cpp functions:"
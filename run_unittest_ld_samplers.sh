@@ -0,0 +1,24 @@
+#!/bin/bash
+
+# Unit tests for the low-discrepancy sampler classes (SobolSampler, HaltonSampler,
+# CMJSampler)
+
+# load environment-dependent definitions for CXXTESTGEN, CPP, etc.
+. ./define_unittest_vars.sh
+
+# 
+echo
+echo "Generating and compiling unit tests for low-discrepancy sampler classes..."
+$CXXTESTGEN --error-printer -o test_runner_config.cpp unit_tests/unittest_ld_samplers.t.h
+$CPP -o test_runner_config test_runner_config.cpp src/sampler.cpp src/sobol_sampler.cpp \
+src/halton_sampler.cpp src/cmj_sampler.cpp src/low_discrepancy.cpp \
+-I. -I./src -I/usr/local/include -I$CXXTEST
+if [ $? -eq 0 ]
+then
+  echo "Running unit tests for low-discrepancy sampler classes:"
+  ./test_runner_config
+  exit
+else
+  echo "Compilation of unit tests for low-discrepancy sampler classes failed."
+  exit 1
+fi
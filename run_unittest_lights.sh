@@ -9,8 +9,9 @@
 echo
 echo "Generating and compiling unit tests for geometry.h classes..."
 $CXXTESTGEN --error-printer -o test_runner_config.cpp unit_tests/unittest_lights.t.h
-$CPP -std=c++11 -o test_runner_config test_runner_config.cpp  src/mersenne_twister.cpp \
-src/transform.cpp -I. -Isrc -I/usr/local/include -I$CXXTEST
+$CPP -std=c++17 -o test_runner_config test_runner_config.cpp  src/mersenne_twister.cpp \
+src/transform.cpp src/environment_map.cpp src/mipmap.cpp src/texture_file.cpp src/image_io.cpp \
+src/utilities.cpp -I. -Isrc -I/usr/local/include -I$CXXTEST -lIlmImf -lz -lpthread
 if [ $? -eq 0 ]
 then
   echo "Running unit tests for lights.h classes:"
@@ -0,0 +1,22 @@
+#!/bin/bash
+
+# Unit tests for the low-discrepancy sampling code
+
+# load environment-dependent definitions for CXXTESTGEN, CPP, etc.
+. ./define_unittest_vars.sh
+
+# 
+echo
+echo "Generating and compiling unit tests for the low-discrepancy sampling code..."
+$CXXTESTGEN --error-printer -o test_runner_config.cpp unit_tests/unittest_low_discrepancy.t.h
+$CPP -std=c++17 -o test_runner_config test_runner_config.cpp src/low_discrepancy.cpp \
+-I. -Isrc -I/usr/local/include -I$CXXTEST
+if [ $? -eq 0 ]
+then
+  echo "Running unit tests for the low-discrepancy sampling code:"
+  ./test_runner_config
+  exit
+else
+  echo "Compilation of unit tests for the low-discrepancy sampling code failed."
+  exit 1
+fi
@@ -0,0 +1,22 @@
+#!/bin/bash
+
+# Unit tests for the MipMap class
+
+# load environment-dependent definitions for CXXTESTGEN, CPP, etc.
+. ./define_unittest_vars.sh
+
+# 
+echo
+echo "Generating and compiling unit tests for MipMap class..."
+$CXXTESTGEN --error-printer -o test_runner_config.cpp unit_tests/unittest_mipmap.t.h
+$CPP -std=c++17 -o test_runner_config test_runner_config.cpp src/mipmap.cpp src/texture_file.cpp \
+-I. -Isrc -I/usr/local/include -I$CXXTEST
+if [ $? -eq 0 ]
+then
+  echo "Running unit tests for MipMap class:"
+  ./test_runner_config
+  exit
+else
+  echo "Compilation of unit tests for MipMap class failed."
+  exit 1
+fi
@@ -0,0 +1,28 @@
+#!/bin/bash
+
+# Unit tests for render.cpp (image I/O and visibility-only rendering)
+
+# load environment-dependent definitions for CXXTESTGEN, CPP, etc.
+. ./define_unittest_vars.sh
+
+# 
+echo
+echo "Generating and compiling unit tests for render.cpp..."
+$CXXTESTGEN --error-printer -o test_runner_config.cpp unit_tests/unittest_render.t.h
+$CPP -std=c++17 -fopenmp -o test_runner_config test_runner_config.cpp src/render.cpp \
+src/render_utils.cpp src/shapes.cpp src/transform.cpp src/cameras.cpp src/sampler.cpp \
+src/uniform_sampler.cpp src/uniform_jitter_sampler.cpp src/sobol_sampler.cpp \
+src/halton_sampler.cpp src/cmj_sampler.cpp src/low_discrepancy.cpp src/mersenne_twister.cpp \
+src/scenefile_parser.cpp src/environment_map.cpp src/mipmap.cpp src/texture_file.cpp \
+src/light_bvh.cpp src/tile_lights.cpp src/denoise.cpp src/adaptive_sampling.cpp src/aovs.cpp \
+src/exr_tile_writer.cpp src/image_io.cpp src/utilities.cpp \
+-I. -Isrc -I/usr/local/include -I$CXXTEST -lyaml-cpp -lIlmImf -lz -lpthread
+if [ $? -eq 0 ]
+then
+  echo "Running unit tests for render.cpp:"
+  ./test_runner_config
+  exit
+else
+  echo "Compilation of unit tests for render.cpp failed."
+  exit 1
+fi
@@ -9,7 +9,7 @@
 echo
 echo "Generating and compiling unit tests for UniformSampler class..."
 $CXXTESTGEN --error-printer -o test_runner_config.cpp unit_tests/unittest_uniform_sampler.t.h
-$CPP -o test_runner_config test_runner_config.cpp src/sampler.cpp src/uniform_sampler.cpp \
+$CPP -o test_runner_config test_runner_config.cpp src/sampler.cpp src/uniform_sampler.cpp src/low_discrepancy.cpp \
 -I. -I./src -I/usr/local/include -I$CXXTEST
 if [ $? -eq 0 ]
 then
@@ -0,0 +1,25 @@
+#!/bin/bash
+
+# Unit tests for per-tile light lists
+
+# load environment-dependent definitions for CXXTESTGEN, CPP, etc.
+. ./define_unittest_vars.sh
+
+# 
+echo
+echo "Generating and compiling unit tests for per-tile light lists..."
+$CXXTESTGEN --error-printer -o test_runner_config.cpp unit_tests/unittest_tile_lights.t.h
+$CPP -std=c++17 -o test_runner_config test_runner_config.cpp src/tile_lights.cpp \
+src/light_bvh.cpp src/cameras.cpp src/render_utils.cpp src/shapes.cpp src/transform.cpp \
+src/mersenne_twister.cpp src/environment_map.cpp src/mipmap.cpp src/texture_file.cpp \
+src/image_io.cpp src/utilities.cpp \
+-I. -Isrc -I/usr/local/include -I$CXXTEST -lyaml-cpp -lIlmImf -lz -lpthread
+if [ $? -eq 0 ]
+then
+  echo "Running unit tests for per-tile light lists:"
+  ./test_runner_config
+  exit
+else
+  echo "Compilation of unit tests for per-tile light lists failed."
+  exit 1
+fi
@@ -0,0 +1,80 @@
+// Code for edge-adaptive oversampling.
+//
+// The color test catches edges which the first-hit features don't show (shadow
+// edges, noise in soft shadows, environment-map details). Colors are compared
+// after clamping to [0,1] and taking the square root, a rough stand-in for the
+// display gamma, so that differences in dark regions aren't ignored.
+
+#include <math.h>
+#include <vector>
+#include <stdint.h>
+
+#include "color.h"
+#include "geometry.h"
+#include "trace_context.h"
+#include "adaptive_sampling.h"
+
+using namespace std;
+
+const float  REFINE_NORMAL_COS = 0.95;   // normals differing by more than ~18 deg
+const float  REFINE_DEPTH_FRACTION = 0.1;   // relative difference in depth
+const float  REFINE_COLOR_DIFFERENCE = 0.1;   // difference in sqrt(color)
+
+
+static inline Color DisplayColor( const Color &c )
+{
+  return Color(sqrtf(fminf(fmaxf(c.r, 0.0), 1.0)), sqrtf(fminf(fmaxf(c.g, 0.0), 1.0)),
+  				sqrtf(fminf(fmaxf(c.b, 0.0), 1.0)));
+}
+
+
+// Returns true if the first-pass results for pixels i and j differ enough that
+// we should oversample them
+static bool PixelsDiffer( int i, int j, const pixelFeatures *features,
+						const vector<Color> &displayColors )
+{
+  const pixelFeatures &f_i = features[i];
+  const pixelFeatures &f_j = features[j];
+  if (f_i.shapeIndex != f_j.shapeIndex)
+    return true;
+  if (f_i.shapeIndex >= 0) {
+    if (Dot(f_i.normal, f_j.normal) < REFINE_NORMAL_COS)
+      return true;
+    if (fabsf(f_i.depth - f_j.depth) > REFINE_DEPTH_FRACTION*fminf(f_i.depth, f_j.depth))
+      return true;
+  }
+  Color  difference = displayColors[i] - displayColors[j];
+  return (fmaxf(fabsf(difference.r), fmaxf(fabsf(difference.g), fabsf(difference.b)))
+  			> REFINE_COLOR_DIFFERENCE);
+}
+
+
+int FindPixelsToRefine( const Color *image, const pixelFeatures *features, int width,
+						int height, vector<uint8_t> &refine )
+{
+  int  nPixels = width*height;
+  vector<Color>  displayColors(nPixels);
+  for (int i = 0; i < nPixels; i++)
+    displayColors[i] = DisplayColor(image[i]);
+
+  refine.assign(nPixels, 0);
+  int  nRefine = 0;
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      int  i = y*width + x;
+      bool  refineThis = features[i].specularHit;
+      for (int yy = y - 1; (yy <= y + 1) && (! refineThis); yy++) {
+        for (int xx = x - 1; (xx <= x + 1) && (! refineThis); xx++) {
+          if ((xx < 0) || (xx >= width) || (yy < 0) || (yy >= height) || ((xx == x) && (yy == y)))
+            continue;
+          refineThis = PixelsDiffer(i, yy*width + xx, features, displayColors);
+        }
+      }
+      if (refineThis) {
+        refine[i] = 1;
+        nRefine++;
+      }
+    }
+  }
+  return nRefine;
+}
@@ -0,0 +1,24 @@
+// Code for edge-adaptive oversampling: deciding which pixels of a first-pass
+// image (one ray per pixel) need the full oversampling rate.
+
+#ifndef _ADAPTIVE_SAMPLING_H_
+#define _ADAPTIVE_SAMPLING_H_
+
+#include <vector>
+#include <stdint.h>
+
+#include "color.h"
+#include "trace_context.h"
+
+
+/// Sets refine[i] = 1 for pixels which should be oversampled, and 0 for the rest;
+/// returns the number of pixels to be oversampled. image and features are the
+/// result of a first pass with one ray per pixel (with normalized features).
+/// Pixels are oversampled if they see a reflective or refractive surface, or if
+/// any of their 8 neighbors sees a different shape, or differs strongly in surface
+/// normal, depth, or (displayed) color.
+int FindPixelsToRefine( const Color *image, const pixelFeatures *features, int width,
+						int height, std::vector<uint8_t> &refine );
+
+
+#endif  // _ADAPTIVE_SAMPLING_H_
@@ -0,0 +1,170 @@
+// Code for AOVs ("arbitrary output variables").
+//
+// The lighting AOVs are first-hit decompositions of the beauty image: direct =
+// lighting of diffuse surfaces seen by camera rays (optionally split by light),
+// indirect = whatever reflective/refractive surfaces seen by camera rays pass on
+// (including any lighting further along the reflected/refracted rays), emission,
+// and background = environment seen directly. All are averaged over the pixel's
+// subsamples, so direct + indirect + emission + background = beauty image (before
+// any denoising).
+//
+// EXR layer and channel names follow the usual conventions: "R", "G", "B", "A" for
+// the beauty image, "<layer>.R" etc. for color AOVs, "normal.X/Y/Z", "depth.Z",
+// and "id.V" for object IDs. The lights' layers are named "light0", "light1", ...
+// (in scene-file order).
+
+#include <string>
+#include <vector>
+
+#include "definitions.h"
+#include "color.h"
+#include "geometry.h"
+#include "trace_context.h"
+#include "image_io.h"
+#include "utilities_pub.h"
+#include "aovs.h"
+
+using namespace std;
+
+
+int ParseAOVNames( const string &aovNames )
+{
+  vector<string>  names;
+  int  aovFlags = 0;
+
+  SplitString(aovNames, names, ",");
+  if (names.size() == 0)
+    return -1;
+  for (const string &name : names) {
+    if (name == "albedo")
+      aovFlags |= AOV_ALBEDO;
+    else if (name == "normal")
+      aovFlags |= AOV_NORMAL;
+    else if (name == "depth")
+      aovFlags |= AOV_DEPTH;
+    else if (name == "id")
+      aovFlags |= AOV_OBJECT_ID;
+    else if (name == "direct")
+      aovFlags |= AOV_DIRECT;
+    else if (name == "indirect")
+      aovFlags |= AOV_INDIRECT;
+    else if (name == "emission")
+      aovFlags |= AOV_EMISSION;
+    else if (name == "background")
+      aovFlags |= AOV_BACKGROUND;
+    else if (name == "lights")
+      aovFlags |= AOV_LIGHTS;
+    else if (name == "all")
+      aovFlags |= AOV_ALL;
+    else
+      return -1;
+  }
+  return aovFlags;
+}
+
+
+
+AOVBuffers::AOVBuffers( int aovFlags, int width, int height, int nLights )
+  : flags(aovFlags), nPixels(width*height), nLights(nLights), nLightingTerms(0)
+{
+  features.resize(nPixels);
+  if (flags & (AOV_DIRECT | AOV_INDIRECT | AOV_EMISSION | AOV_BACKGROUND | AOV_LIGHTS)) {
+    nLightingTerms = N_LIGHTING_COMPONENTS;
+    if (flags & AOV_LIGHTS)
+      nLightingTerms += nLights;
+    lighting.resize(nPixels*nLightingTerms);
+  }
+}
+
+
+void AOVBuffers::ClearLighting( int i )
+{
+  for (int n = 0; n < nLightingTerms; n++)
+    lighting[i*nLightingTerms + n] = Color(0);
+}
+
+
+void AOVBuffers::NormalizeLighting( int i, int nSubsamples )
+{
+  float  scale = 1.0 / nSubsamples;
+  for (int n = 0; n < nLightingTerms; n++)
+    lighting[i*nLightingTerms + n] *= scale;
+}
+
+
+// Adds the three channels of a color (starting at rgb) to channels
+static void AddColorChannels( const string &layer, const float *rgb, size_t xStride,
+							vector<exrChannel> &channels )
+{
+  const char  *suffixes[3] = {"R", "G", "B"};
+  for (int k = 0; k < 3; k++) {
+    exrChannel  channel;
+    channel.name = (layer == "") ? suffixes[k] : layer + "." + suffixes[k];
+    channel.data = rgb + k;
+    channel.xStride = xStride;
+    channels.push_back(channel);
+  }
+}
+
+
+void AOVBuffers::GetEXRChannels( const Color *image, vector<exrChannel> &channels )
+{
+  const size_t  featureStride = sizeof(pixelFeatures);
+  const size_t  lightingStride = nLightingTerms*sizeof(Color);
+  exrChannel  channel;
+
+  channels.clear();
+  AddColorChannels("", &image[0].r, sizeof(Color), channels);
+  channel.name = "A";
+  channel.data = &features[0].coverage;
+  channel.xStride = featureStride;
+  channels.push_back(channel);
+
+  if (flags & AOV_ALBEDO)
+    AddColorChannels("albedo", &features[0].albedo.r, featureStride, channels);
+  if (flags & AOV_NORMAL) {
+    const char  *normalNames[3] = {"normal.X", "normal.Y", "normal.Z"};
+    for (int k = 0; k < 3; k++) {
+      channel.name = normalNames[k];
+      channel.data = &features[0].normal.x + k;
+      channel.xStride = featureStride;
+      channels.push_back(channel);
+    }
+  }
+  if (flags & AOV_DEPTH) {
+    depth.resize(nPixels);
+    for (int i = 0; i < nPixels; i++)
+      depth[i] = (features[i].coverage > 0.0) ? features[i].depth : kInfinity;
+    channel.name = "depth.Z";
+    channel.data = depth.data();
+    channel.xStride = sizeof(float);
+    channel.fullFloat = true;
+    channels.push_back(channel);
+  }
+  if (flags & AOV_OBJECT_ID) {
+    objectIDs.resize(nPixels);
+    for (int i = 0; i < nPixels; i++)
+      objectIDs[i] = features[i].shapeIndex + 1;
+    channel.name = "id.V";
+    channel.data = objectIDs.data();
+    channel.xStride = sizeof(float);
+    channel.fullFloat = true;
+    channels.push_back(channel);
+  }
+
+  if (nLightingTerms > 0) {
+    if (flags & AOV_DIRECT)
+      AddColorChannels("direct", &lighting[LIGHTING_DIRECT].r, lightingStride, channels);
+    if (flags & AOV_INDIRECT)
+      AddColorChannels("indirect", &lighting[LIGHTING_INDIRECT].r, lightingStride, channels);
+    if (flags & AOV_EMISSION)
+      AddColorChannels("emission", &lighting[LIGHTING_EMISSION].r, lightingStride, channels);
+    if (flags & AOV_BACKGROUND)
+      AddColorChannels("background", &lighting[LIGHTING_BACKGROUND].r, lightingStride, channels);
+    if (flags & AOV_LIGHTS) {
+      for (int n = 0; n < nLights; n++)
+        AddColorChannels("light" + to_string(n), &lighting[N_LIGHTING_COMPONENTS + n].r,
+        				lightingStride, channels);
+    }
+  }
+}
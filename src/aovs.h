@@ -0,0 +1,85 @@
+// Code for AOVs ("arbitrary output variables"): extra per-pixel images -- depth,
+// normals, albedo, object IDs, and the lighting split into its components --
+// produced by the same render as the main ("beauty") image, and saved along with
+// it as layers of a single multi-channel OpenEXR file.
+
+#ifndef _AOVS_H_
+#define _AOVS_H_
+
+#include <string>
+#include <vector>
+
+#include "color.h"
+#include "trace_context.h"
+#include "image_io.h"
+
+
+// AOVs which can be requested (bit flags)
+const int  AOV_ALBEDO = 1;
+const int  AOV_NORMAL = 2;
+const int  AOV_DEPTH = 4;
+const int  AOV_OBJECT_ID = 8;
+const int  AOV_DIRECT = 16;   // lighting of diffuse surfaces seen by camera rays
+const int  AOV_INDIRECT = 32;   // light reflected/refracted by surfaces seen by camera rays
+const int  AOV_EMISSION = 64;
+const int  AOV_BACKGROUND = 128;   // environment seen directly by camera rays
+const int  AOV_LIGHTS = 256;   // direct lighting from each light separately
+const int  AOV_ALL = 511;
+
+// Lighting components which RayTrace() adds to for camera rays; they add up to the
+// beauty image. The contributions of the individual lights (if requested) follow
+// these, and add up to LIGHTING_DIRECT.
+const int  LIGHTING_DIRECT = 0;
+const int  LIGHTING_INDIRECT = 1;
+const int  LIGHTING_EMISSION = 2;
+const int  LIGHTING_BACKGROUND = 3;
+const int  N_LIGHTING_COMPONENTS = 4;
+
+
+/// Converts a comma-separated list of AOV names ("albedo", "normal", "depth", "id",
+/// "direct", "indirect", "emission", "background", "lights", or "all") into bit
+/// flags; returns -1 if any name isn't recognized
+int ParseAOVNames( const std::string &aovNames );
+
+
+class AOVBuffers
+{
+  public:
+    AOVBuffers( int aovFlags, int width, int height, int nLights );
+
+    bool Requested( int aovFlag ) const { return ((flags & aovFlag) != 0); };
+
+    /// First-hit features of each pixel (always recorded, since the coverage
+    /// supplies the alpha channel)
+    pixelFeatures * Features( ) { return features.data(); };
+
+    /// Number of lighting terms per pixel (0 if no lighting AOVs were requested)
+    int NLightingTerms( ) const { return nLightingTerms; };
+    /// Lighting terms of pixel i (NULL if no lighting AOVs were requested)
+    Color * Lighting( int i )
+    { return (nLightingTerms > 0) ? &lighting[i*nLightingTerms] : nullptr; };
+
+    /// Resets the lighting sums of pixel i (before it's rendered)
+    void ClearLighting( int i );
+    /// Converts the lighting sums of pixel i into means over its subsamples
+    void NormalizeLighting( int i, int nSubsamples );
+
+    /// Fills in channels with the beauty image (R,G,B; alpha = coverage) plus the
+    /// requested AOVs, ready for SaveImageOpenEXRChannels. Depths (Z) and object
+    /// IDs (shape index + 1, 0 = background) are 32-bit float channels; the
+    /// background has depth = kInfinity. The channels point into image and into
+    /// this object, so both must outlive them.
+    void GetEXRChannels( const Color *image, std::vector<exrChannel> &channels );
+
+  private:
+    int  flags;
+    int  nPixels;
+    int  nLights;
+    int  nLightingTerms;
+    std::vector<pixelFeatures>  features;
+    std::vector<Color>  lighting;   // nLightingTerms values per pixel
+    std::vector<float>  depth, objectIDs;   // filled in by GetEXRChannels
+};
+
+
+#endif  // _AOVS_H_
@@ -0,0 +1,77 @@
+// Code for camera classes (currently, just the Aperture class).
+
+#include <math.h>
+#include <stdlib.h>
+#include <string>
+
+#include "definitions.h"
+#include "geometry.h"
+#include "render_utils.h"
+#include "cameras.h"
+
+
+Aperture::Aperture( float radius )
+{
+  apertureRadius = radius;
+  apertureType = APERTURE_CIRCLE;
+  nSides = 0;
+  polygonVertices = NULL;
+  triangleCDF = NULL;
+  verticesAllocated = false;
+}
+
+
+Aperture::~Aperture( )
+{
+  if (verticesAllocated) {
+    free(polygonVertices);
+    free(triangleCDF);
+  }
+}
+
+
+void Aperture::SetApertureShape( std::string apShapeName, int nBlades, float rotation )
+{
+  if (verticesAllocated) {
+    free(polygonVertices);
+    free(triangleCDF);
+    verticesAllocated = false;
+  }
+  if (apShapeName == APERTURE_NAME_POLYGON) {
+    apertureType = APERTURE_POLYGON;
+    nSides = nBlades;
+    polygonVertices = MakePolygonVertices(nSides, rotation);
+    // precompute the table used to pick triangles for sampling
+    triangleCDF = (float *)calloc((size_t)(nSides + 1), sizeof(float));
+    MakePolygonTriangleCDF(nSides, polygonVertices, triangleCDF);
+    verticesAllocated = true;
+  }
+  else {
+    apertureType = APERTURE_CIRCLE;
+    nSides = 0;
+  }
+}
+
+
+// Returns newly allocated array of (x,y) coordinates for the vertices of a
+// regular polygon inscribed in the unit circle, with the first vertex at
+// angle rot (degrees) from the x-axis
+float * Aperture::MakePolygonVertices( int nSides, float rot )
+{
+  float *vertices = (float *)calloc((size_t)(2*nSides), sizeof(float));
+  for (int i = 0; i < nSides; i++) {
+    float  theta = rot*DEG2RAD + TWO_PI*i/nSides;
+    vertices[2*i] = cos(theta);
+    vertices[2*i + 1] = sin(theta);
+  }
+  return vertices;
+}
+
+
+Vector Aperture::GetLensOffsetVector( float u, float v ) const
+{
+  if (apertureType == APERTURE_POLYGON)
+    return apertureRadius*UnitPolygon_Sample(u, v, nSides, polygonVertices, triangleCDF);
+  else
+    return apertureRadius*UnitDisk_ConcentricSample(u, v);
+}
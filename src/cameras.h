@@ -12,6 +12,9 @@
 #include "sampler.h"
 #include "uniform_sampler.h"
 #include "uniform_jitter_sampler.h"
+#include "sobol_sampler.h"
+#include "halton_sampler.h"
+#include "cmj_sampler.h"
 #include "render_utils.h"
 
 
@@ -38,13 +41,16 @@ public:
 
   void SetApertureShape( std::string apShapeName, int nBlades=6, float rotation=0.0 );
 
-  Vector GetLensOffsetVector( );
+  /// Returns offset of a point on the aperture from its center, given uniform
+  /// sample (u,v) in [0,1)^2
+  Vector GetLensOffsetVector( float u, float v ) const;
 
 private:
   float apertureRadius;
   int  apertureType;
   int  nSides;
   float *polygonVertices;
+  float *triangleCDF;   // cumulative area fractions of the polygon's triangle fan
   bool  verticesAllocated;
   
   float * MakePolygonVertices( int nSides, float rot=0.0 );
@@ -55,6 +61,9 @@ private:
 
 // For now, we'll make this a concrete class; later we can make it into an
 // abstract base class and have subclasses.
+// Once set up (SetSampling, etc.), the camera is not modified during rendering:
+// ray generation is const and depends only on the pixel, the subsample number,
+// and the pixel seed, so it's safe to call from multiple threads.
 
 class Camera
 {
@@ -87,8 +96,10 @@ public:
   /// If subsampling is being done, then the camera object's Sampler instance
   /// is called to produce appropriate image-plane sub-pixel offsets for x and y,
   /// for the current subsampleNumber; these are returned in x_out and y_out.
+  /// (pixelSeed is used by samplers which decorrelate their patterns between
+  /// pixels.)
   Ray GenerateCameraRay( float x_pix, float y_pix, int subsampleNumber,
-  							float *x_out, float *y_out )
+  							uint32_t pixelSeed, float *x_out, float *y_out ) const
   {
     // We start with a 2D image-plane ("raster space") coordinate (x_pix,y_pix); we want
     // to convert this to a coordinate in 3D camera space.
@@ -108,29 +119,69 @@ public:
     //    y_cam = y_scrn * thanTheta
     //    z_cam = -1
     float  xOff, yOff, x, y;
-    sampler->GetOffsetCoords(subsampleNumber, &xOff, &yOff);
+    sampler->GetOffsetCoords(subsampleNumber, pixelSeed, &xOff, &yOff);
     x = x_pix + xOff;
     y = y_pix + yOff;
 
-    float  x_world = (2*((x + 0.5)*invWidth) - 1.0) * tanTheta * aspectRatio;
-    float  y_world = (1.0 - 2*((y + 0.5)*invHeight)) * tanTheta;
-
-	Ray cameraRay(Point(0), Point(x_world, y_world, -1.0), 0);
+    Vector  imageDir = ImagePlaneDirection(x + 0.5, y + 0.5);
+	Ray cameraRay(Point(0), Point(imageDir.x, imageDir.y, imageDir.z), 0);
+	// ray-cone footprint: the angle subtended by one subsample (at image center)
+	cameraRay.coneSpread = 2.0*tanTheta*invHeight / sqrtf((float)nSubsamples);
     *x_out = x;
     *y_out = y;
 	return cameraRay;
   }
   
-  /// Generate a random point within the idealized thin lens
+  /// Generate a single camera ray through the center of pixel (x_pix,y_pix), ignoring
+  /// the sampler (e.g., for a quick first pass with one ray per pixel)
+  Ray GeneratePixelCenterRay( int x_pix, int y_pix ) const
+  {
+    Vector  imageDir = ImagePlaneDirection(x_pix + 0.5, y_pix + 0.5);
+	Ray cameraRay(Point(0), Point(imageDir.x, imageDir.y, imageDir.z), 0);
+	// ray-cone footprint: the angle subtended by the whole pixel
+	cameraRay.coneSpread = 2.0*tanTheta*invHeight;
+	return cameraRay;
+  }
+  
+  /// Direction (not normalized) from the (pinhole) camera through position (x,y)
+  /// on the image plane, in pixel units, with (0,0) = upper-left corner of the image
+  Vector ImagePlaneDirection( double x, double y ) const
+  {
+    float  x_world = (2*(x*invWidth) - 1.0) * tanTheta * aspectRatio;
+    float  y_world = (1.0 - 2*(y*invHeight)) * tanTheta;
+    return Vector(x_world, y_world, -1.0);
+  }
+
+  /// Generate a point within the idealized thin lens, given uniform sample
+  /// (u,v) in [0,1)^2 (e.g., from the sampler's lens dimension)
   /// Intended to be called by e.g. RenderImage()
-  Point GenerateLensPoint( )
+  Point GenerateLensPoint( float u, float v ) const
   {
     // the reference point which we offset from is always the nominal pinhole/origin 
     // point at (0,0,0)
     Point origin(0);
-    Vector offset = theAperture->GetLensOffsetVector();
+    Vector offset = theAperture->GetLensOffsetVector(u, v);
     return origin + offset;
   }
+
+  /// Converts a pinhole camera ray into a depth-of-field ray: the new ray starts
+  /// from a point on the lens (chosen with the sampler's lens dimension) and passes
+  /// through the point where the pinhole ray meets the plane of focus
+  Ray GenerateLensRay( const Ray &pinholeRay, int subsampleNumber, uint32_t pixelSeed ) const
+  {
+    // Determine intersection of pinholeRay with focalDistance plane
+    // (pinholeRay.dir.z is < 0, so we need to take negative of that to
+    // get positive distance value)
+    float  dist_to_focalPlane = focalDistance / (-pinholeRay.dir.z);
+    Point focalPoint = pinholeRay(dist_to_focalPlane);
+    // Pick point on camera "lens"
+    float  uLens, vLens;
+    sampler->GetSample2D(subsampleNumber, SAMPLE_DIMENSION_LENS, pixelSeed, &uLens, &vLens);
+    Point lensOffsetPoint = GenerateLensPoint(uLens, vLens);
+    Ray lensRay(lensOffsetPoint, focalPoint - lensOffsetPoint);
+    lensRay.coneSpread = pinholeRay.coneSpread;
+    return lensRay;
+  }
   
   void SetImageSize( int width, int height )
   { 
@@ -158,21 +209,26 @@ public:
     theAperture->SetApertureShape(apertureShapeName, nBlades, rotation);
   };
 
-  void SetSampling( int oversampling, const std::string &oversamplerName )
+  /// Sets up the sampler; nPixelSamples = total number of subsamples per pixel
+  /// for the low-discrepancy samplers (if = 0, oversampling^2 is used)
+  void SetSampling( int oversampling, const std::string &oversamplerName, 
+  					int nPixelSamples=0 )
   {
     oversampleRate = oversampling;
+    nSubsamples = (nPixelSamples > 0) ? nPixelSamples : oversampling*oversampling;
     if (oversamplerName == SAMPLER_UNIFORM)
       sampler = make_unique<UniformSampler>(oversampleRate);
     else if (oversamplerName == SAMPLER_UNIFORM_JITTER)
       sampler = make_unique<UniformJitterSampler>(oversampleRate);
+    else if (oversamplerName == SAMPLER_SOBOL)
+      sampler = make_unique<SobolSampler>(nSubsamples);
+    else if (oversamplerName == SAMPLER_HALTON)
+      sampler = make_unique<HaltonSampler>(nSubsamples);
+    else if (oversamplerName == SAMPLER_CMJ)
+      sampler = make_unique<CMJSampler>(nSubsamples);
   };
   
-  void UpdateSampler( )
-  {
-    sampler->Update();
-  };
-  
-  int GetType( )
+  int GetType( ) const
   { 
     return cameraType; 
   };
@@ -186,7 +242,6 @@ public:
   float aspectRatio;
   float focalDistance;
   float apertureRadius;
-  bool samplerAllocated = false;
   int oversampleRate = 1;
   int nSubsamples = 1;
   unique_ptr<Sampler> sampler;
@@ -0,0 +1,122 @@
+// Sampler which generates subsample positions using correlated multi-jittered
+// sampling, following Kensler (2013), "Correlated Multi-Jittered Sampling",
+// Pixar Technical Memo 13-01. The N samples are placed on an m x n grid
+// (m*n >= N, as close to square as possible), so that there is one sample in
+// each row and column of the fine N x N grid; the permutations and jitter
+// come from hash functions, so no per-pattern storage is needed and any
+// number of samples (not just squares) can be used.
+
+#include <assert.h>
+#include <math.h>
+#include "sampler.h"
+#include "cmj_sampler.h"
+#include "low_discrepancy.h"
+
+
+// Returns a pseudo-random permutation of i within [0, l), determined by p
+static uint32_t PermuteIndex( uint32_t i, const uint32_t l, const uint32_t p )
+{
+  uint32_t  w = l - 1;
+  w |= w >> 1;
+  w |= w >> 2;
+  w |= w >> 4;
+  w |= w >> 8;
+  w |= w >> 16;
+  // cycle-walk until we land inside [0, l)
+  do {
+    i ^= p;
+    i *= 0xe170893d;
+    i ^= p >> 16;
+    i ^= (i & w) >> 4;
+    i ^= p >> 8;
+    i *= 0x0929eb3f;
+    i ^= p >> 23;
+    i ^= (i & w) >> 1;
+    i *= 1 | p >> 27;
+    i *= 0x6935fa69;
+    i ^= (i & w) >> 11;
+    i *= 0x74dcb303;
+    i ^= (i & w) >> 2;
+    i *= 0x9e501cc3;
+    i ^= (i & w) >> 2;
+    i *= 0xc860a3df;
+    i &= w;
+    i ^= i >> 5;
+  } while (i >= l);
+  return (i + p) % l;
+}
+
+
+// Returns a pseudo-random float in [0,1), determined by i and p
+static float RandomFloat( uint32_t i, const uint32_t p )
+{
+  i ^= p;
+  i ^= i >> 17;
+  i ^= i >> 10;
+  i *= 0xb36534e5;
+  i ^= i >> 12;
+  i ^= i >> 21;
+  i *= 0x93fc4795;
+  i ^= 0xdf6e307f;
+  i ^= i >> 17;
+  i *= 1 | p >> 18;
+  return i * (1.0f / 4294967808.0f);
+}
+
+
+void CorrelatedMultiJitter( int s, const int nSamples, const uint32_t patternSeed,
+							float *u, float *v )
+{
+  int  m = (int)sqrtf((float)nSamples);
+  int  n = (nSamples + m - 1) / m;
+
+  s = PermuteIndex(s, nSamples, patternSeed*0x51633e2d);
+  int  sx = PermuteIndex(s % m, m, patternSeed*0x68bc21eb);
+  int  sy = PermuteIndex(s / m, n, patternSeed*0x02e5be93);
+  float  jx = RandomFloat(s, patternSeed*0x967a889b);
+  float  jy = RandomFloat(s, patternSeed*0x368cc8b7);
+  *u = (sx + (sy + jx) / n) / m;
+  *v = (s + jy) / nSamples;
+}
+
+
+CMJSampler::CMJSampler( const int nSamples )
+{
+  nSamples2D = nSamples;
+  nSamples1D = (int)ceil(sqrt((double)nSamples));
+  offsetsAllocated = false;
+}
+
+
+CMJSampler::~CMJSampler( )
+{
+  ;
+}
+
+
+void CMJSampler::GetOffsetCoords( const int n, float *xOffset, float *yOffset ) const
+{
+  GetOffsetCoords(n, 0, xOffset, yOffset);
+}
+
+
+void CMJSampler::GetOffsetCoords( const int n, const uint32_t pixelSeed, float *xOffset, 
+									float *yOffset ) const
+{
+  assert ((n >= 0) && (n < nSamples2D));
+
+  GetSample2D(n, SAMPLE_DIMENSION_PIXEL, pixelSeed, xOffset, yOffset);
+  *xOffset -= 0.5;
+  *yOffset -= 0.5;
+}
+
+
+/// Sample numbers >= NSamples() (e.g., for multiple light samples per subsample)
+/// continue with a new, independent pattern for each block of NSamples()
+void CMJSampler::GetSample2D( const int n, const int dimension, const uint32_t seed, 
+								float *u, float *v ) const
+{
+  int  patternNumber = n / nSamples2D;
+  uint32_t  patternSeed = HashCombine(HashCombine(seed, dimension), patternNumber);
+  CorrelatedMultiJitter(n % nSamples2D, nSamples2D, patternSeed, u, v);
+}
@@ -0,0 +1,41 @@
+// Header file for Sampler subclass which uses correlated multi-jittered
+// sampling for subsamples within each pixel.
+
+#ifndef _CMJ_SAMPLER_H_
+#define _CMJ_SAMPLER_H_
+
+#include <stdint.h>
+#include "sampler.h"
+
+
+/// Sample number s of an nSamples-point correlated multi-jittered pattern, with
+/// the pattern determined by patternSeed; returns (u,v) in [0,1) x [0,1)
+void CorrelatedMultiJitter( int s, const int nSamples, const uint32_t patternSeed,
+							float *u, float *v );
+
+
+class CMJSampler : public Sampler
+{ 
+public:
+
+  /// nSamples = total number of subsamples per pixel (any positive integer)
+  CMJSampler( const int nSamples=1 );
+  ~CMJSampler( );
+
+  using Sampler::GetOffsetCoords;
+
+  /// Computes offset in x and y xOffset, yOffset for sample number n (fixed pattern)
+  void GetOffsetCoords( const int n, float *xOffset, float *yOffset ) const;
+
+  /// Computes offset in x and y xOffset, yOffset for sample number n, with the
+  /// pattern determined by pixelSeed
+  void GetOffsetCoords( const int n, const uint32_t pixelSeed, float *xOffset, 
+  						float *yOffset ) const;
+
+  /// Computes 2D sample (u,v) for sample number n of the specified sampling dimension
+  void GetSample2D( const int n, const int dimension, const uint32_t seed, 
+  					float *u, float *v ) const;
+}; 
+
+
+#endif  // _CMJ_SAMPLER_H_
@@ -66,4 +66,17 @@ class Color
 };
 
 
+// Relative luminance (Rec. 709 weights) of a linear color
+inline float Luminance( const Color &c )
+{
+  return 0.2126f*c.r + 0.7152f*c.g + 0.0722f*c.b;
+}
+
+// Largest of the three channels
+inline float MaxComponent( const Color &c )
+{
+  return fmaxf(c.r, fmaxf(c.g, c.b));
+}
+
+
 #endif  // _COLOR_H_
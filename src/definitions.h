@@ -18,6 +18,7 @@ const int LIGHT_POINT = 1;
 const int LIGHT_DISTANT = 2;
 const int LIGHT_SPHERE = 10;
 const int LIGHT_RECT = 11;
+const int LIGHT_ENVIRONMENT = 20;
 
 
 // image formats
@@ -28,11 +29,17 @@ const int IMAGE_EXR = 2;
 // names for samplers
 const string SAMPLER_UNIFORM = "uniform";
 const string SAMPLER_UNIFORM_JITTER = "uniform_jitter";
+const string SAMPLER_SOBOL = "sobol";
+const string SAMPLER_HALTON = "halton";
+const string SAMPLER_CMJ = "cmj";
 
 // names for image reconstruction filters
 const string FILTER_BLOCK = "block";
 const string FILTER_GAUSSIAN = "gaussian";
 
+// default half-width of the denoising filter window, in pixels
+const int DEFAULT_DENOISE_RADIUS = 5;
+
 
 // miscellaneous useful constants
 
@@ -0,0 +1,122 @@
+// Code for denoising rendered images.
+//
+// DenoiseImage() is a cross- (or joint-) bilateral filter: the weight of a
+// neighboring pixel q in the mean for pixel p is
+//    w = exp(-[ |p - q|^2/(2 sigma_s^2) + sum over guides of (difference/sigma)^2/2 ])
+// The guides are the first-hit albedo, normal, relative depth, and coverage (which
+// are noise-free, or nearly so), plus the noisy color itself. For the color
+// (averaged over the three channels), sigma^2 is proportional to the sum of the
+// two pixels' estimated variances, so that noisy regions (e.g., penumbrae) are
+// smoothed strongly while converged regions and edges which the features don't
+// show (e.g., the edges of hard shadows) are preserved.
+// (With only one subsample per pixel there is no variance estimate, and the color
+// isn't used.)
+
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+#include "definitions.h"
+#include "color.h"
+#include "geometry.h"
+#include "trace_context.h"
+#include "denoise.h"
+
+using namespace std;
+
+const float  SIGMA_ALBEDO = 0.1;
+const float  SIGMA_NORMAL = 0.3;   // in |n_p - n_q|, so about 17 degrees
+const float  SIGMA_DEPTH = 0.05;   // relative to depth of p
+const float  SIGMA_COVERAGE = 0.1;
+const float  COLOR_VARIANCE_SCALE = 0.5;   // sigma_color^2 = scale x (var_p + var_q)
+const float  MIN_COLOR_VARIANCE = 1.0e-4;
+
+
+void NormalizePixelFeatures( pixelFeatures &features, int nSubsamples, 
+							const Color &pixelColor )
+{
+  if (features.coverage > 0.0) {
+    features.depth /= features.coverage;
+    float  length = features.normal.Length();
+    if (length > 0.0)
+      features.normal = features.normal / length;
+  }
+  features.albedo = features.albedo * (1.0f / nSubsamples);
+  features.coverage /= nSubsamples;
+  // unbiased sample variance, divided by n for the variance of the mean
+  if (nSubsamples > 1) {
+    Color  meanSquared = features.colorVariance * (1.0f / nSubsamples);
+    Color  variance = (meanSquared - pixelColor*pixelColor) * (1.0f / (nSubsamples - 1));
+    features.colorVariance = Color(fmaxf(variance.r, 0.0), fmaxf(variance.g, 0.0), 
+    								fmaxf(variance.b, 0.0));
+  }
+  else
+    features.colorVariance = Color(kInfinity);
+}
+
+
+void DenoiseImage( Color *image, const pixelFeatures *features, int width, int height,
+					int radius )
+{
+  if (radius < 1)
+    return;
+
+  // spatial part of the exponent, for each offset within the window
+  int  windowWidth = 2*radius + 1;
+  float  sigmaSpatial = fmaxf(0.5*radius, 1.0);
+  vector<float>  spatialTerm(windowWidth*windowWidth);
+  for (int dy = -radius; dy <= radius; dy++) {
+    for (int dx = -radius; dx <= radius; dx++)
+      spatialTerm[(dy + radius)*windowWidth + dx + radius] = (dx*dx + dy*dy) /
+      															(2*sigmaSpatial*sigmaSpatial);
+  }
+  const float  albedoScale = 0.5 / (SIGMA_ALBEDO*SIGMA_ALBEDO);
+  const float  normalScale = 0.5 / (SIGMA_NORMAL*SIGMA_NORMAL);
+  const float  depthScale = 0.5 / (SIGMA_DEPTH*SIGMA_DEPTH);
+  const float  coverageScale = 0.5 / (SIGMA_COVERAGE*SIGMA_COVERAGE);
+
+  vector<Color>  filtered(width*height);
+  #pragma omp parallel for schedule(dynamic)
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      int  i = y*width + x;
+      const pixelFeatures &featuresP = features[i];
+      if (featuresP.coverage <= 0.0) {
+        filtered[i] = image[i];
+        continue;
+      }
+      const Color  colorP = image[i];
+      const Color  varianceP = featuresP.colorVariance;
+      float  invDepth = 1.0 / featuresP.depth;
+      Color  sum = Color(0);
+      float  sumWeights = 0.0;
+      for (int yy = std::max(y - radius, 0); yy <= std::min(y + radius, height - 1); yy++) {
+        const float *spatialRow = &spatialTerm[(yy - y + radius)*windowWidth + radius - x];
+        for (int xx = std::max(x - radius, 0); xx <= std::min(x + radius, width - 1); xx++) {
+          int  j = yy*width + xx;
+          const pixelFeatures &featuresQ = features[j];
+          Color  dAlbedo = featuresP.albedo - featuresQ.albedo;
+          Vector  dNormal = featuresP.normal - featuresQ.normal;
+          float  dDepth = (featuresP.depth - featuresQ.depth)*invDepth;
+          float  dCoverage = featuresP.coverage - featuresQ.coverage;
+          Color  dColor = colorP - image[j];
+          Color  varianceSum = varianceP + featuresQ.colorVariance;
+          float  exponent = spatialRow[xx]
+          			+ albedoScale*(dAlbedo.r*dAlbedo.r + dAlbedo.g*dAlbedo.g + dAlbedo.b*dAlbedo.b)
+          			+ normalScale*dNormal.LengthSquared() + depthScale*dDepth*dDepth
+          			+ coverageScale*dCoverage*dCoverage
+          			+ (0.5/3.0)*(dColor.r*dColor.r/(COLOR_VARIANCE_SCALE*varianceSum.r + MIN_COLOR_VARIANCE)
+          				+ dColor.g*dColor.g/(COLOR_VARIANCE_SCALE*varianceSum.g + MIN_COLOR_VARIANCE)
+          				+ dColor.b*dColor.b/(COLOR_VARIANCE_SCALE*varianceSum.b + MIN_COLOR_VARIANCE));
+          float  weight = expf(-exponent);
+          sum += image[j]*weight;
+          sumWeights += weight;
+        }
+      }
+      // (sumWeights >= 1, since pixel p itself has weight = 1)
+      filtered[i] = sum * (1.0f / sumWeights);
+    }
+  }
+
+  std::copy(filtered.begin(), filtered.end(), image);
+}
@@ -0,0 +1,26 @@
+// Code for denoising rendered images, using a cross-bilateral filter guided by
+// first-hit feature buffers (albedo, normal, depth, coverage).
+
+#ifndef _DENOISE_H_
+#define _DENOISE_H_
+
+#include "definitions.h"
+#include "color.h"
+#include "trace_context.h"
+
+
+/// Converts the sums accumulated for one pixel during rendering into per-pixel values
+/// (pixelColor = final, averaged color of the pixel)
+void NormalizePixelFeatures( pixelFeatures &features, int nSubsamples, 
+							const Color &pixelColor );
+
+/// Replaces each pixel of image with a weighted mean of the pixels within radius
+/// pixels of it; the weights fall off with distance and with differences in
+/// features and color (relative to the color noise), so that the filter doesn't
+/// blur across edges in the scene. Pixels which don't see any surface are left
+/// unchanged.
+void DenoiseImage( Color *image, const pixelFeatures *features, int width, int height,
+					int radius=DEFAULT_DENOISE_RADIUS );
+
+
+#endif  // _DENOISE_H_
@@ -1,6 +1,7 @@
 
 #include "environment_map.h"
 #include "definitions.h"
+#include "texture_file.h"
 
 
 // const float PI_OVER_TWO = 1.5707963267948966;
@@ -43,79 +44,51 @@
 // 0 = right, 1 = left, 2 = top, 3 = bottom, 4 = back, 5 = front
 
 // Based on code from https://en.wikipedia.org/wiki/Cube_mapping
-void GetUVforCube( Ray theRay, int *imageIndex, float *u, float *v )
+// Face selection is done without branching on the ray direction, so that
+// compilers can vectorize loops over many rays: the major axis (ties go to z,
+// then y, as in the original chain of if statements) and the sign of the ray
+// along it give the face index, and per-face tables give which direction
+// components (and signs) map to u and v:
+//    RIGHT (+x): u = -z, v = -y        LEFT (-x):  u = +z, v = -y
+//    TOP (+y):   u = +x, v = +z        BOTTOM (-y): u = +x, v = +z
+//    BACK (+z):  u = +x, v = -y        FRONT (-z): u = -x, v = -y
+// (v uses the Renderman/OpenGL convention of increasing downward)
+const int  cubeUAxis[3] = {2, 0, 0};
+const int  cubeVAxis[3] = {1, 2, 1};
+const float  cubeUSign[6] = {-1.0f, 1.0f, 1.0f, 1.0f, 1.0f, -1.0f};
+const float  cubeVSign[6] = {-1.0f, -1.0f, 1.0f, 1.0f, -1.0f, -1.0f};
+
+void GetUVforCube( const Ray &theRay, int *imageIndex, float *u, float *v )
 {
-  float x = theRay.dir.x;
-  float y = theRay.dir.y;
-  float z = theRay.dir.z;
-  float absX = fabs(x);
-  float absY = fabs(y);
-  float absZ = fabs(z);
-  
-  bool isXPositive = x > 0 ? true : false;
-  bool isYPositive = y > 0 ? true : false;
-  bool isZPositive = z > 0 ? true : false;
+  float  d[3] = {theRay.dir.x, theRay.dir.y, theRay.dir.z};
+  float  absX = fabsf(d[0]);
+  float  absY = fabsf(d[1]);
+  float  absZ = fabsf(d[2]);
   
-  float maxAxis, uc, vc;
-  
-  // POSITIVE X = Right face
-  if (isXPositive && absX >= absY && absX >= absZ) {
-    // u (0 to 1) goes from +z to -z
-    // v (0 to 1) goes from -y to +y
-    maxAxis = absX;
-    uc = -z;
-    vc = -y;   // Renderman/OpenGL convention
-    *imageIndex = RIGHT_FACE;
-  }
-  // NEGATIVE X = Left face
-  if (!isXPositive && absX >= absY && absX >= absZ) {
-    // u (0 to 1) goes from -z to +z
-    // v (0 to 1) goes from -y to +y
-    maxAxis = absX;
-    uc = z;
-    vc = -y;   // Renderman/OpenGL convention
-    *imageIndex = LEFT_FACE;
-  }
-  // POSITIVE Y = Top/Up face
-  if (isYPositive && absY >= absX && absY >= absZ) {
-    // u (0 to 1) goes from -x to +x
-    // v (0 to 1) goes from +z to -z
-    maxAxis = absY;
-    uc = x;  // works!
-    vc = z;  // works!
-    *imageIndex = TOP_FACE;
-  }
-  // NEGATIVE Y = Bottom/Down face
-  if (!isYPositive && absY >= absX && absY >= absZ) {
-    // u (0 to 1) goes from -x to +x
-    // v (0 to 1) goes from -z to +z
-    maxAxis = absY;
-    uc = x;
-    vc = z;
-    *imageIndex = BOTTOM_FACE;
-  }
-  // POSITIVE Z = Back face (This is Renderman/OpenGL +Z; normal 3D -Z)
-  if (isZPositive && absZ >= absX && absZ >= absY) {
-    // u (0 to 1) goes from -x to +x
-    // v (0 to 1) goes from -y to +y
-    maxAxis = absZ;
-    uc = x;
-    vc = -y;   // Renderman/OpenGL convention
-    *imageIndex = BACK_FACE;
-  }
-  // NEGATIVE Z = Front face (This is Renderman/OpenGL -Z; normal 3D +Z)
-  if (!isZPositive && absZ >= absX && absZ >= absY) {
-    // u (0 to 1) goes from +x to -x
-    // v (0 to 1) goes from -y to +y
-    maxAxis = absZ;
-    uc = -x;
-    vc = -y;   // Renderman/OpenGL convention
-    *imageIndex = FRONT_FACE;
-  }
+  int  zIsMax = (absZ >= absX) & (absZ >= absY);
+  int  yIsMax = (1 - zIsMax) & (absY >= absX);
+  int  axis = 2*zIsMax + yIsMax;
+  int  face = 2*axis + (d[axis] > 0 ? 0 : 1);
+  float  maxAxis = fabsf(d[axis]);
 
   // Convert range from -1 to 1 to 0 to 1
-  *u = 0.5f * (uc / maxAxis + 1.0f);
-  *v = 0.5f * (vc / maxAxis + 1.0f);
+  *imageIndex = face;
+  *u = 0.5f * (cubeUSign[face]*d[cubeUAxis[axis]] / maxAxis + 1.0f);
+  *v = 0.5f * (cubeVSign[face]*d[cubeVAxis[axis]] / maxAxis + 1.0f);
+}
+
+
+// Inverse of GetUVforCube: returns the (normalized) direction corresponding
+// to position (u,v) on the specified face
+void GetDirectionForCube( int imageIndex, float u, float v, Vector *dir )
+{
+  float  d[3];
+  int  axis = imageIndex / 2;
+  
+  d[axis] = (imageIndex % 2 == 0) ? 1.0f : -1.0f;
+  d[cubeUAxis[axis]] = cubeUSign[imageIndex]*(2.0f*u - 1.0f);
+  d[cubeVAxis[axis]] = cubeVSign[imageIndex]*(2.0f*v - 1.0f);
+  *dir = Normalize(Vector(d[0], d[1], d[2]));
 }
 
 
@@ -133,7 +106,7 @@ void GetUVforCube( Ray theRay, int *imageIndex, float *u, float *v )
 // atan2(z, x) --> -pi,pi
 
 
-void GetUVforSphere( Ray theRay, float *u, float *v, float longitudeRotation )
+void GetUVforSphere( const Ray &theRay, float *u, float *v, float longitudeRotation )
 {
   float x = theRay.dir.x;
   float y = theRay.dir.y;
@@ -156,3 +129,118 @@ void GetUVforSphere( Ray theRay, float *u, float *v, float longitudeRotation )
   *v = (latitude + PI_OVER_TWO) / PI;
 }
 
+
+
+// Reads a single image and builds its mip-map; intended to be run as an
+// asynchronous task, so that multiple environment images can be decoded in
+// parallel while the rest of the scene is still being set up.
+// Returns nullptr if the image could not be read. (Exceptions from the image
+// libraries or from allocation are caught here, since an exception escaping
+// the task would only be rethrown by future.get() in WaitForImages.)
+unique_ptr<MipMap> LoadMipMapTask( const string imageName, int wrapMode )
+{
+  int  width, height;
+
+  try {
+    unique_ptr<MipMap> mipmap = make_unique<MipMap>();
+    // preprocessed texture files already contain the full pyramid, and are
+    // memory-mapped rather than read
+    if (IsTextureFile(imageName)) {
+      if (! mipmap->OpenTextureFile(imageName, wrapMode))
+        return nullptr;
+      return mipmap;
+    }
+
+    Color *pixels = ReadImage(imageName, width, height);
+    if (pixels == NULL)
+      return nullptr;
+    mipmap->Build(pixels, width, height, wrapMode);
+    return mipmap;
+  }
+  catch (const std::exception &e) {
+    fprintf(stderr, "ERROR: unable to load environment image \"%s\" (%s)!\n",
+    		imageName.c_str(), e.what());
+    return nullptr;
+  }
+}
+
+
+// Resamples an equiangular map into one face of a cube map, then builds the
+// face's mip-map; intended to be run as an asynchronous task (one per face),
+// after the equiangular image itself has been read by LoadMipMapTask.
+// The face size (width/pi) gives the cube map the same angular resolution as
+// the equiangular map at the face centers (and higher resolution elsewhere).
+// Each face texel is filtered over its angular footprint, converted to texels
+// of the equiangular map in the same way as in GetColorFromSphereMap.
+// Returns nullptr if the equiangular image could not be read or the face could
+// not be allocated.
+unique_ptr<MipMap> ResampleToCubeFaceTask( std::shared_future<unique_ptr<MipMap>> sphereMapImage, 
+											int imageIndex, float longitudeRotation )
+{
+  try {
+    const unique_ptr<MipMap> &sphereMap = sphereMapImage.get();
+    if (! sphereMap)
+      return nullptr;
+    
+    int  faceSize = (int)ceilf(sphereMap->Width() / PI);
+    float  texelAngle = 2.0f / faceSize;
+    unique_ptr<MipMap> mipmap = make_unique<MipMap>();
+    Color *pixels = new Color[faceSize*faceSize];
+    Ray  faceRay;
+    float  u, v;
+    for (int j = 0; j < faceSize; j++) {
+      for (int i = 0; i < faceSize; i++) {
+        GetDirectionForCube(imageIndex, (i + 0.5f)/faceSize, (j + 0.5f)/faceSize, &faceRay.dir);
+        float  maxAxis = fmaxf(fabsf(faceRay.dir.x), fmaxf(fabsf(faceRay.dir.y), fabsf(faceRay.dir.z)));
+        float  footprint = texelAngle*maxAxis*maxAxis * sphereMap->Height() / PI;
+        GetUVforSphere(faceRay, &u, &v, longitudeRotation);
+        pixels[j*faceSize + i] = sphereMap->Lookup(u, v, footprint);
+      }
+    }
+    mipmap->Build(pixels, faceSize, faceSize, MIPMAP_CLAMP);
+    return mipmap;
+  }
+  catch (const std::exception &e) {
+    fprintf(stderr, "ERROR: unable to resample environment image into cube face %d (%s)!\n",
+    		imageIndex, e.what());
+    return nullptr;
+  }
+}
+
+
+bool Environment::WaitForImages( )
+{
+  if (pendingImages.size() == 0)
+    return true;
+  
+  vector<unique_ptr<MipMap>> images;
+  for (auto &pending : pendingImages)
+    images.push_back(pending.get());
+  pendingImages.clear();
+
+  for (auto &image : images) {
+    if (! image) {
+      fprintf(stderr, "ERROR: unable to read environment image!\n");
+      hasMap = false;
+      return false;
+    }
+  }
+  imageWidth = images[0]->Width();
+  imageHeight = images[0]->Height();
+  
+  if (mapType == MAP_SKYBOX) {
+    for (int i = 0; i < 6; i++) {
+      if ((images[i]->Width() != imageWidth) || (images[i]->Height() != imageHeight)) {
+        fprintf(stderr, "ERROR: skybox images do not all have the same size!\n");
+        hasMap = false;
+        return false;
+      }
+    }
+    for (int i = 0; i < 6; i++)
+      skyboxMaps[i] = std::move(images[i]);
+    printf("Skybox image w,h = %d,%d\n", imageWidth, imageHeight);
+  }
+  else
+    sphereMap = std::move(images[0]);
+  return true;
+}
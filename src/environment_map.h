@@ -9,10 +9,14 @@
 #include <math.h>
 #include <vector>
 #include <string>
+#include <future>
+#include <memory>
 
 #include "geometry.h"
 #include "color.h"
 #include "image_io.h"
+#include "mipmap.h"
+#include "texture_file.h"
 #include "utilities_pub.h"
 #include "definitions.h"
 
@@ -32,9 +36,17 @@ const int  FRONT_FACE = 5;
 
 
 
-void GetUVforCube( Ray theRay, int *imageIndex, float *u, float *v );
+void GetUVforCube( const Ray &theRay, int *imageIndex, float *u, float *v );
 
-void GetUVforSphere( Ray theRay, float *u, float *v, float longitudeRotation );
+void GetDirectionForCube( int imageIndex, float u, float v, Vector *dir );
+
+void GetUVforSphere( const Ray &theRay, float *u, float *v, float longitudeRotation );
+
+
+unique_ptr<MipMap> LoadMipMapTask( const string imageName, int wrapMode );
+
+unique_ptr<MipMap> ResampleToCubeFaceTask( std::shared_future<unique_ptr<MipMap>> sphereMapImage, 
+											int imageIndex, float longitudeRotation );
 
 
 
@@ -48,8 +60,6 @@ class Environment
       baseColor = Color(0);
       hasMap = false;
       mapType = MAP_NONE;
-      skyboxAllocated = false;
-      imageAllocated = false;
     }
     
     Environment( const Color c )
@@ -57,42 +67,36 @@ class Environment
       baseColor = c;
       hasMap = false;
       mapType = MAP_NONE;
-      skyboxAllocated = false;
-      imageAllocated = false;
     }
     
     // Version for reading skybox background images
     Environment( const string baseFilename, const string fileExtension ) 
     {
-      ReadSkyBox(baseFilename, fileExtension);
-      hasMap = true;
-      mapType = MAP_SKYBOX;
+      baseColor = Color(0);
+      AddSkyBox(baseFilename, fileExtension);
     }
 
     // Version for reading equiangular spherical map background image
     Environment( const string fileName ) 
     {
-      ReadEquiangular(fileName);
-      hasMap = true;
-      mapType = MAP_EQUIANGULAR;
+      baseColor = Color(0);
+      AddSphereMap(fileName);
     }
 
     ~Environment( )
     { 
-      if (skyboxAllocated) {
-        for (int i = 0; i < 6; i++)
-          delete skyboxImages[i];
-        skyboxImages.clear();
-      }
-      if (imageAllocated)
-        free(equiangularImage);
+      // make sure no decoding tasks are still writing into memory we own
+      for (auto &pending : pendingImages)
+        pending.wait();
     }
 
 
 	void SetEnvironmentColor( Color c) { baseColor = c; }
 	
 	
-	Color GetEnvironmentColor( Ray theRay )
+	// The ray's cone spread angle (if any) determines how much the map is
+	// filtered (see GetColorFromSkybox and GetColorFromSphereMap)
+	Color GetEnvironmentColor( const Ray &theRay )
 	{
 	  if (hasMap) {
 	    if (mapType == MAP_SKYBOX)
@@ -112,80 +116,104 @@ class Environment
       mapType = MAP_SKYBOX;
     }
     
+    // Starts decoding the six faces in parallel (one task per face, which also
+    // builds that face's mip-map); the images are collected later by WaitForImages()
     void ReadSkyBox( const string baseFilename, const string extension )
     {
       for (int i = 0; i < 6; i++) {
         string imageName = baseFilename + skyboxFaceNames[i] + extension;
         printf("Reading %s...\n", imageName.c_str());
         if (FileExists(imageName.c_str()))
-          skyboxImages.push_back( ReadImage(imageName, imageWidth, imageHeight) );
+          pendingImages.push_back(std::async(std::launch::async, LoadMipMapTask, 
+          									imageName, MIPMAP_CLAMP));
         else {
           fprintf(stderr, "ERROR: skybox image file \"%s\" not found!\n", imageName.c_str());
           fprintf(stderr, "Exiting...\n\n");
           exit(1);
         }
       }
-      skyboxAllocated = true;
-      printf("Skybox image w,h = %d,%d\n", imageWidth, imageHeight);
     }
 
-    Color GetColorFromSkybox( Ray theRay )
+    // Filtered lookup: the footprint of the ray cone on the cube face is
+    // approximately spread/maxAxis^2 in units of the half-face (maxAxis = the
+    // largest absolute component of the normalized ray direction)
+    Color GetColorFromSkybox( const Ray &theRay )
     {
       int imageIndex;
       float  u, v;
-      int  x, y;
-      Color  *image;
       
       GetUVforCube(theRay, &imageIndex, &u, &v);
-      x = (int)(u*(imageWidth - 1));
-      y = (int)(v*(imageHeight - 1));
-      image = skyboxImages[imageIndex];
-      return image[y*imageWidth + x];
+      float  maxAxis = fmaxf(fabsf(theRay.dir.x), fmaxf(fabsf(theRay.dir.y), fabsf(theRay.dir.z)));
+      float  footprint = theRay.coneSpread * 0.5f*imageWidth / (maxAxis*maxAxis);
+      return skyboxMaps[imageIndex]->Lookup(u, v, footprint);
     }
 
 
     void AddSphereMap( const string fileName, float rotation=0.0 )
     {
-      ReadEquiangular(fileName);
       hasMap = true;
-      mapType = MAP_EQUIANGULAR;
       spheremapRotation = rotation * DEG2RAD;
+      ReadEquiangular(fileName);
     }
     
+    // Starts decoding the image in a background task. Normally, the image is
+    // then resampled into six cube faces (one task per face, which also builds
+    // that face's mip-map), so that lookups can use GetUVforCube instead of the
+    // much more expensive GetUVforSphere; the environment is then treated as a
+    // skybox. Preprocessed texture files are used directly as equiangular maps,
+    // since converting them would require reading the whole file.
+    // The images are collected later by WaitForImages().
     void ReadEquiangular( const string imageName )
     {
       printf("Reading %s...\n", imageName.c_str());
-      if (FileExists(imageName.c_str()))
-        equiangularImage = ReadImage(imageName, imageWidth, imageHeight);
+      if (FileExists(imageName.c_str())) {
+        if (IsTextureFile(imageName)) {
+          mapType = MAP_EQUIANGULAR;
+          pendingImages.push_back(std::async(std::launch::async, LoadMipMapTask, 
+          									imageName, MIPMAP_WRAP_U));
+        }
+        else {
+          mapType = MAP_SKYBOX;
+          std::shared_future<unique_ptr<MipMap>> sphereMapImage = std::async(std::launch::async, 
+          									LoadMipMapTask, imageName, MIPMAP_WRAP_U).share();
+          for (int i = 0; i < 6; i++)
+            pendingImages.push_back(std::async(std::launch::async, ResampleToCubeFaceTask, 
+            								sphereMapImage, i, spheremapRotation));
+        }
+      }
       else {
         fprintf(stderr, "ERROR: equiangular background image file \"%s\" not found!\n", imageName.c_str());
         fprintf(stderr, "Exiting...\n\n");
         exit(1);
       }
-      imageAllocated = true;
     }
 
-    Color GetColorFromSphereMap( Ray theRay )
+    // Blocks until all background image-decoding tasks have finished, then
+    // stores the decoded images. Must be called before any of the GetColor...
+    // methods are used (Scene::PrepareForRender does this). Returns false (and
+    // falls back to the plain environment color) if any image couldn't be read.
+    bool WaitForImages( );
+
+    // Filtered lookup: the filter footprint is the ray cone's spread angle
+    // converted to texels along the latitude direction (pi radians = imageHeight)
+    Color GetColorFromSphereMap( const Ray &theRay )
     {
       float  u, v;
-      int  x, y;
       
       GetUVforSphere(theRay, &u, &v, spheremapRotation);
-      x = (int)(u*(imageWidth - 1));
-      y = (int)(v*(imageHeight - 1));
-      return equiangularImage[y*imageWidth + x];
+      float  footprint = theRay.coneSpread * imageHeight / PI;
+      return sphereMap->Lookup(u, v, footprint);
     }
 
     // Data members:
 	Color  baseColor;
 	bool  hasMap;
 	int  mapType;
-	bool  skyboxAllocated;
-	vector<Color *> skyboxImages;
-	bool  imageAllocated;
-	Color * equiangularImage;
-	float  spheremapRotation;
+	unique_ptr<MipMap>  skyboxMaps[6];
+	unique_ptr<MipMap>  sphereMap;
+	float  spheremapRotation = 0.0;
 	int  imageWidth, imageHeight;
+	vector<std::future<unique_ptr<MipMap>>> pendingImages;
 };
 
 
@@ -0,0 +1,15 @@
+// Conversion of our OpenEXR compression settings to OpenEXR's own values (used
+// by the OpenEXR writers in image_io.cpp and exr_tile_writer.cpp; kept out of
+// image_io.h so that code using that doesn't need the OpenEXR headers).
+
+#ifndef _EXR_COMPRESSION_H_
+#define _EXR_COMPRESSION_H_
+
+#include <OpenEXR/ImfCompression.h>
+
+
+/// Converts one of the EXR_COMPRESSION_ values in image_io.h to OpenEXR's equivalent
+Imf::Compression OpenEXRCompression( int compression );
+
+
+#endif   // _EXR_COMPRESSION_H_
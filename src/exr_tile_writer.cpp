@@ -0,0 +1,156 @@
+// Code for streaming a rendered image to a tiled OpenEXR file.
+//
+// Render threads hand finished tiles to SubmitTile(), which copies them into a
+// bounded queue; a single writer thread takes them off the queue and writes them
+// (converting to half precision, unless full float was requested) with OpenEXR's
+// tiled interface. Tiles finish in no particular order, so the file uses RANDOM_Y
+// line order. Peak memory is thus set by the number of tiles in flight rather than
+// by the image size, and since each tile is written to disk as soon as it's
+// dequeued, an interrupted render leaves a readable file with the finished tiles.
+// OpenEXR reports errors (bad path, full disk, invalid tile) by throwing; these
+// are caught, since an exception escaping the writer thread would terminate the
+// program, and reported by Finish().
+
+#include <stdio.h>
+#include <string>
+#include <exception>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <OpenEXR/ImfTiledOutputFile.h>
+#include <OpenEXR/ImfHeader.h>
+#include <OpenEXR/ImfChannelList.h>
+#include <OpenEXR/ImfFrameBuffer.h>
+#include <OpenEXR/ImfTileDescription.h>
+#include <OpenEXR/ImfLineOrder.h>
+
+#include "color.h"
+#include "image_io.h"
+#include "exr_tile_writer.h"
+#include "exr_compression.h"
+
+using namespace std;
+
+
+TiledEXRWriter::TiledEXRWriter( const string imageFilename, int width, int height,
+								int tileSize, int maxQueuedTiles, 
+								const exrOutputOptions &exrOptions )
+  : tileSize(tileSize), maxQueuedTiles(maxQueuedTiles), filename(imageFilename),
+    noMoreTiles(false), writeFailed(false), nTilesWritten(0)
+{
+  Imf::Header header(width, height);
+  header.setTileDescription(Imf::TileDescription(tileSize, tileSize, Imf::ONE_LEVEL));
+  header.lineOrder() = Imf::RANDOM_Y;
+  header.compression() = OpenEXRCompression(exrOptions.compression);
+  Imf::PixelType  pixelType = exrOptions.fullFloat ? Imf::FLOAT : Imf::HALF;
+  header.channels().insert("R", Imf::Channel(pixelType));
+  header.channels().insert("G", Imf::Channel(pixelType));
+  header.channels().insert("B", Imf::Channel(pixelType));
+  try {
+    file = make_unique<Imf::TiledOutputFile>(imageFilename.c_str(), header);
+  }
+  catch (const std::exception &e) {
+    fprintf(stderr, "ERROR: unable to open OpenEXR image file \"%s\" for writing (%s)!\n",
+    		imageFilename.c_str(), e.what());
+    writeFailed = true;
+    return;
+  }
+
+  writerThread = std::thread(&TiledEXRWriter::WriteTiles, this);
+}
+
+
+TiledEXRWriter::~TiledEXRWriter( )
+{
+  Finish();
+}
+
+
+bool TiledEXRWriter::SubmitTile( int tileX, int tileY, const Color *pixels )
+{
+  pendingTile  tile;
+  tile.tileX = tileX;
+  tile.tileY = tileY;
+  tile.pixels.assign(pixels, pixels + tileSize*tileSize);
+
+  std::unique_lock<std::mutex>  lock(queueMutex);
+  while ((queue.size() >= maxQueuedTiles) && (! writeFailed))
+    spaceAvailable.wait(lock);
+  if (writeFailed)
+    return false;
+  queue.push_back(std::move(tile));
+  lock.unlock();
+  tileAvailable.notify_one();
+  return true;
+}
+
+
+void TiledEXRWriter::WriteTiles( )
+{
+  // pixels are read in tile coordinates, i.e., relative to the tile's corner
+  const size_t  xStride = sizeof(Color);
+  const size_t  yStride = sizeof(Color)*tileSize;
+  Imf::FrameBuffer  frameBuffer;
+
+  while (true) {
+    pendingTile  tile;
+    std::unique_lock<std::mutex>  lock(queueMutex);
+    while (queue.empty() && (! noMoreTiles))
+      tileAvailable.wait(lock);
+    if (queue.empty())
+      break;
+    tile = std::move(queue.front());
+    queue.pop_front();
+    lock.unlock();
+    spaceAvailable.notify_one();
+
+    char  *base = (char *)&tile.pixels[0].r;
+    frameBuffer.insert("R", Imf::Slice(Imf::FLOAT, base, xStride, yStride, 1, 1, 0.0,
+    									true, true));
+    frameBuffer.insert("G", Imf::Slice(Imf::FLOAT, base + sizeof(float), xStride, yStride,
+    									1, 1, 0.0, true, true));
+    frameBuffer.insert("B", Imf::Slice(Imf::FLOAT, base + 2*sizeof(float), xStride, yStride,
+    									1, 1, 0.0, true, true));
+    try {
+      file->setFrameBuffer(frameBuffer);
+      file->writeTile(tile.tileX, tile.tileY);
+    }
+    catch (const std::exception &e) {
+      // give up on the file, and release any render threads waiting for space
+      lock.lock();
+      writeFailed = true;
+      errorMessage = e.what();
+      queue.clear();
+      lock.unlock();
+      spaceAvailable.notify_all();
+      return;
+    }
+    nTilesWritten++;
+  }
+}
+
+
+bool TiledEXRWriter::Finish( )
+{
+  // already finished, or the file couldn't be opened
+  if (! writerThread.joinable())
+    return (! writeFailed);
+  {
+    std::lock_guard<std::mutex>  lock(queueMutex);
+    noMoreTiles = true;
+  }
+  tileAvailable.notify_one();
+  writerThread.join();
+  // closing the file writes the tile-offset table
+  file.reset();
+  if (writeFailed) {
+    fprintf(stderr, "ERROR: unable to write OpenEXR image file \"%s\" (%s)!\n",
+    		filename.c_str(), errorMessage.c_str());
+    return false;
+  }
+  printf("Saved OpenEXR image file \"%s\" (%d tiles)\n", filename.c_str(), nTilesWritten);
+  return true;
+}
@@ -0,0 +1,71 @@
+// Code for streaming a rendered image to a tiled OpenEXR file, one tile at a time,
+// so that the full image never has to be held in memory.
+
+#ifndef _EXR_TILE_WRITER_H_
+#define _EXR_TILE_WRITER_H_
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <OpenEXR/ImfTiledOutputFile.h>
+
+#include "color.h"
+#include "image_io.h"
+
+
+class TiledEXRWriter
+{
+  public:
+    /// Opens the output file (with tiles of tileSize x tileSize pixels) and starts
+    /// the writer thread; at most maxQueuedTiles submitted tiles are held in memory
+    /// waiting to be written. If the file can't be opened, an error is printed and
+    /// IsOpen() returns false.
+    TiledEXRWriter( const std::string imageFilename, int width, int height, int tileSize,
+    				int maxQueuedTiles, 
+    				const exrOutputOptions &exrOptions=exrOutputOptions() );
+    /// Calls Finish(), if that hasn't already been done
+    ~TiledEXRWriter( );
+
+    /// Queues the tile for writing (tileX, tileY = column and row of the tile); pixels
+    /// holds tileSize x tileSize values in row-major order (values outside the image
+    /// are ignored) and is copied, so the caller can reuse it immediately. Blocks
+    /// while the queue is full. Thread-safe. Returns false (and discards the tile)
+    /// if writing has failed.
+    bool SubmitTile( int tileX, int tileY, const Color *pixels );
+
+    /// Waits until all queued tiles have been written, then closes the file;
+    /// returns false (after printing an error) if any tile couldn't be written
+    bool Finish( );
+
+    bool IsOpen( ) const { return (file != nullptr); };
+    int TileSize( ) const { return tileSize; };
+
+  private:
+    typedef struct {
+      int  tileX, tileY;
+      std::vector<Color>  pixels;
+    } pendingTile;
+
+    void WriteTiles( );   // main function of the writer thread
+
+    int  tileSize;
+    size_t  maxQueuedTiles;
+    std::string  filename;
+    std::unique_ptr<Imf::TiledOutputFile>  file;   // accessed only by the writer thread
+    std::deque<pendingTile>  queue;
+    bool  noMoreTiles;
+    bool  writeFailed;   // set if OpenEXR threw an exception; later tiles are discarded
+    std::string  errorMessage;
+    int  nTilesWritten;
+    std::mutex  queueMutex;
+    std::condition_variable  tileAvailable, spaceAvailable;
+    std::thread  writerThread;
+};
+
+
+#endif  // _EXR_TILE_WRITER_H_
@@ -150,7 +150,7 @@ class Point
     }
 
     // subtract vector from point to get displaced point
-    Point operator-( const Vector &v ) {
+    Point operator-( const Vector &v ) const {
       return Point(x - v.x, y - v.y, z - v.z);
     }
     Point operator-=(const Vector &v) {
@@ -188,7 +188,7 @@ class Ray
 {
   public:
     
-    Ray( ) { depth = 1; currentIOR = 1.0; }
+    Ray( ) { depth = 1; currentIOR = 1.0; coneWidth = 0.0; coneSpread = 0.0; }
     // Constructors with initializations:
     Ray( const Point origin, const Vector direction, int dpth=1, float ior=1.0 )
     {
@@ -196,6 +196,8 @@ class Ray
       dir = Normalize(direction);
       depth = dpth;
       currentIOR = ior;
+      coneWidth = 0.0;
+      coneSpread = 0.0;
     }
 
     Ray( const Point origin, const Point dest, int dpth=1, float ior=1.0 )
@@ -204,10 +206,18 @@ class Ray
       dir = Normalize(dest - origin);
       depth = 1;
       currentIOR = 1.0;
+      coneWidth = 0.0;
+      coneSpread = 0.0;
+    }
+
+    // width of the ray's footprint (cone) at distance t along the ray
+    float ConeWidthAt( const float t ) const
+    {
+      return coneWidth + t*coneSpread;
     }
 
     // calling ray as function: return point at distance t along the ray
-    Point operator()(const float t)
+    Point operator()(const float t) const
     {
       return o + dir*t;
     }
@@ -217,6 +227,10 @@ class Ray
     Vector dir;    // direction vector
     int depth;      // current raytrace depth
     float currentIOR;   // index of refraction
+    // Ray cone (footprint) used for filtering texture lookups: width of the cone
+    // at the origin, and its spread angle (radians); both = 0 for an ideal ray
+    float coneWidth;
+    float coneSpread;
 };
 
 
@@ -244,5 +258,21 @@ inline float Dot( const Vector &v1, const Vector &v2 )
   return v1.x*v2.x + v1.y*v2.y + v1.z*v2.z;
 }
 
+inline Vector Cross( const Vector &v1, const Vector &v2 )
+{
+  return Vector(v1.y*v2.z - v1.z*v2.y, v1.z*v2.x - v1.x*v2.z, v1.x*v2.y - v1.y*v2.x);
+}
+
+// Given a normalized vector v1, computes two more vectors (v2, v3) so that
+// all three are mutually orthogonal and normalized
+inline void CoordinateSystem( const Vector &v1, Vector *v2, Vector *v3 )
+{
+  if (fabsf(v1.x) > fabsf(v1.y))
+    *v2 = Vector(-v1.z, 0.0, v1.x) / sqrtf(v1.x*v1.x + v1.z*v1.z);
+  else
+    *v2 = Vector(0.0, v1.z, -v1.y) / sqrtf(v1.y*v1.y + v1.z*v1.z);
+  *v3 = Cross(v1, *v2);
+}
+
 
 #endif  // _GEOMETRY_H_
@@ -0,0 +1,87 @@
+// Sampler which generates subsample positions from the Halton sequence. Each
+// sampling dimension uses its own pair of prime bases (2,3 for the pixel,
+// 5,7 for the lens, etc.); the digits of each radical inverse are permuted
+// with a per-pixel, per-digit random shift, which decorrelates pixels while
+// preserving the stratification of the sequence.
+
+#include <assert.h>
+#include <math.h>
+#include "sampler.h"
+#include "halton_sampler.h"
+#include "low_discrepancy.h"
+
+const int  N_HALTON_BASES = 16;
+const int  HALTON_BASES[N_HALTON_BASES] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 
+											41, 43, 47, 53};
+// largest float < 1
+const float  ONE_MINUS_EPSILON = 0.99999994;
+// digits which contribute less than this are ignored
+const double  MIN_DIGIT_WEIGHT = 1.0e-8;
+
+
+float ScrambledRadicalInverse( const int base, uint32_t index, const uint32_t seed )
+{
+  double  invBase = 1.0 / base;
+  double  digitWeight = 1.0;
+  double  result = 0.0;
+
+  // (when scrambling, the trailing zero digits are shifted too, so we have to keep
+  // going until the digits no longer matter)
+  for (int i_digit = 0; (index > 0) || ((seed != 0) && (digitWeight > MIN_DIGIT_WEIGHT)); 
+  		i_digit++) {
+    uint32_t  digit = index % base;
+    index /= base;
+    if (seed != 0)
+      digit = (digit + PCGHash(HashCombine(seed, i_digit))) % base;
+    digitWeight *= invBase;
+    result += digit*digitWeight;
+  }
+  return fminf((float)result, ONE_MINUS_EPSILON);
+}
+
+
+HaltonSampler::HaltonSampler( const int nSamples )
+{
+  nSamples2D = nSamples;
+  nSamples1D = (int)ceil(sqrt((double)nSamples));
+  offsetsAllocated = false;
+}
+
+
+HaltonSampler::~HaltonSampler( )
+{
+  ;
+}
+
+
+void HaltonSampler::GetOffsetCoords( const int n, float *xOffset, float *yOffset ) const
+{
+  GetOffsetCoords(n, 0, xOffset, yOffset);
+}
+
+
+void HaltonSampler::GetOffsetCoords( const int n, const uint32_t pixelSeed, float *xOffset, 
+									float *yOffset ) const
+{
+  assert ((n >= 0) && (n < nSamples2D));
+
+  GetSample2D(n, SAMPLE_DIMENSION_PIXEL, pixelSeed, xOffset, yOffset);
+  *xOffset -= 0.5;
+  *yOffset -= 0.5;
+}
+
+
+/// Dimensions beyond the number of available base pairs reuse the bases (with
+/// different scrambling)
+void HaltonSampler::GetSample2D( const int n, const int dimension, const uint32_t seed, 
+								float *u, float *v ) const
+{
+  int  i_base = 2*(dimension % (N_HALTON_BASES/2));
+  uint32_t  dimensionSeed = (seed == 0) ? 0 : HashCombine(seed, dimension);
+
+  if ((dimensionSeed == 0) && (dimension >= N_HALTON_BASES/2))
+    dimensionSeed = HashCombine(0, dimension);
+  *u = ScrambledRadicalInverse(HALTON_BASES[i_base], n, dimensionSeed);
+  *v = ScrambledRadicalInverse(HALTON_BASES[i_base + 1], n, 
+  								(dimensionSeed == 0) ? 0 : HashCombine(dimensionSeed, 1));
+}
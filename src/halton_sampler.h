@@ -0,0 +1,40 @@
+// Header file for Sampler subclass which uses (scrambled) Halton points for
+// subsamples within each pixel.
+
+#ifndef _HALTON_SAMPLER_H_
+#define _HALTON_SAMPLER_H_
+
+#include <stdint.h>
+#include "sampler.h"
+
+
+/// Radical inverse of index in the specified base, with the digits permuted by
+/// seed (seed = 0 --> no scrambling); the result is in [0,1)
+float ScrambledRadicalInverse( const int base, uint32_t index, const uint32_t seed );
+
+
+class HaltonSampler : public Sampler
+{ 
+public:
+
+  /// nSamples = total number of subsamples per pixel (any positive integer)
+  HaltonSampler( const int nSamples=1 );
+  ~HaltonSampler( );
+
+  using Sampler::GetOffsetCoords;
+
+  /// Computes offset in x and y xOffset, yOffset for sample number n (unscrambled pattern)
+  void GetOffsetCoords( const int n, float *xOffset, float *yOffset ) const;
+
+  /// Computes offset in x and y xOffset, yOffset for sample number n, with the
+  /// pattern scrambled by pixelSeed
+  void GetOffsetCoords( const int n, const uint32_t pixelSeed, float *xOffset, 
+  						float *yOffset ) const;
+
+  /// Computes 2D sample (u,v) for sample number n of the specified sampling dimension
+  void GetSample2D( const int n, const int dimension, const uint32_t seed, 
+  					float *u, float *v ) const;
+}; 
+
+
+#endif  // _HALTON_SAMPLER_H_
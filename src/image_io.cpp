@@ -8,23 +8,43 @@
 //    R_256 = (R_f)^(1/2.2) * 255
 // (there's a tweak where we add 0.5 to the result before converting it to an integer,
 // for reasons I don't remember...)
+// Since the result is a step function of the input, the conversion is done with
+// a lookup table of the 255 input values where the output steps up (see GammaTable),
+// which gives exactly the same bytes as calling pow() for each value.
+//
+// The conversion to bytes and (for PNG) the row filtering and zlib compression are
+// done in parallel. For PNG, the filtered image is split into fixed-size chunks which
+// are compressed independently (each primed with the preceding 32 KB as a dictionary,
+// so there's little loss in compression) and then concatenated into a single zlib
+// stream, as in pigz.
 
 
 #include <stdio.h>
+#include <string.h>
+#include <stdint.h>
 #include <cstdlib>
 #include <iostream>
 #include <fstream>
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+#include <zlib.h>
 
-#include <OpenEXR/ImfConvert.h>
 #include <OpenEXR/ImfRgbaFile.h>
+#include <OpenEXR/ImfOutputFile.h>
+#include <OpenEXR/ImfHeader.h>
+#include <OpenEXR/ImfCompression.h>
+#include <OpenEXR/ImfChannelList.h>
+#include <OpenEXR/ImfFrameBuffer.h>
+#include <OpenEXR/ImfThreading.h>
 
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "stb_image_write.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
 #include "color.h"
 #include "image_io.h"
+#include "exr_compression.h"
 #include "definitions.h"
 
 
@@ -34,27 +54,132 @@ float clamp( float x )
 }
 
 // convert linear floating-point light values to byte values, including
-// pre-correction for computer monitor gamma = 2.2
-unsigned char GammaCorrectToByte( float lightValue )
+// pre-correction for computer monitor gamma = 2.2 (reference version, used to set
+// up the lookup table)
+unsigned char GammaCorrectToByteSlow( float lightValue )
 {
   return (unsigned char)int( pow(clamp(lightValue), 1.0/2.2)*255 + 0.5 );
 }
 
 
+const int  GAMMA_LUT_SIZE = 4096;
+
+// Lookup table for gamma correction: thresholds[k] = smallest input value which is
+// converted to byte value k; bucketStart[i] = byte value for input i/GAMMA_LUT_SIZE
+// (a first guess for any input in [i, i + 1)/GAMMA_LUT_SIZE, which is then adjusted
+// using the thresholds -- by only a step or two, except very close to 0)
+class GammaTable
+{
+  public:
+    GammaTable( );
+    unsigned char Convert( float lightValue ) const;
+
+  private:
+    float  thresholds[256];
+    unsigned char  bucketStart[GAMMA_LUT_SIZE + 1];
+};
+
+
+GammaTable::GammaTable( )
+{
+  // binary search on the bit patterns of floats in [0,1] (which are ordered the
+  // same way as the values)
+  uint32_t  bitsOne;
+  float  one = 1.0f;
+  memcpy(&bitsOne, &one, sizeof(float));
+  thresholds[0] = 0.0;
+  for (int k = 1; k < 256; k++) {
+    uint32_t  lo = 0, hi = bitsOne;   // GammaCorrectToByteSlow(hi) >= k, but not lo
+    while (hi - lo > 1) {
+      uint32_t  mid = lo + (hi - lo)/2;
+      float  value;
+      memcpy(&value, &mid, sizeof(float));
+      if (GammaCorrectToByteSlow(value) >= k)
+        hi = mid;
+      else
+        lo = mid;
+    }
+    memcpy(&thresholds[k], &hi, sizeof(float));
+  }
+  for (int i = 0; i <= GAMMA_LUT_SIZE; i++)
+    bucketStart[i] = GammaCorrectToByteSlow((float)i / GAMMA_LUT_SIZE);
+}
+
+
+unsigned char GammaTable::Convert( float lightValue ) const
+{
+  // (the test is written this way so that NaN values give 0)
+  if (! (lightValue > 0.0f))
+    return 0;
+  if (lightValue >= 1.0f)
+    return 255;
+  int  k = bucketStart[(int)(lightValue*GAMMA_LUT_SIZE)];
+  while ((k < 255) && (lightValue >= thresholds[k + 1]))
+    k++;
+  while ((k > 0) && (lightValue < thresholds[k]))
+    k--;
+  return (unsigned char)k;
+}
+
+
+static const GammaTable  gammaTable;
+
+unsigned char GammaCorrectToByte( float lightValue )
+{
+  return gammaTable.Convert(lightValue);
+}
+
+// convert floating-point data values (e.g., alpha) to byte values, *without* gamma
+// correction
+unsigned char LinearToByte( float value )
+{
+  return (unsigned char)int( clamp(value)*255 + 0.5 );
+}
+
+unsigned char ConvertToByte( float value, bool gammaCorrect )
+{
+  return gammaCorrect ? GammaCorrectToByte(value) : LinearToByte(value);
+}
+
+
+// Converts image to 8-bit RGB values (3 bytes per pixel, in bytes), in parallel
+void ConvertImageToBytes( const Color *image, int nPixels, bool gammaCorrect, 
+							unsigned char *bytes )
+{
+  #pragma omp parallel for schedule(static)
+  for (int i = 0; i < nPixels; ++i) {
+    bytes[3*i] = ConvertToByte(image[i].r, gammaCorrect);
+    bytes[3*i + 1] = ConvertToByte(image[i].g, gammaCorrect);
+    bytes[3*i + 2] = ConvertToByte(image[i].b, gammaCorrect);
+  }
+}
+
+
 // Reads in RGB image, returning array of Color values; size of image is returned in
 // width and height parameters. Conversion of individual R, G, and B values is from
 // (0,255) byte values to floating-point (0,1) range, assuming a gamma=2.2 conversion.
 // Should be capable of reading the following formats:
 //    JPEG, PNG, PPM, PNG, TGA (PSD -- composited view only, no extra channels, 
 //    8/16 bit-per-channel)
+// OpenEXR files (".exr" suffix) are handed off to ReadImageOpenEXR().
+// Returns NULL if the image could not be read.
 Color * ReadImage( const std::string imageName, int &width, int &height )
 {
   int  xSize, ySize, n;
   float r, g, b;
 
+  size_t nChars = imageName.size();
+  if ((nChars > 4) && (imageName.find(".exr", nChars - 4) != std::string::npos))
+    return ReadImageOpenEXR(imageName, width, height);
+
   // force image data to be converted to floating-point values
   // (with correction for assumed gamma=2.2)
   float *imageData = stbi_loadf(imageName.c_str(), &xSize, &ySize, &n, 0);
+  if (imageData == NULL) {
+    fprintf(stderr, "ERROR: unable to read image file \"%s\" (%s)\n", imageName.c_str(),
+    		stbi_failure_reason());
+    return NULL;
+  }
   int nPixels = xSize*ySize;
   
   // allocate data for Color array and copy pixel data (we are assuming n = 3!)
@@ -74,19 +199,57 @@ Color * ReadImage( const std::string imageName, int &width, int &height )
 }
 
 
+// Starts up OpenEXR's global thread pool (used for compressing and decompressing
+// blocks of scanlines in parallel), if that hasn't already been done
+void InitOpenEXRThreads( )
+{
+  if (Imf::globalThreadCount() == 0)
+    Imf::setGlobalThreadCount(std::thread::hardware_concurrency());
+}
+
+
+// Reads in an OpenEXR image (already linear floating-point, so no gamma conversion),
+// returning array of Color values; size of image is returned in width and height.
+// Decoding is done with OpenEXR's internal thread pool, so large HDR maps are
+// decompressed in parallel.
+Color * ReadImageOpenEXR( const std::string imageName, int &width, int &height )
+{
+  InitOpenEXRThreads();
+
+  Imf::RgbaInputFile file(imageName.c_str(), Imf::globalThreadCount());
+  Imath::Box2i dataWindow = file.dataWindow();
+  int xSize = dataWindow.max.x - dataWindow.min.x + 1;
+  int ySize = dataWindow.max.y - dataWindow.min.y + 1;
+  int nPixels = xSize*ySize;
+  
+  std::vector<Imf::Rgba> pixelsOpenEXR(nPixels);
+  file.setFrameBuffer(pixelsOpenEXR.data() - dataWindow.min.x - dataWindow.min.y*xSize, 
+  					1, xSize);
+  file.readPixels(dataWindow.min.y, dataWindow.max.y);
+  
+  Color *colorImageArray = new Color[nPixels];
+  for (int i = 0; i < nPixels; i++)
+    colorImageArray[i] = Color(pixelsOpenEXR[i].r, pixelsOpenEXR[i].g, pixelsOpenEXR[i].b);
+  
+  width = xSize;
+  height = ySize;
+  return colorImageArray;
+}
+
+
 
 void SaveImage( Color *image, int width, int height, const std::string outputImageName, 
-				int outputImageFormat )
+				int outputImageFormat, bool gammaCorrect, const exrOutputOptions &exrOptions )
 {
   switch (outputImageFormat) {
     case IMAGE_PPM:
-      SaveImagePPM(image, width, height, outputImageName);
+      SaveImagePPM(image, width, height, outputImageName, gammaCorrect);
       break;
     case IMAGE_PNG:
-      SaveImagePNG(image, width, height, outputImageName);
+      SaveImagePNG(image, width, height, outputImageName, gammaCorrect);
       break;
     case IMAGE_EXR:
-      SaveImageOpenEXR(image, width, height, outputImageName);
+      SaveImageOpenEXR(image, width, height, outputImageName, exrOptions);
       break;
     default:
       printf("WARNING: Unrecognized image format in output filename (\"%s\")!\n", 
@@ -101,46 +264,240 @@ void SaveImage( Color *image, int width, int height, const std::string outputIma
 // or using GraphicsMagick "gm convert":
 //    $ gm convert untitled.ppm untitled.png
 // [Or, now, just use SaveImagePNG to save the raw image directly to PNG format.]
-void SaveImagePPM( Color *image, int width, int height, std::string imageFilename )
+void SaveImagePPM( Color *image, int width, int height, std::string imageFilename,
+					bool gammaCorrect )
 {
   std::string outputFilename = imageFilename + ".ppm";
-  unsigned char r, g, b;
+  std::vector<unsigned char> bytes(3*(size_t)width*height);
+  ConvertImageToBytes(image, width*height, gammaCorrect, bytes.data());
   
   std::ofstream ofs(outputFilename.c_str(), std::ios::out | std::ios::binary); 
   ofs << "P6\n" << width << " " << height << "\n255\n"; 
-  for (int i = 0; i < width*height; ++i) {
-    r = GammaCorrectToByte(image[i].r);
-    g = GammaCorrectToByte(image[i].g);
-    b = GammaCorrectToByte(image[i].b);
-    ofs << r << g << b;
-  } 
+  ofs.write((const char *)bytes.data(), bytes.size());
   ofs.close(); 
   
   printf("Saved image file \"%s\".\n", outputFilename.c_str());
 }
 
 
-void SaveImagePNG( Color *image, int width, int height, std::string imageFilename )
+// PNG ENCODING
+
+const size_t  PNG_CHUNK_BYTES = 256*1024;   // filtered bytes per compression chunk
+const size_t  ZLIB_WINDOW_BYTES = 32768;
+const size_t  MAX_IDAT_BYTES = 1 << 30;
+
+
+static inline unsigned char PaethPredictor( int a, int b, int c )
+{
+  int  p = a + b - c;
+  int  pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+  if ((pa <= pb) && (pa <= pc))
+    return (unsigned char)a;
+  return (pb <= pc) ? (unsigned char)b : (unsigned char)c;
+}
+
+
+// Applies the PNG filter (0 = none, 1 = sub, 2 = up, 3 = average, 4 = Paeth) to
+// one row (prevRow = all zeros for the first row of the image); the first pixel
+// of the row has no left neighbor, so its left values count as 0
+static void FilterPNGRow( int filterType, const unsigned char *row, 
+						const unsigned char *prevRow, int rowBytes, int bytesPerPixel,
+						unsigned char *filtered )
+{
+  int  n = bytesPerPixel;
+  switch (filterType) {
+    case 0:
+      memcpy(filtered, row, rowBytes);
+      break;
+    case 1:
+      memcpy(filtered, row, n);
+      for (int i = n; i < rowBytes; i++)
+        filtered[i] = row[i] - row[i - n];
+      break;
+    case 2:
+      for (int i = 0; i < rowBytes; i++)
+        filtered[i] = row[i] - prevRow[i];
+      break;
+    case 3:
+      for (int i = 0; i < n; i++)
+        filtered[i] = row[i] - (prevRow[i] >> 1);
+      for (int i = n; i < rowBytes; i++)
+        filtered[i] = row[i] - ((row[i - n] + prevRow[i]) >> 1);
+      break;
+    default:
+      for (int i = 0; i < n; i++)
+        filtered[i] = row[i] - prevRow[i];   // (Paeth predictor = up, here)
+      for (int i = n; i < rowBytes; i++)
+        filtered[i] = row[i] - PaethPredictor(row[i - n], prevRow[i], prevRow[i - n]);
+      break;
+  }
+}
+
+
+// Filters one row with whichever filter gives the smallest sum of absolute (signed)
+// values -- the usual heuristic -- and stores the filter type followed by the
+// filtered bytes in output
+static void FilterPNGRowAdaptive( const unsigned char *row, const unsigned char *prevRow, 
+								int rowBytes, int bytesPerPixel, unsigned char *output,
+								std::vector<unsigned char> &scratch )
+{
+  int  bestType = 0;
+  long  bestSum = -1;
+  scratch.resize(rowBytes);
+  for (int filterType = 0; filterType < 5; filterType++) {
+    FilterPNGRow(filterType, row, prevRow, rowBytes, bytesPerPixel, scratch.data());
+    long  sum = 0;
+    for (int i = 0; i < rowBytes; i++)
+      sum += abs((signed char)scratch[i]);
+    if ((bestSum < 0) || (sum < bestSum)) {
+      bestSum = sum;
+      bestType = filterType;
+    }
+  }
+  output[0] = (unsigned char)bestType;
+  FilterPNGRow(bestType, row, prevRow, rowBytes, bytesPerPixel, output + 1);
+}
+
+
+static void AppendBigEndian32( std::vector<unsigned char> &data, uint32_t value )
+{
+  data.push_back((value >> 24) & 0xff);
+  data.push_back((value >> 16) & 0xff);
+  data.push_back((value >> 8) & 0xff);
+  data.push_back(value & 0xff);
+}
+
+static void AppendPNGChunk( std::vector<unsigned char> &png, const char *chunkType, 
+							const unsigned char *chunkData, size_t length )
+{
+  AppendBigEndian32(png, (uint32_t)length);
+  size_t  typeStart = png.size();
+  png.insert(png.end(), chunkType, chunkType + 4);
+  if (length > 0)
+    png.insert(png.end(), chunkData, chunkData + length);
+  uint32_t  crc = crc32(0L, &png[typeStart], (uInt)(4 + length));
+  AppendBigEndian32(png, crc);
+}
+
+
+// Compresses data[start, start + length) as raw deflate data, using the preceding
+// (up to) 32 KB as the dictionary; all but the last chunk end with a sync flush,
+// so the pieces can be concatenated. Returns false on failure.
+static bool DeflateChunk( const unsigned char *data, size_t start, size_t length,
+						bool lastChunk, std::vector<unsigned char> &compressed )
+{
+  z_stream  stream;
+  memset(&stream, 0, sizeof(stream));
+  if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, 
+  					Z_DEFAULT_STRATEGY) != Z_OK)
+    return false;
+  if (start > 0) {
+    size_t  dictionaryLength = std::min(start, ZLIB_WINDOW_BYTES);
+    deflateSetDictionary(&stream, data + start - dictionaryLength, (uInt)dictionaryLength);
+  }
+  // (extra room for the sync-flush marker)
+  compressed.resize(deflateBound(&stream, (uLong)length) + 16);
+  stream.next_in = (Bytef *)(data + start);
+  stream.avail_in = (uInt)length;
+  stream.next_out = compressed.data();
+  stream.avail_out = (uInt)compressed.size();
+  int  status = deflate(&stream, lastChunk ? Z_FINISH : Z_SYNC_FLUSH);
+  bool  okay = ((lastChunk && (status == Z_STREAM_END)) || ((! lastChunk) && (status == Z_OK)
+  				&& (stream.avail_in == 0)));
+  compressed.resize(stream.total_out);
+  deflateEnd(&stream);
+  return okay;
+}
+
+
+// Encodes 8-bit RGB pixel values (3 bytes per pixel, rows in top-to-bottom order)
+// as a PNG file in pngData; returns false if compression failed
+bool EncodePNG( const unsigned char *pixels, int width, int height, 
+				std::vector<unsigned char> &pngData )
+{
+  const int  bytesPerPixel = 3;
+  const size_t  rowBytes = (size_t)width*bytesPerPixel;
+  const size_t  filteredRowBytes = rowBytes + 1;   // (includes filter-type byte)
+
+  // filter the rows (each depends only on itself and the unfiltered row above it)
+  std::vector<unsigned char>  filtered(filteredRowBytes*height);
+  std::vector<unsigned char>  zeroRow(rowBytes, 0);
+  #pragma omp parallel
+  {
+  std::vector<unsigned char>  scratch;
+  #pragma omp for schedule(static)
+  for (int y = 0; y < height; y++) {
+    const unsigned char *prevRow = (y > 0) ? pixels + (y - 1)*rowBytes : zeroRow.data();
+    FilterPNGRowAdaptive(pixels + y*rowBytes, prevRow, (int)rowBytes, bytesPerPixel, 
+    					&filtered[y*filteredRowBytes], scratch);
+  }
+  }
+
+  // compress fixed-size chunks in parallel, along with their Adler-32 checksums
+  size_t  totalBytes = filtered.size();
+  int  nChunks = std::max((int)((totalBytes + PNG_CHUNK_BYTES - 1) / PNG_CHUNK_BYTES), 1);
+  std::vector<std::vector<unsigned char>>  compressedChunks(nChunks);
+  std::vector<uLong>  chunkAdlers(nChunks);
+  int  nFailures = 0;
+  #pragma omp parallel for schedule(dynamic) reduction(+:nFailures)
+  for (int n = 0; n < nChunks; n++) {
+    size_t  start = n*PNG_CHUNK_BYTES;
+    size_t  length = std::min(PNG_CHUNK_BYTES, totalBytes - start);
+    chunkAdlers[n] = adler32(adler32(0L, Z_NULL, 0), &filtered[start], (uInt)length);
+    if (! DeflateChunk(filtered.data(), start, length, (n == nChunks - 1), 
+    					compressedChunks[n]))
+      nFailures++;
+  }
+  if (nFailures > 0)
+    return false;
+
+  // assemble the zlib stream: header (deflate, 32K window, default compression),
+  // concatenated chunks, and the combined checksum
+  std::vector<unsigned char>  zlibData = {0x78, 0x9c};
+  uLong  adler = adler32(0L, Z_NULL, 0);
+  for (int n = 0; n < nChunks; n++) {
+    zlibData.insert(zlibData.end(), compressedChunks[n].begin(), compressedChunks[n].end());
+    size_t  length = std::min(PNG_CHUNK_BYTES, totalBytes - n*PNG_CHUNK_BYTES);
+    adler = adler32_combine(adler, chunkAdlers[n], (z_off_t)length);
+  }
+  AppendBigEndian32(zlibData, (uint32_t)adler);
+
+  const unsigned char  signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+  std::vector<unsigned char>  header;
+  AppendBigEndian32(header, width);
+  AppendBigEndian32(header, height);
+  header.push_back(8);   // bit depth
+  header.push_back(2);   // color type = RGB
+  header.push_back(0);   // compression method
+  header.push_back(0);   // filter method
+  header.push_back(0);   // no interlacing
+  pngData.assign(signature, signature + 8);
+  AppendPNGChunk(pngData, "IHDR", header.data(), header.size());
+  for (size_t i = 0; i < zlibData.size(); i += MAX_IDAT_BYTES)
+    AppendPNGChunk(pngData, "IDAT", &zlibData[i], std::min(MAX_IDAT_BYTES, zlibData.size() - i));
+  AppendPNGChunk(pngData, "IEND", NULL, 0);
+  return true;
+}
+
+
+void SaveImagePNG( Color *image, int width, int height, std::string imageFilename,
+					bool gammaCorrect )
 {
   std::string outputFilename = imageFilename;  // assumed to already end in ".png"
-  unsigned char *outputImage;
-  int imageSize = width*height;
+  std::vector<unsigned char> bytes(3*(size_t)width*height);
+  ConvertImageToBytes(image, width*height, gammaCorrect, bytes.data());
 
-  outputImage = (unsigned char *)malloc(3*imageSize*sizeof(unsigned char));
-  
-  for (int i = 0; i < width*height; ++i) {
-    outputImage[3*i] = GammaCorrectToByte(image[i].r);
-    outputImage[3*i + 1] = GammaCorrectToByte(image[i].g);
-    outputImage[3*i + 2] = GammaCorrectToByte(image[i].b);    
-  } 
-
-  int result = stbi_write_png(outputFilename.c_str(), width, height, 3, outputImage, 3*width);
-  if (result > 0)
+  std::vector<unsigned char> pngData;
+  bool result = EncodePNG(bytes.data(), width, height, pngData);
+  if (result) {
+    std::ofstream ofs(outputFilename.c_str(), std::ios::out | std::ios::binary); 
+    ofs.write((const char *)pngData.data(), pngData.size());
+    result = ofs.good();
+  }
+  if (result)
     printf("Saved PNG image file \"%s\"\n", imageFilename.c_str());
   else
     printf("ERROR: failed attempt to save PNG image file \"%s\"\n", imageFilename.c_str());
-
-  free(outputImage);
 }
 
 
@@ -166,25 +523,83 @@ void SaveImagePNG( Color *image, int width, int height, std::string imageFilenam
 // img[j][i].g=floatToHalf(*(img_ptr++));
 // img[j][i].b=floatToHalf(*(img_ptr++));
 
+int ParseEXRCompression( const std::string compressionName )
+{
+  if (compressionName == "none")
+    return EXR_COMPRESSION_NONE;
+  if (compressionName == "zip")
+    return EXR_COMPRESSION_ZIP;
+  if (compressionName == "piz")
+    return EXR_COMPRESSION_PIZ;
+  if (compressionName == "dwaa")
+    return EXR_COMPRESSION_DWAA;
+  return -1;
+}
+
+
+Imf::Compression OpenEXRCompression( int compression )
+{
+  switch (compression) {
+    case EXR_COMPRESSION_NONE:
+      return Imf::NO_COMPRESSION;
+    case EXR_COMPRESSION_PIZ:
+      return Imf::PIZ_COMPRESSION;
+    case EXR_COMPRESSION_DWAA:
+      return Imf::DWAA_COMPRESSION;
+    default:
+      return Imf::ZIP_COMPRESSION;
+  }
+}
+
+
 /// Simplistic function for saving rendered image in OpenEXR format (assumes
 /// no rendered alpha channel; output image has alpha = 1 everywhere).
-void SaveImageOpenEXR( Color *image, int width, int height, std::string imageFilename )
+/// The RGB values are read directly from image.
+void SaveImageOpenEXR( Color *image, int width, int height, std::string imageFilename,
+						const exrOutputOptions &exrOptions )
 {
-  std::string outputFilename = imageFilename;  // assumed to already end in ".exr"
-  int nPixels = width*height;
-  Imf::Rgba *pixelsOpenEXR = (Imf::Rgba *)malloc(nPixels * sizeof(Imf::Rgba));
-  
-  for (int i = 0; i < nPixels; ++i) {
-    pixelsOpenEXR[i].r = Imf::floatToHalf(image[i].r);
-    pixelsOpenEXR[i].g = Imf::floatToHalf(image[i].g);
-    pixelsOpenEXR[i].b = Imf::floatToHalf(image[i].b);
-    pixelsOpenEXR[i].a = Imf::floatToHalf(1.0);
+  // alpha = 1 comes from a single value, with zero stride
+  static const float  constantAlpha = 1.0;
+  std::vector<exrChannel>  channels(4);
+  const char  *channelNames[3] = {"R", "G", "B"};
+  for (int k = 0; k < 3; k++) {
+    channels[k].name = channelNames[k];
+    channels[k].data = &image[0].r + k;
+    channels[k].xStride = sizeof(Color);
   }
+  channels[3].name = "A";
+  channels[3].data = &constantAlpha;
+  channels[3].xStride = 0;
 
-  Imf::RgbaOutputFile file(imageFilename.c_str(), width, height, Imf::WRITE_RGBA); 
-  file.setFrameBuffer(pixelsOpenEXR, 1, width);
+  SaveImageOpenEXRChannels(channels, width, height, imageFilename, exrOptions);
+}
+
+
+/// Saves an arbitrary set of channels (e.g., RGBA plus AOV layers such as "depth.Z"
+/// or "normal.X") in one OpenEXR file. OpenEXR reads the values directly from the
+/// caller's arrays (converting to half precision where requested), so no copy of
+/// the image is made; compression is done in parallel by OpenEXR's thread pool.
+void SaveImageOpenEXRChannels( const std::vector<exrChannel> &channels, int width, 
+								int height, std::string imageFilename,
+								const exrOutputOptions &exrOptions )
+{
+  InitOpenEXRThreads();
+
+  Imf::Header header(width, height);
+  header.compression() = OpenEXRCompression(exrOptions.compression);
+  Imf::FrameBuffer frameBuffer;
+  for (const exrChannel &channel : channels) {
+    bool  fullFloat = (channel.fullFloat || exrOptions.fullFloat);
+    Imf::PixelType pixelType = fullFloat ? Imf::FLOAT : Imf::HALF;
+    header.channels().insert(channel.name, Imf::Channel(pixelType));
+    // (the frame buffer is always float; OpenEXR does any conversion to half)
+    frameBuffer.insert(channel.name, Imf::Slice(Imf::FLOAT, (char *)channel.data,
+    						channel.xStride, channel.xStride*width));
+  }
+
+  Imf::OutputFile file(imageFilename.c_str(), header, Imf::globalThreadCount());
+  file.setFrameBuffer(frameBuffer);
   file.writePixels(height);
-  printf("Saved OpenEXR image file \"%s\"\n", imageFilename.c_str());
-  
-  free(pixelsOpenEXR);
+  printf("Saved OpenEXR image file \"%s\" (%d channels)\n", imageFilename.c_str(), 
+  		(int)channels.size());
 }
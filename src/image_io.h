@@ -4,22 +4,64 @@
 #define _IMAGE_IO_H_
 
 #include <string>
+#include <vector>
 #include "color.h"
 
 
+// Compression for OpenEXR output
+const int  EXR_COMPRESSION_NONE = 0;
+const int  EXR_COMPRESSION_ZIP = 1;   // lossless (default)
+const int  EXR_COMPRESSION_PIZ = 2;   // lossless, wavelet-based (good for noisy images)
+const int  EXR_COMPRESSION_DWAA = 3;   // lossy (for half-precision channels)
+
+/// Settings for OpenEXR output
+typedef struct {
+  int  compression = EXR_COMPRESSION_ZIP;
+  bool  fullFloat = false;   // save all channels as 32-bit float (default = 16-bit half)
+} exrOutputOptions;
+
+/// Converts "none", "zip", "piz", or "dwaa" to one of the EXR_COMPRESSION_ values;
+/// returns -1 for anything else
+int ParseEXRCompression( const std::string compressionName );
+
+/// One channel of a multi-channel OpenEXR image: the value for pixel i (in
+/// row-major order) is the float at (char *)data + i*xStride
+typedef struct {
+  std::string  name;   // e.g., "R", "A", "depth.Z"
+  const float  *data = nullptr;
+  size_t  xStride = sizeof(float);   // bytes between successive pixels
+  bool  fullFloat = false;   // save as 32-bit float (default = 16-bit half)
+} exrChannel;
+
+
 Color * ReadImage( const std::string imageName, int &width, int &height );
 
+Color * ReadImageOpenEXR( const std::string imageName, int &width, int &height );
+
 
+/// gammaCorrect = false saves values as-is (for PPM and PNG output), e.g. for alpha
+/// masks and other data images
 void SaveImage( Color *image, int width, int height, const std::string outputImageName, 
-				int outputImageFormat );
+				int outputImageFormat, bool gammaCorrect=true, 
+				const exrOutputOptions &exrOptions=exrOutputOptions() );
 
 void SaveImagePPM( Color *image, int width=640, int height=480, 
-					std::string imageFilename="untitled" );
+					std::string imageFilename="untitled", bool gammaCorrect=true );
 
 void SaveImagePNG( Color *image, int width=640, int height=480, 
-					std::string imageFilename="untitled" );
+					std::string imageFilename="untitled", bool gammaCorrect=true );
+
+/// Encodes 8-bit RGB values (3 bytes per pixel, top row first) as a PNG file in
+/// pngData (rows are filtered and compressed in parallel); returns false on failure
+bool EncodePNG( const unsigned char *pixels, int width, int height, 
+				std::vector<unsigned char> &pngData );
 
 void SaveImageOpenEXR( Color *image, int width=640, int height=480, 
-						std::string imageFilename="untitled" );
+						std::string imageFilename="untitled",
+						const exrOutputOptions &exrOptions=exrOutputOptions() );
+
+void SaveImageOpenEXRChannels( const std::vector<exrChannel> &channels, int width, 
+								int height, std::string imageFilename,
+								const exrOutputOptions &exrOptions=exrOutputOptions() );
 
 #endif   // _IMAGE_IO_H_
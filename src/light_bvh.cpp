@@ -0,0 +1,204 @@
+// Code for a bounding-volume hierarchy of lights.
+//
+// The tree is built top-down, splitting each set of lights at the median of
+// the light centers along the longest axis of the centers' bounding box. Each
+// node stores the bounds and summed power of its lights.
+//
+// Nodes also store a cone bounding the emission normals of their one-sided
+// (rect) lights, which emit only into the half-space in front of them.
+//
+// Sampling starts at the root and picks one child at each level with
+// probability proportional to the children's estimated importance (power
+// divided by squared distance to the node, or just power for lights without
+// distance falloff). The importance is zero if the node is entirely behind the
+// shading surface, or if the shading point is behind all of the node's lights:
+// i.e., if the angle between the normal cone's axis and the direction from the
+// node to the point exceeds 90 degrees plus the cone's half-angle plus the angle
+// subtended by the node's bounding sphere.
+// The probability of the chosen light is the product of the per-level
+// probabilities, so weighting its contribution by 1/pdf gives an unbiased
+// estimate of the summed contribution of all the lights.
+
+#include <math.h>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+#include "geometry.h"
+#include "lights.h"
+#include "light_bvh.h"
+
+// lower limit for squared distances, to avoid dividing by ~ zero
+const float  MIN_DISTANCE_SQUARED = 1.0e-6;
+// keeps rescaled random numbers strictly below 1
+const float  ONE_MINUS_EPSILON = 0.99999994;
+
+
+LightBVH::LightBVH( const vector<shared_ptr<Light>> &lights )
+{
+  vector<int>  boundedLights;
+  Point  boundsMin, boundsMax;
+
+  for (int i = 0; i < (int)lights.size(); i++) {
+    if (lights[i]->GetBounds(boundsMin, boundsMax))
+      boundedLights.push_back(i);
+    else
+      unboundedLights.push_back(i);
+  }
+  nLightsInTree = (int)boundedLights.size();
+  if (nLightsInTree > 0) {
+    nodes.reserve(2*nLightsInTree - 1);
+    BuildNode(boundedLights, 0, nLightsInTree, lights);
+  }
+}
+
+
+// Builds the node for lights lightIndices[start] ... lightIndices[end - 1] (and,
+// recursively, its children); returns the index of the new node
+int LightBVH::BuildNode( vector<int> &lightIndices, int start, int end,
+						const vector<shared_ptr<Light>> &lights )
+{
+  lightBVHNode  node;
+  Point  lightMin, lightMax, planePoint;
+  Vector  lightNormal, normalSum(0.0, 0.0, 0.0);
+  bool  allOneSided = true;
+  Point  centerMin(kInfinity, kInfinity, kInfinity);
+  Point  centerMax(-kInfinity, -kInfinity, -kInfinity);
+
+  node.boundsMin = Point(kInfinity, kInfinity, kInfinity);
+  node.boundsMax = Point(-kInfinity, -kInfinity, -kInfinity);
+  node.falloffPower = node.constantPower = 0.0;
+  node.child1 = node.child2 = -1;
+  node.lightIndex = lightIndices[start];
+  for (int i = start; i < end; i++) {
+    const shared_ptr<Light> &light = lights[lightIndices[i]];
+    light->GetBounds(lightMin, lightMax);
+    node.boundsMin = Point(fminf(node.boundsMin.x, lightMin.x), fminf(node.boundsMin.y, lightMin.y),
+    						fminf(node.boundsMin.z, lightMin.z));
+    node.boundsMax = Point(fmaxf(node.boundsMax.x, lightMax.x), fmaxf(node.boundsMax.y, lightMax.y),
+    						fmaxf(node.boundsMax.z, lightMax.z));
+    Point  center = lightMin + (lightMax - lightMin)*0.5;
+    centerMin = Point(fminf(centerMin.x, center.x), fminf(centerMin.y, center.y),
+    					fminf(centerMin.z, center.z));
+    centerMax = Point(fmaxf(centerMax.x, center.x), fmaxf(centerMax.y, center.y),
+    					fmaxf(centerMax.z, center.z));
+    if (light->HasDistanceFalloff())
+      node.falloffPower += light->GetPower();
+    else
+      node.constantPower += light->GetPower();
+    if (light->GetEmissionPlane(planePoint, lightNormal))
+      normalSum = normalSum + lightNormal;
+    else
+      allOneSided = false;
+  }
+  // normal cone: axis = mean normal, widened to include every light's normal
+  node.normalAxis = Vector(0.0, 0.0, 0.0);
+  node.cosNormalSpread = -1.0;
+  if (allOneSided && (normalSum.Length() > 1.0e-3)) {
+    node.normalAxis = Normalize(normalSum);
+    node.cosNormalSpread = 1.0;
+    for (int i = start; i < end; i++) {
+      lights[lightIndices[i]]->GetEmissionPlane(planePoint, lightNormal);
+      node.cosNormalSpread = fminf(node.cosNormalSpread, Dot(node.normalAxis, lightNormal));
+    }
+  }
+  int  nodeIndex = (int)nodes.size();
+  nodes.push_back(node);
+  if (end - start == 1)
+    return nodeIndex;
+
+  // split at the median along the longest axis of the light centers
+  Vector  extent = centerMax - centerMin;
+  int  axis = 0;
+  if ((extent.y > extent.x) && (extent.y >= extent.z))
+    axis = 1;
+  else if ((extent.z > extent.x) && (extent.z > extent.y))
+    axis = 2;
+  int  middle = (start + end) / 2;
+  auto CenterAlongAxis = [&lights, axis]( int lightIndex ) {
+    Point  lightMin, lightMax;
+    lights[lightIndex]->GetBounds(lightMin, lightMax);
+    return 0.5f*(lightMin[axis] + lightMax[axis]);
+  };
+  std::nth_element(lightIndices.begin() + start, lightIndices.begin() + middle,
+  					lightIndices.begin() + end,
+  					[&CenterAlongAxis]( int a, int b ) { return CenterAlongAxis(a) < CenterAlongAxis(b); });
+  int  child1 = BuildNode(lightIndices, start, middle, lights);
+  int  child2 = BuildNode(lightIndices, middle, end, lights);
+  nodes[nodeIndex].child1 = child1;
+  nodes[nodeIndex].child2 = child2;
+  return nodeIndex;
+}
+
+
+float LightBVH::Importance( int nodeIndex, const Point &P, const Vector &n ) const
+{
+  const lightBVHNode &node = nodes[nodeIndex];
+
+  // can any part of the node be in front of the surface?
+  bool  inFront = false;
+  for (int corner = 0; (corner < 8) && (! inFront); corner++) {
+    Point  cornerPoint((corner & 1) ? node.boundsMax.x : node.boundsMin.x,
+    					(corner & 2) ? node.boundsMax.y : node.boundsMin.y,
+    					(corner & 4) ? node.boundsMax.z : node.boundsMin.z);
+    inFront = (Dot(cornerPoint - P, n) > 0.0);
+  }
+  if (! inFront)
+    return 0.0;
+
+  Vector  diagonal = node.boundsMax - node.boundsMin;
+  Point  center = node.boundsMin + diagonal*0.5;
+
+  // is P behind all of the node's (one-sided) lights?
+  if (node.cosNormalSpread > -1.0f) {
+    Vector  toP = P - center;
+    float  dist = toP.Length();
+    float  radius = 0.5f*diagonal.Length();
+    if (dist > radius) {
+      float  theta = acosf(fminf(fmaxf(Dot(node.normalAxis, toP)/dist, -1.0f), 1.0f));
+      float  thetaSpread = acosf(fminf(node.cosNormalSpread, 1.0f));
+      float  thetaBounds = asinf(radius/dist);
+      if (theta - thetaSpread - thetaBounds >= PI_OVER_TWO)
+        return 0.0;
+    }
+  }
+
+  // distance to the node's center, but no less than half its diagonal (so that
+  // points inside a cluster of lights don't over-weight it)
+  float  distSquared = fmaxf((center - P).LengthSquared(), 0.25f*diagonal.LengthSquared());
+  distSquared = fmaxf(distSquared, MIN_DISTANCE_SQUARED);
+  return node.falloffPower / distSquared + node.constantPower;
+}
+
+
+int LightBVH::SampleLight( const Point &P, const Vector &n, float u, float *pdf ) const
+{
+  *pdf = 0.0;
+  if ((nodes.size() == 0) || (Importance(0, P, n) <= 0.0))
+    return -1;
+
+  int  nodeIndex = 0;
+  float  probability = 1.0;
+  while (nodes[nodeIndex].child1 >= 0) {
+    const lightBVHNode &node = nodes[nodeIndex];
+    float  importance1 = Importance(node.child1, P, n);
+    float  importance2 = Importance(node.child2, P, n);
+    if (importance1 + importance2 <= 0.0)
+      return -1;
+    float  p1 = importance1 / (importance1 + importance2);
+    // reuse u for the next level by rescaling it within the chosen interval
+    if (u < p1) {
+      nodeIndex = node.child1;
+      u = u / p1;
+      probability *= p1;
+    }
+    else {
+      nodeIndex = node.child2;
+      u = (u - p1) / (1.0f - p1);
+      probability *= 1.0f - p1;
+    }
+    u = fminf(u, ONE_MINUS_EPSILON);
+  }
+  *pdf = probability;
+  return nodes[nodeIndex].lightIndex;
+}
@@ -0,0 +1,63 @@
+// Code for a bounding-volume hierarchy of lights, used to choose a small number
+// of lights to sample at each shading point (in proportion to their estimated
+// contribution), instead of evaluating every light in the scene.
+
+#ifndef _LIGHT_BVH_H_
+#define _LIGHT_BVH_H_
+
+#include <vector>
+#include <memory>
+
+#include "geometry.h"
+#include "lights.h"
+
+using namespace std;
+
+
+/// Node of the light hierarchy; leaf nodes hold a single light
+typedef struct {
+  Point  boundsMin, boundsMax;
+  // cone (axis, cosine of half-angle) containing the emission normals of the node's
+  // one-sided lights; cosNormalSpread = -1 if any light emits in all directions
+  Vector  normalAxis;
+  float  cosNormalSpread;
+  float  falloffPower;    // summed power of lights whose intensity falls off as 1/r^2
+  float  constantPower;   // summed power of lights without distance falloff
+  int  child1, child2;    // indices of child nodes (= -1 for leaf nodes)
+  int  lightIndex;        // index of light in input list (leaf nodes only)
+} lightBVHNode;
+
+
+class LightBVH
+{
+  public:
+    /// Builds the tree from all lights with finite bounds; the others (distant
+    /// and environment lights) are listed in UnboundedLights() and should always
+    /// be evaluated.
+    LightBVH( const vector<shared_ptr<Light>> &lights );
+
+    /// Chooses a light to sample for shading point P with surface normal n, with
+    /// probability proportional to its estimated importance; u = uniform random
+    /// number in [0,1). Returns the index of the light in the list the tree was
+    /// built from, with its probability in *pdf; returns -1 if no light in the
+    /// tree can illuminate P.
+    int SampleLight( const Point &P, const Vector &n, float u, float *pdf ) const;
+
+    /// Estimated contribution of the lights in a node to point P (= 0 if all of
+    /// the node is behind the surface, or P is behind all of the node's lights)
+    float Importance( int nodeIndex, const Point &P, const Vector &n ) const;
+
+    int NLights( ) const { return nLightsInTree; };
+    const vector<int> & UnboundedLights( ) const { return unboundedLights; };
+
+  private:
+    int BuildNode( vector<int> &lightIndices, int start, int end,
+    				const vector<shared_ptr<Light>> &lights );
+
+    vector<lightBVHNode>  nodes;
+    vector<int>  unboundedLights;
+    int  nLightsInTree;
+};
+
+
+#endif  // _LIGHT_BVH_H_
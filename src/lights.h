@@ -7,12 +7,21 @@
 #include <cstdlib> 
 #include <math.h>
 #include <stdio.h>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <string>
 #include "geometry.h"
 #include "transform.h"
 #include "color.h"
 #include "mersenne_twister.h"
+#include "environment_map.h"
 #include "definitions.h"
 
+// resolution (in latitude) of the grid used to importance-sample environment
+// lights; the grid is twice as wide in longitude
+const int  ENVLIGHT_GRID_HEIGHT = 128;
+
 
 class Light
 {
@@ -37,6 +46,16 @@ public:
   virtual void Illuminate( const Point &P, Vector &lightDir, Color &lightIntensity,
   						 float &distance ) const = 0;
   
+  // Version of Illuminate for lights with extent (area and environment lights),
+  // where the caller supplies the 2D sample (u,v) in [0,1)^2 which determines
+  // the point on the light; lights without extent ignore it. (The plain version
+  // above uses random numbers from the global RNG instead.)
+  virtual void Illuminate( const Point &P, float, float, Vector &lightDir, 
+  						Color &lightIntensity, float &distance ) const
+  {
+    Illuminate(P, lightDir, lightIntensity, distance);
+  }
+  
   // this is the number of random samples on the light surface that can be provided;
   // for Point and Distant lights this is always 1
   virtual int NSamples( ) const
@@ -44,15 +63,70 @@ public:
     return 1;
   }
   
+  // Bounding box of the region the light emits from; returns false for lights
+  // without a finite extent (distant and environment lights)
+  virtual bool GetBounds( Point &, Point & ) const
+  {
+    return false;
+  }
+  
+  // Rough (scalar) brightness of the light, used to estimate how much it can
+  // contribute at a given point; for lights with distance falloff, this is the
+  // intensity at unit distance
+  virtual float GetPower( ) const
+  {
+    return luminosity * Luminance(lightColor);
+  }
+  
+  // true if the light's intensity falls off as 1/distance^2
+  virtual bool HasDistanceFalloff( ) const
+  {
+    return false;
+  }
+  
+  // For lights which only emit on one side of a plane (rect lights): sets a point
+  // on the plane and the plane's normal (pointing to the lit side) and returns
+  // true; points with Dot(P - planePoint, normal) <= 0 get no light. Returns false
+  // for lights which emit in all directions.
+  virtual bool GetEmissionPlane( Point &, Vector & ) const
+  {
+    return false;
+  }
+  
   int GetType( ) const
   { 
     return lightType; 
   };
 
+  // Sets influenceRadius so that beyond it the light's (unoccluded) contribution
+  // to a Lambertian surface with base color <= 1 is always < cutoff; lights
+  // without distance falloff keep unlimited influence
+  virtual void SetContributionCutoff( float )
+  {
+    return;
+  }
+
+  // Sets center and radius of the sphere outside of which the light is treated
+  // as having no effect (bounding sphere of the light, expanded by influenceRadius);
+  // returns false if the light's influence is unlimited
+  bool GetInfluenceSphere( Point &center, float &radius ) const
+  {
+    Point boundsMin, boundsMax;
+    if ((influenceRadius >= kInfinity) || (! GetBounds(boundsMin, boundsMax)))
+      return false;
+    Vector diagonal = boundsMax - boundsMin;
+    center = boundsMin + 0.5*diagonal;
+    radius = 0.5*diagonal.Length() + influenceRadius;
+    return true;
+  }
+
   // data members
   int  lightType;
   Color lightColor;   // should have normalized (0--1) channel values
   float luminosity;
+  float influenceRadius = kInfinity;   // range of light beyond its own bounds
+  // if not empty, the light illuminates only shapes with these names
+  std::vector<std::string> linkedShapeNames;
 };
 
 
@@ -79,6 +153,29 @@ public:
     lightIntensity = lightColor * luminosity / (FOUR_PI * distSquared);
   } 
 
+  bool GetBounds( Point &boundsMin, Point &boundsMax ) const
+  {
+    boundsMin = boundsMax = lightPosition;
+    return true;
+  }
+  
+  float GetPower( ) const
+  {
+    return luminosity * Luminance(lightColor) / FOUR_PI;
+  }
+  
+  bool HasDistanceFalloff( ) const
+  {
+    return true;
+  }
+
+  // Peak contribution at distance r is (brightest channel of intensity) / PI
+  // (for normal incidence), with intensity = luminosity/(4 PI r^2)
+  void SetContributionCutoff( float cutoff )
+  {
+    influenceRadius = sqrtf(luminosity * MaxComponent(lightColor) / (FOUR_PI * PI * cutoff));
+  }
+
   // additional data members
   Point lightPosition;   // location of light in world space
 };
@@ -110,7 +207,8 @@ public:
 
 
 
-// Very basic rectangular area light, aligned with world x-z plane, oriented facing down
+// Very basic rectangular area light, aligned with world x-z plane, oriented facing down;
+// it only illuminates points below the plane of the rectangle
 class RectLight : public Light
 { 
 public:
@@ -137,21 +235,39 @@ public:
   
   void Illuminate( const Point &P, Vector &lightDir, Color &lightIntensity, float &distance ) const
   {
-    Point randomLightPoint = lightPosition + GetRandomSurfacePoint();
+    float u = genrand_real1();
+    float v = genrand_real1();
+    Illuminate(P, u, v, lightDir, lightIntensity, distance);
+  }
+
+  void Illuminate( const Point &P, float u, float v, Vector &lightDir, Color &lightIntensity, 
+  					float &distance ) const
+  {
+    Point lightPoint = lightPosition + GetSurfacePoint(u, v);
     // direction vector from this point on rectangle's surface to P
-    lightDir = P - randomLightPoint;
+    lightDir = P - lightPoint;
     distance = lightDir.Length();
     lightDir = Normalize(lightDir);
-    lightIntensity = lightColor * luminosity;
+    if (Dot(P - lightPosition, normal) > 0.0)
+      lightIntensity = lightColor * luminosity;
+    else
+      lightIntensity = Color(0);
   }
 
   // get a random offset vector on the rectangle's surface (relative to center of rectangle)
   Vector GetRandomSurfacePoint( ) const
   {
-    float xOffset, zOffset;
-    
-    xOffset = 2*genrand_real1() - 1.0;
-    zOffset = 2*genrand_real1() - 1.0;
+    float u = genrand_real1();
+    float v = genrand_real1();
+    return GetSurfacePoint(u, v);
+  }
+
+  // offset vector (relative to center of rectangle) for point (u,v) on the
+  // rectangle's surface, with (u,v) in [0,1)^2
+  Vector GetSurfacePoint( float u, float v ) const
+  {
+    float xOffset = 2*u - 1.0;
+    float zOffset = 2*v - 1.0;
     return Vector(xSize*xOffset, 0.0, zSize*zOffset);
   }
 
@@ -160,6 +276,20 @@ public:
     return nSamples;
   }
   
+  bool GetBounds( Point &boundsMin, Point &boundsMax ) const
+  {
+    boundsMin = lightPosition - Vector(xSize, 0.0, zSize);
+    boundsMax = lightPosition + Vector(xSize, 0.0, zSize);
+    return true;
+  }
+  
+  bool GetEmissionPlane( Point &planePoint, Vector &planeNormal ) const
+  {
+    planePoint = lightPosition;
+    planeNormal = normal;
+    return true;
+  }
+  
   // additional data members
   Point lightPosition;
   Vector normal;
@@ -188,30 +318,71 @@ public:
 //     init_genrand(rngSeed);
 //   }
   
+  // Samples a direction uniformly within the cone subtended by the sphere as
+  // seen from P, so that every sample lands on the visible hemisphere. The
+  // sphere is treated as having uniform radiance luminosity/(solid angle of the
+  // cone), so weighting each sample by 1/pdf (= the cone's solid angle) gives
+  // an intensity of luminosity per sample, independent of distance (as for the
+  // rest of the area lights). For points inside the sphere, we fall back to
+  // sampling the whole surface.
   void Illuminate( const Point &P, Vector &lightDir, Color &lightIntensity, float &distance ) const
   {
-    // FIXME: Does this correctly account for orientation? (we don't really want
-    // a point on the *back* side of the sphere, relative to lightDir)
-    
-    // get random point on surface of sphere (translate to world coordinates)
-    Point randomLightPoint = lightPosition + GetRandomSurfacePoint();
-    // direction vector from this point on sphere's surface to P
-    lightDir = P - randomLightPoint;
-    distance = lightDir.Length();
-    lightDir = Normalize(lightDir);    
-    // correct this by computing dot product of lightDir and normal?
+    float u = genrand_real1();
+    float v = genrand_real2();
+    Illuminate(P, u, v, lightDir, lightIntensity, distance);
+  }
+
+  void Illuminate( const Point &P, float uSample, float vSample, Vector &lightDir, 
+  					Color &lightIntensity, float &distance ) const
+  {
+    Vector toCenter = lightPosition - P;
+    float distSquared = toCenter.LengthSquared();
+    float radiusSquared = radius*radius;
     lightIntensity = lightColor * luminosity;
+    
+    if (distSquared <= radiusSquared) {
+      Point lightPoint = lightPosition + GetSurfacePoint(uSample, vSample);
+      lightDir = P - lightPoint;
+      distance = lightDir.Length();
+      lightDir = Normalize(lightDir);
+      return;
+    }
+    
+    float centerDist = sqrtf(distSquared);
+    Vector w = toCenter / centerDist;
+    Vector u, v;
+    CoordinateSystem(w, &u, &v);
+    // uniform sampling of the cone: cos(theta) uniform in [cosThetaMax, 1]
+    float cosThetaMax = sqrtf(fmaxf(0.0, 1.0 - radiusSquared/distSquared));
+    float cosTheta = 1.0 - uSample*(1.0 - cosThetaMax);
+    float sinTheta = sqrtf(fmaxf(0.0, 1.0 - cosTheta*cosTheta));
+    float phi = TWO_PI*vSample;
+    Vector sampleDir = u*(sinTheta*cosf(phi)) + v*(sinTheta*sinf(phi)) + w*cosTheta;
+    
+    // distance to the (near) surface of the sphere along sampleDir; we stop just
+    // short of the surface so that a visible sphere doesn't shadow its own light
+    float discriminant = fmaxf(0.0, radiusSquared - distSquared*sinTheta*sinTheta);
+    distance = centerDist*cosTheta - sqrtf(discriminant) - BIAS;
+    lightDir = -sampleDir;
   }
 
   // get a random point on the sphere's surface (expressed as vector offset from
-  // center of sphere)
-  // FIXME: Is this the correct surface-of-sphere sampling?
+  // center of sphere), uniformly distributed over the surface
   Vector GetRandomSurfacePoint( ) const
+  {
+    float u = genrand_real1();
+    float v = genrand_real2();
+    return GetSurfacePoint(u, v);
+  }
+
+  // point (uSample,vSample) in [0,1)^2 mapped uniformly onto the sphere's surface
+  // (expressed as vector offset from center of sphere)
+  Vector GetSurfacePoint( float uSample, float vSample ) const
   {
     float x, y, z, u, theta, sqrt_one_minus_u2;
     
-    theta = 2*PI*genrand_real2();
-    u = 2*genrand_real1() - 1.0;
+    theta = 2*PI*vSample;
+    u = 2*uSample - 1.0;
     sqrt_one_minus_u2 = sqrt(1.0 - u*u);
     x = radius * sqrt_one_minus_u2 * cos(theta);
     y = radius * sqrt_one_minus_u2 * sin(theta);
@@ -224,6 +395,13 @@ public:
     return nSamples;
   }
   
+  bool GetBounds( Point &boundsMin, Point &boundsMax ) const
+  {
+    boundsMin = lightPosition - Vector(radius);
+    boundsMax = lightPosition + Vector(radius);
+    return true;
+  }
+  
   // additional data members
   Point lightPosition;
   float radius;
@@ -231,4 +409,124 @@ public:
 };
 
 
+// Image-based lighting from the scene's environment (map or constant color).
+// Sample directions are chosen in proportion to the environment's luminance
+// (weighted by solid angle), using a piecewise-constant distribution over a
+// latitude-longitude grid: a marginal CDF over rows (latitude) and a
+// conditional CDF over columns within each row. The returned intensity is
+// radiance/pdf, so that averaging over samples gives an unbiased estimate of
+// the diffuse illumination.
+// Directions: theta = polar angle from +y, phi = azimuth from +x toward +z
+class EnvironmentLight : public Light
+{ 
+public:
+  EnvironmentLight( shared_ptr<Environment> env, const float lum, const int nsamps=1 )
+  {
+    lightType = LIGHT_ENVIRONMENT;
+    environment = env;
+    lightColor = Color(1);
+    luminosity = lum;
+    nSamples = nsamps;
+    gridHeight = ENVLIGHT_GRID_HEIGHT;
+    gridWidth = 2*ENVLIGHT_GRID_HEIGHT;
+    totalWeight = 0.0;
+  }
+
+  // Tabulates the environment's luminance over the grid (using lookups filtered
+  // to the size of a grid cell) and builds the CDFs. Must be called after the
+  // environment's images are available (Scene::PrepareForRender does this).
+  void BuildDistribution( )
+  {
+    Ray  gridRay;
+    gridRay.coneSpread = PI / gridHeight;
+    rowCDF.assign(gridHeight + 1, 0.0);
+    columnCDFs.assign(gridHeight*(gridWidth + 1), 0.0);
+    for (int j = 0; j < gridHeight; j++) {
+      float  theta = PI*(j + 0.5f)/gridHeight;
+      float  sinTheta = sinf(theta);
+      float  *cdf = &columnCDFs[j*(gridWidth + 1)];
+      for (int i = 0; i < gridWidth; i++) {
+        gridRay.dir = GetDirection(theta, TWO_PI*(i + 0.5f)/gridWidth);
+        float  luminance = fmaxf(Luminance(environment->GetEnvironmentColor(gridRay)), 0.0f);
+        cdf[i + 1] = cdf[i] + luminance*sinTheta;
+      }
+      rowCDF[j + 1] = rowCDF[j] + cdf[gridWidth];
+    }
+    totalWeight = rowCDF[gridHeight];
+  }
+
+  void Illuminate( const Point &P, Vector &lightDir, Color &lightIntensity, float &distance ) const
+  {
+    float u = genrand_real1();
+    float v = genrand_real1();
+    Illuminate(P, u, v, lightDir, lightIntensity, distance);
+  }
+
+  void Illuminate( const Point &, float u, float v, Vector &lightDir, Color &lightIntensity, 
+  					float &distance ) const
+  {
+    distance = kInfinity;
+    lightIntensity = Color(0);
+    lightDir = Vector(0.0, -1.0, 0.0);
+    if (totalWeight <= 0.0)
+      return;
+    
+    // choose row, then column within row; position within the cell is uniform
+    float  rowFraction, columnFraction;
+    int  row = SampleCDF(rowCDF.data(), gridHeight, u, &rowFraction);
+    const float  *cdf = &columnCDFs[row*(gridWidth + 1)];
+    int  column = SampleCDF(cdf, gridWidth, v, &columnFraction);
+    float  theta = PI*(row + rowFraction)/gridHeight;
+    float  phi = TWO_PI*(column + columnFraction)/gridWidth;
+    float  sinTheta = sinf(theta);
+    if (sinTheta <= 0.0)
+      return;
+    
+    // pdf with respect to solid angle = (pdf over grid cells) / (solid angle of cell)
+    float  cellWeight = cdf[column + 1] - cdf[column];
+    float  pdf = (cellWeight / totalWeight) * gridWidth * gridHeight / (2.0f*PI*PI*sinTheta);
+    Ray  sampleRay;
+    sampleRay.dir = GetDirection(theta, phi);
+    sampleRay.coneSpread = PI / gridHeight;
+    lightDir = -sampleRay.dir;
+    lightIntensity = environment->GetEnvironmentColor(sampleRay) * (luminosity / pdf);
+  }
+
+  int NSamples( ) const
+  {
+    return nSamples;
+  }
+  
+  // additional data members
+  shared_ptr<Environment>  environment;
+  int  nSamples;
+  int  gridWidth, gridHeight;
+  vector<float>  rowCDF;   // gridHeight + 1 entries
+  vector<float>  columnCDFs;   // gridHeight rows of gridWidth + 1 entries
+  float  totalWeight;
+
+private:
+  static Vector GetDirection( float theta, float phi )
+  {
+    float  sinTheta = sinf(theta);
+    return Vector(sinTheta*cosf(phi), cosf(theta), sinTheta*sinf(phi));
+  }
+
+  // Returns the index of the interval of cdf (with nIntervals intervals, starting
+  // at cdf[0] = 0) containing the fraction u of the total; *fraction = position
+  // within that interval (0--1). Empty intervals are never chosen.
+  static int SampleCDF( const float *cdf, int nIntervals, float u, float *fraction )
+  {
+    float  target = u*cdf[nIntervals];
+    int  index = (int)(std::upper_bound(cdf + 1, cdf + nIntervals + 1, target) - (cdf + 1));
+    index = std::min(index, nIntervals - 1);
+    while ((index > 0) && (cdf[index + 1] <= cdf[index]))
+      index--;
+    float  width = cdf[index + 1] - cdf[index];
+    *fraction = (width > 0.0) ? fminf((target - cdf[index]) / width, 1.0f) : 0.5f;
+    return index;
+  }
+};
+
+
 #endif  // _LIGHTS_H_
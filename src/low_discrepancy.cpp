@@ -0,0 +1,88 @@
+// Code for generating low-discrepancy sample points.
+//
+// The 2D Sobol' points use the standard first two dimensions (the van der
+// Corput sequence in base 2, and the dimension generated by the polynomial
+// x + 1). Scrambling follows Burley (2020), "Practical Hash-based Owen
+// Scrambling", Journal of Computer Graphics Techniques 9(4): the point index
+// is shuffled by an Owen scramble (so that different seeds use the points in
+// different orders), and each dimension is then Owen-scrambled with its own
+// seed, using the Laine-Karras hash on the bit-reversed value.
+
+#include <stdint.h>
+
+#include "low_discrepancy.h"
+
+
+uint32_t PCGHash( uint32_t input )
+{
+  uint32_t  state = input*747796405u + 2891336453u;
+  uint32_t  word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+  return (word >> 22u) ^ word;
+}
+
+
+uint32_t HashCombine( uint32_t seed, uint32_t value )
+{
+  return seed ^ (PCGHash(value) + 0x9e3779b9u + (seed << 6) + (seed >> 2));
+}
+
+
+uint32_t ReverseBits( uint32_t x )
+{
+  x = (x << 16) | (x >> 16);
+  x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+  x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+  x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+  x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+  return x;
+}
+
+
+float BitsToUnitFloat( uint32_t bits )
+{
+  // use the top 24 bits, so that the result is exactly representable (and < 1)
+  return (bits >> 8) * (1.0f / 16777216.0f);
+}
+
+
+// Laine-Karras permutation: each output bit depends only on the input bits
+// *below* it, so when applied to the bit-reversed value it acts as a nested
+// uniform (Owen) scramble
+uint32_t LaineKarrasPermutation( uint32_t x, uint32_t seed )
+{
+  x += seed;
+  x ^= x * 0x6c50b47cu;
+  x ^= x * 0xb82f1e52u;
+  x ^= x * 0xc7afe638u;
+  x ^= x * 0x8d22f6e6u;
+  return x;
+}
+
+
+uint32_t OwenScramble( uint32_t x, uint32_t seed )
+{
+  return ReverseBits(LaineKarrasPermutation(ReverseBits(x), seed));
+}
+
+
+// Second dimension of the Sobol' sequence: direction numbers are
+// v_1 = 2^31, v_k = v_(k-1) XOR (v_(k-1) >> 1)
+uint32_t SobolSecondDimension( uint32_t index )
+{
+  uint32_t  result = 0;
+  for (uint32_t v = 1u << 31; index != 0; index >>= 1, v ^= v >> 1) {
+    if (index & 1)
+      result ^= v;
+  }
+  return result;
+}
+
+
+void SobolOwen2D( uint32_t index, uint32_t seed, float *u, float *v )
+{
+  uint32_t  shuffledIndex = OwenScramble(index, seed);
+  uint32_t  x = ReverseBits(shuffledIndex);
+  uint32_t  y = SobolSecondDimension(shuffledIndex);
+  *u = BitsToUnitFloat(OwenScramble(x, HashCombine(seed, 0)));
+  *v = BitsToUnitFloat(OwenScramble(y, HashCombine(seed, 1)));
+}
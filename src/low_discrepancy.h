@@ -0,0 +1,31 @@
+// Code for generating low-discrepancy sample points, plus the integer hash
+// functions used to decorrelate them (e.g., between pixels).
+
+#ifndef _LOW_DISCREPANCY_H_
+#define _LOW_DISCREPANCY_H_
+
+#include <stdint.h>
+
+
+/// PCG-style integer hash (good avalanche behavior; cheap)
+uint32_t PCGHash( uint32_t input );
+
+/// Combines a new value into an existing hash/seed
+uint32_t HashCombine( uint32_t seed, uint32_t value );
+
+uint32_t ReverseBits( uint32_t x );
+
+/// Converts 32 random bits to a float in [0,1)
+float BitsToUnitFloat( uint32_t bits );
+
+/// Owen scrambling (nested uniform scrambling) of the bits of x, as a function of seed
+uint32_t OwenScramble( uint32_t x, uint32_t seed );
+
+/// Point number index of a 2D Owen-scrambled Sobol' sequence (first two
+/// dimensions), with the point order also shuffled by seed. Sequences with
+/// different seeds are decorrelated; for any seed, the first 2^k points are
+/// well stratified.
+void SobolOwen2D( uint32_t index, uint32_t seed, float *u, float *v );
+
+
+#endif  // _LOW_DISCREPANCY_H_
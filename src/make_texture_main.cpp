@@ -0,0 +1,143 @@
+// Main program for "maketex", which converts an image (JPEG, PNG, OpenEXR, etc.)
+// into a preprocessed texture file: the full mip-map pyramid, stored as tiles
+// with RGBE or half-float texels. Texture files can be used anywhere an
+// environment image is expected, and are memory-mapped by perspectiva, so
+// that only the tiles actually needed for rendering are read from disk.
+
+#include <cstdlib>
+#include <cstdio>
+#include <string>
+
+#include "color.h"
+#include "utilities_pub.h"
+#include "commandline_parser.h"
+#include "image_io.h"
+#include "mipmap.h"
+#include "texture_file.h"
+
+using namespace std;
+
+
+typedef struct {
+  string  inputImageName;
+  string  outputFilename;
+  int  encoding;
+  int  tileSize;
+  int  wrapMode;
+} maketexOptions;
+
+
+/* Local Functions: */
+void ProcessInput( int argc, char *argv[], maketexOptions *theOptions );
+
+
+
+int main( int argc, char **argv )
+{
+  maketexOptions  options;
+  int  width, height;
+
+  ProcessInput(argc, argv, &options);
+
+  if (! FileExists(options.inputImageName.c_str())) {
+    fprintf(stderr, "ERROR: input image \"%s\" not found!\n", options.inputImageName.c_str());
+    fprintf(stderr, "Exiting...\n\n");
+    exit(1);
+  }
+  Color *pixels = ReadImage(options.inputImageName, width, height);
+  if (pixels == NULL) {
+    fprintf(stderr, "Exiting...\n\n");
+    exit(1);
+  }
+  printf("Read %d x %d image from \"%s\"\n", width, height, options.inputImageName.c_str());
+
+  MipMap  mipmap;
+  mipmap.Build(pixels, width, height, options.wrapMode);
+  printf("Writing %d mip-map levels (%s texels, %d x %d tiles) to \"%s\"...\n",
+  		mipmap.NLevels(), (options.encoding == TEXEL_HALF) ? "half-float" : "RGBE",
+  		options.tileSize, options.tileSize, options.outputFilename.c_str());
+  if (! WriteTextureFile(options.outputFilename, mipmap, options.encoding, options.tileSize)) {
+    fprintf(stderr, "Exiting...\n\n");
+    exit(1);
+  }
+  printf("Done.\n\n");
+
+  return 0;
+}
+
+
+
+void ProcessInput( int argc, char *argv[], maketexOptions *theOptions )
+{
+
+  CLineParser *optParser = new CLineParser();
+
+  theOptions->encoding = TEXEL_RGBE;
+  theOptions->tileSize = DEFAULT_TILE_SIZE;
+  theOptions->wrapMode = MIPMAP_CLAMP;
+
+  /* SET THE USAGE/HELP   */
+  optParser->AddUsageLine("Usage: ");
+  optParser->AddUsageLine("   maketex [options] input-image output-texture-file\n");
+  optParser->AddUsageLine(" -h  --help                         Prints this help");
+  optParser->AddUsageLine(" --half                             store texels as half-float RGB [default = RGBE]");
+  optParser->AddUsageLine(" --tile-size <size>                 width & height of tiles in texels [default = 64]");
+  optParser->AddUsageLine(" --wrap                             wrap filtering in u (use for equiangular maps)");
+  optParser->AddUsageLine("");
+  optParser->AddUsageLine(" (output-texture-file should end in \".ptx\")");
+  optParser->AddUsageLine("");
+
+  optParser->AddFlag("help", "h");
+  optParser->AddFlag("half");
+  optParser->AddFlag("wrap");
+  optParser->AddOption("tile-size");
+
+  optParser->UnrecognizedAreErrors();
+
+  /* parse the command line:  */
+  int status = optParser->ParseCommandLine( argc, argv );
+  if (status < 0) {
+    printf("\nError on command line... quitting...\n\n");
+    delete optParser;
+    exit(1);
+  }
+
+  if ( optParser->FlagSet("help") ) {
+    optParser->PrintUsage();
+    delete optParser;
+    exit(1);
+  }
+  if (optParser->nArguments() < 2) {
+    optParser->PrintUsage();
+    delete optParser;
+    exit(1);
+  }
+  theOptions->inputImageName = optParser->GetArgument(0);
+  theOptions->outputFilename = optParser->GetArgument(1);
+  if (! IsTextureFile(theOptions->outputFilename)) {
+    fprintf(stderr, "*** ERROR: output filename should end in \"%s\"!\n\n",
+    		TEXTURE_FILE_EXTENSION.c_str());
+    delete optParser;
+    exit(1);
+  }
+
+  if (optParser->FlagSet("half"))
+    theOptions->encoding = TEXEL_HALF;
+  if (optParser->FlagSet("wrap"))
+    theOptions->wrapMode = MIPMAP_WRAP_U;
+  if (optParser->OptionSet("tile-size")) {
+    if (NotANumber(optParser->GetTargetString("tile-size").c_str(), 0, kPosInt)) {
+      fprintf(stderr, "*** ERROR: tile size should be a positive integer!\n\n");
+      delete optParser;
+      exit(1);
+    }
+    theOptions->tileSize = atol(optParser->GetTargetString("tile-size").c_str());
+    if (theOptions->tileSize > MAX_TILE_SIZE) {
+      fprintf(stderr, "*** ERROR: tile size should be no larger than %d!\n\n", MAX_TILE_SIZE);
+      delete optParser;
+      exit(1);
+    }
+  }
+
+  delete optParser;
+}
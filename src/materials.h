@@ -81,6 +81,12 @@ class Material
       return emissionColor;
     };
 
+    // underlying surface color (e.g., the albedo guide for denoising)
+    Color GetBaseColor( ) const
+    {
+      return baseColor;
+    };
+
 
     // public data members
     bool  metallic;
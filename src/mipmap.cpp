@@ -0,0 +1,193 @@
+// Code for mip-mapped (image-pyramid) versions of images.
+//
+// Each level is half the size (rounded up) of the previous level, down to 1x1;
+// texel i of level n+1 is the average of texels 2i and 2i+1 (in x and y) of
+// level n (wrapping around at the right edge for MIPMAP_WRAP_U). Lookups choose
+// the pair of levels bracketing the requested filter footprint and interpolate
+// bilinearly within each level and linearly between them ("trilinear" filtering).
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "color.h"
+#include "mipmap.h"
+#include "texture_file.h"
+
+
+MipMap::MipMap( )
+{
+  wrapMode = MIPMAP_CLAMP;
+  mappedFile = NULL;
+  mappedSize = 0;
+}
+
+
+MipMap::~MipMap( )
+{
+  for (auto &level : levels)
+    delete [] level.texels;
+  levels.clear();
+  if (mappedFile != NULL)
+    munmap(mappedFile, mappedSize);
+}
+
+
+void MipMap::Build( Color *image, int width, int height, int wrap )
+{
+  wrapMode = wrap;
+  mipLevel  base = {width, height, image, NULL, 0};
+  levels.push_back(base);
+
+  while ((width > 1) || (height > 1)) {
+    const Color *previous = levels.back().texels;
+    int  prevWidth = width;
+    int  prevHeight = height;
+    width = (width + 1) / 2;
+    height = (height + 1) / 2;
+    Color *texels = new Color[width*height];
+    for (int y = 0; y < height; y++) {
+      int  y0 = 2*y;
+      int  y1 = (2*y + 1 < prevHeight) ? 2*y + 1 : prevHeight - 1;
+      for (int x = 0; x < width; x++) {
+        int  x0 = 2*x;
+        int  x1 = 2*x + 1;
+        if (x1 >= prevWidth)
+          x1 = (wrapMode == MIPMAP_WRAP_U) ? x1 % prevWidth : prevWidth - 1;
+        Color sum = previous[y0*prevWidth + x0] + previous[y0*prevWidth + x1] +
+        			previous[y1*prevWidth + x0] + previous[y1*prevWidth + x1];
+        texels[y*width + x] = sum * 0.25;
+      }
+    }
+    mipLevel  newLevel = {width, height, texels, NULL, 0};
+    levels.push_back(newLevel);
+  }
+}
+
+
+// The file is mapped read-only; pages (and thus tiles) are only read from disk
+// when a lookup first touches them
+bool MipMap::OpenTextureFile( const string &filename, int wrap )
+{
+  textureFileHeader  header;
+  struct stat  fileInfo;
+
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "ERROR: unable to open texture file \"%s\"!\n", filename.c_str());
+    return false;
+  }
+  if ((fstat(fd, &fileInfo) != 0) || (fileInfo.st_size < (off_t)sizeof(header))) {
+    fprintf(stderr, "ERROR: texture file \"%s\" is too small!\n", filename.c_str());
+    close(fd);
+    return false;
+  }
+  mappedSize = fileInfo.st_size;
+  mappedFile = mmap(NULL, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mappedFile == MAP_FAILED) {
+    fprintf(stderr, "ERROR: unable to memory-map texture file \"%s\"!\n", filename.c_str());
+    mappedFile = NULL;
+    return false;
+  }
+  // lookups are scattered, so read-ahead would mostly fetch tiles we never use
+  madvise(mappedFile, mappedSize, MADV_RANDOM);
+
+  memcpy(&header, mappedFile, sizeof(header));
+  if ((strncmp(header.magic, "PTXTEX1", 8) != 0) || (header.nLevels < 1) || 
+  		(header.nLevels > 32) || (header.tileSize < 1) || (header.tileSize > MAX_TILE_SIZE) || 
+  		((header.encoding != TEXEL_RGBE) && (header.encoding != TEXEL_HALF)) ||
+  		((header.wrapMode != MIPMAP_CLAMP) && (header.wrapMode != MIPMAP_WRAP_U))) {
+    fprintf(stderr, "ERROR: \"%s\" is not a valid texture file!\n", filename.c_str());
+    return false;
+  }
+  wrapMode = (header.wrapMode == MIPMAP_WRAP_U) ? MIPMAP_WRAP_U : wrap;
+  encoding = header.encoding;
+  tileSize = header.tileSize;
+  texelSize = TexelSize(encoding);
+  const unsigned char *fileData = (const unsigned char *)mappedFile;
+  size_t  tileBytes = (size_t)tileSize*tileSize*texelSize;
+  for (int n = 0; n < header.nLevels; n++) {
+    // each level must be the previous one halved (rounded up), as in Build(),
+    // and must start inside the file
+    int  width = header.levelWidths[n];
+    int  height = header.levelHeights[n];
+    bool  badSize = (width < 1) || (height < 1);
+    if ((n > 0) && ((width != (header.levelWidths[n - 1] + 1)/2) || 
+    		(height != (header.levelHeights[n - 1] + 1)/2)))
+      badSize = true;
+    if (badSize || (header.levelOffsets[n] < (int64_t)sizeof(header)) || 
+    		(header.levelOffsets[n] >= (int64_t)mappedSize)) {
+      fprintf(stderr, "ERROR: \"%s\" is not a valid texture file!\n", filename.c_str());
+      levels.clear();
+      return false;
+    }
+    mipLevel  level = {width, height, NULL, fileData + header.levelOffsets[n], 
+    					(width + tileSize - 1) / tileSize};
+    size_t  nTiles = (size_t)level.nTilesX*((height + tileSize - 1) / tileSize);
+    // compare by division so huge sizes in a corrupt header can't overflow
+    if (nTiles > (mappedSize - header.levelOffsets[n]) / tileBytes) {
+      fprintf(stderr, "ERROR: texture file \"%s\" is truncated!\n", filename.c_str());
+      levels.clear();
+      return false;
+    }
+    levels.push_back(level);
+  }
+  return true;
+}
+
+
+Color MipMap::Texel( int level, int x, int y ) const
+{
+  const mipLevel &thisLevel = levels[level];
+  if (wrapMode == MIPMAP_WRAP_U) {
+    x = x % thisLevel.width;
+    if (x < 0)
+      x += thisLevel.width;
+  }
+  else
+    x = (x < 0) ? 0 : ((x >= thisLevel.width) ? thisLevel.width - 1 : x);
+  y = (y < 0) ? 0 : ((y >= thisLevel.height) ? thisLevel.height - 1 : y);
+  if (thisLevel.texels != NULL)
+    return thisLevel.texels[y*thisLevel.width + x];
+
+  int  tileX = x / tileSize;
+  int  tileY = y / tileSize;
+  size_t  tileOffset = (size_t)(tileY*thisLevel.nTilesX + tileX)*tileSize*tileSize;
+  size_t  texelOffset = (y - tileY*tileSize)*tileSize + (x - tileX*tileSize);
+  return DecodeTexel(thisLevel.tiles + (tileOffset + texelOffset)*texelSize, encoding);
+}
+
+
+// Texel centers are at ((i + 0.5)/width, (j + 0.5)/height)
+Color MipMap::Bilinear( int level, float u, float v ) const
+{
+  float  x = u*levels[level].width - 0.5f;
+  float  y = v*levels[level].height - 0.5f;
+  int  x0 = (int)floorf(x);
+  int  y0 = (int)floorf(y);
+  float  dx = x - x0;
+  float  dy = y - y0;
+
+  return Texel(level, x0, y0)*((1.0f - dx)*(1.0f - dy)) + Texel(level, x0 + 1, y0)*(dx*(1.0f - dy)) +
+  		Texel(level, x0, y0 + 1)*((1.0f - dx)*dy) + Texel(level, x0 + 1, y0 + 1)*(dx*dy);
+}
+
+
+Color MipMap::Lookup( float u, float v, float filterWidth ) const
+{
+  if (filterWidth <= 1.0f)
+    return Bilinear(0, u, v);
+
+  float  level = log2f(filterWidth);
+  int  lastLevel = NLevels() - 1;
+  if (level >= lastLevel)
+    return Bilinear(lastLevel, u, v);
+  int  level0 = (int)level;
+  float  delta = level - level0;
+  return Bilinear(level0, u, v)*(1.0f - delta) + Bilinear(level0 + 1, u, v)*delta;
+}
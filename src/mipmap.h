@@ -0,0 +1,71 @@
+// Code for mip-mapped (image-pyramid) versions of images, used for filtered
+// lookups into environment maps.
+
+#ifndef _MIPMAP_H_
+#define _MIPMAP_H_
+
+#include <vector>
+#include <string>
+#include "color.h"
+
+using namespace std;
+
+// how lookups outside the (0,1) range in u are handled; v is always clamped
+const int  MIPMAP_CLAMP = 0;
+const int  MIPMAP_WRAP_U = 1;   // periodic in u (e.g., equiangular maps)
+
+
+/// simple struct for holding one level of the image pyramid; texels is NULL
+/// if the level is stored as encoded tiles in a memory-mapped texture file
+typedef struct {
+  int  width;
+  int  height;
+  Color  *texels;
+  const unsigned char  *tiles;
+  int  nTilesX;
+} mipLevel;
+
+
+class MipMap
+{
+  public:
+    MipMap( );
+    ~MipMap( );
+
+    /// Builds the image pyramid from the input image; the MipMap takes ownership
+    /// of image (which must have been allocated with new[]).
+    void Build( Color *image, int width, int height, int wrap=MIPMAP_CLAMP );
+
+    /// Memory-maps a preprocessed (tiled) texture file, using its stored image
+    /// pyramid; returns false if the file could not be opened or is invalid.
+    /// Lookups wrap in u if the file was built with wrapping or if wrap =
+    /// MIPMAP_WRAP_U.
+    bool OpenTextureFile( const string &filename, int wrap=MIPMAP_CLAMP );
+
+    /// Returns the trilinearly filtered color at texture coordinates (u,v), for a
+    /// filter footprint of filterWidth texels (measured at full resolution)
+    Color Lookup( float u, float v, float filterWidth ) const;
+
+    /// Returns the bilinearly interpolated color at (u,v) within a single level
+    Color Bilinear( int level, float u, float v ) const;
+
+    int NLevels( ) const { return (int)levels.size(); };
+    int WrapMode( ) const { return wrapMode; };
+    int Width( int level=0 ) const { return levels[level].width; };
+    int Height( int level=0 ) const { return levels[level].height; };
+    /// Returns NULL if the level is stored in a memory-mapped texture file
+    const Color * Texels( int level=0 ) const { return levels[level].texels; };
+
+  private:
+    Color Texel( int level, int x, int y ) const;
+
+    vector<mipLevel>  levels;
+    int  wrapMode;
+    // for levels read from a memory-mapped texture file
+    void  *mappedFile;
+    size_t  mappedSize;
+    int  encoding, tileSize, texelSize;
+};
+
+
+#endif  // _MIPMAP_H_
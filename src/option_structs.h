@@ -22,12 +22,16 @@ typedef struct {
   bool  noImageName = true;
   bool  imageSizeSet = false;
   bool  saveAlpha = false;
+  bool  saveObjectIDs = false;
+  bool  saveDepth = false;
   unsigned long  rngSeed = 0;
   unsigned  imageWidth = 0;
   unsigned  imageHeight = 0;
   float  fieldOfView = 0;
   bool  fieldOfViewSet = false;
   int  oversamplingRate = 0;
+  int  nPixelSamples = 0;
+  bool  adaptiveSampling = false;
   std::string  samplerName = SAMPLER_UNIFORM;
   bool  samplerSet = false;
   std::string  filterName = FILTER_BLOCK;
@@ -35,6 +39,16 @@ typedef struct {
   std::string  outputImageName = DEFAULT_OUTPUT_IMAGE_FILENAME;
   int  outputImageFormat = IMAGE_PPM;
   bool shadowTransparency = false;
+  int  nLightSamples = 0;
+  bool  perPixelLightSamples = false;
+  float  lightCutoff = 0.0;
+  bool  denoise = false;
+  int  denoiseRadius = 0;
+  int  aovFlags = 0;   // AOVs to save along with image (see aovs.h)
+  bool  streamOutput = false;   // write tiles of (EXR) output image during render
+  bool  exrCompressionSet = false;
+  int  exrCompression = 0;   // one of the EXR_COMPRESSION_ values in image_io.h
+  bool  exrFullFloat = false;   // save EXR channels as 32-bit float
   bool  useTestScene = false;
   bool  singlePixelMode = false;
   int singlePixel_x = -1;
@@ -44,7 +58,9 @@ typedef struct {
 
 
 const int DEFAULT_TRACE_MODE = 1;
-const int ALPHA_MASK = 2;
+const int ALPHA_MASK = 2;   // coverage only
+const int OBJECT_ID_MAP = 3;   // index of nearest shape (+ 1) only
+const int DEPTH_MAP = 4;   // distance to nearest shape only
 
 const int MAX_RAY_DEPTH = 5;
 
@@ -54,13 +70,21 @@ const int MAX_RAY_DEPTH = 5;
 typedef struct {
   int maxRayDepth = MAX_RAY_DEPTH;
   int mode = DEFAULT_TRACE_MODE;
+  unsigned long rngSeed = 0;   // combined with each pixel's hash to seed its sampling patterns
   int oversampling = 1;
+  int nPixelSamples = 0;   // total subsamples per pixel (0 = oversampling^2)
+  bool adaptiveSampling = false;   // oversample only near edges (after a 1-ray-per-pixel pass)
   std::string  samplerName = SAMPLER_UNIFORM;
   unsigned width = 800;
   unsigned height = 600;
   bool fieldOfViewSet = false;
   float fieldOfView = 30.0;   // camera field of view in degrees
   bool shadowTransparency = false;   // trace shadow rays through transparent objects?
+  int nLightSamples = 0;   // number of lights sampled per shading point (0 = all lights)
+  bool perPixelLightSamples = false;   // area-light nsamples = per-pixel budget?
+  float lightCutoff = 0.0;   // light contributions below this are skipped (0 = no cutoff)
+  bool denoise = false;   // apply denoising filter to rendered image?
+  int denoiseRadius = DEFAULT_DENOISE_RADIUS;   // half-width of denoising filter window (pixels)
   bool  singlePixelMode = false;
   int singlePixel_x = -1;
   int singlePixel_y = -1;
@@ -5,6 +5,9 @@
 #include <cmath> 
 #include <fstream> 
 #include <vector> 
+#include <memory>
+#include <thread>
+#include <algorithm>
 #include <iostream> 
 #include <cassert> 
 #include <stdio.h>
@@ -22,6 +25,9 @@
 #include "scenefile_parser.h"
 #include "render.h"
 #include "image_io.h"
+#include "aovs.h"
+#include "exr_tile_writer.h"
+#include "tile_lights.h"
 #include "mersenne_twister.h"
  
  
@@ -46,6 +52,7 @@ int main( int argc, char **argv )
   double  microsecs, time_elapsed;
   commandOptions  options;
   traceOptions  raytraceOptions;
+  exrOutputOptions  exrOptions;
   
   init_genrand(time(NULL));
 
@@ -56,17 +63,47 @@ int main( int argc, char **argv )
   // Process command line 
   ProcessInput(argc, argv, &options);
   
-  if (options.rngSeed > 0)
-    init_genrand(options.rngSeed);
-  else
-    init_genrand((unsigned long)time(NULL));
+  // the same seed is used for the RNG and for the (hashed) per-pixel sampling patterns
+  if (options.rngSeed == 0)
+    options.rngSeed = (unsigned long)time(NULL);
+  init_genrand(options.rngSeed);
+  raytraceOptions.rngSeed = options.rngSeed;
   raytraceOptions.shadowTransparency = options.shadowTransparency;
+  if (options.perPixelLightSamples) {
+    printf("\tArea-light samples are per pixel (spread across subsamples)\n");
+    raytraceOptions.perPixelLightSamples = true;
+  }
+  if (options.nLightSamples > 0) {
+    printf("\tSampling %d lights per shading point\n", options.nLightSamples);
+    raytraceOptions.nLightSamples = options.nLightSamples;
+  }
+  if (options.lightCutoff > 0.0) {
+    printf("\tIgnoring light contributions < %g\n", options.lightCutoff);
+    raytraceOptions.lightCutoff = options.lightCutoff;
+  }
+  if (options.denoise) {
+    raytraceOptions.denoise = true;
+    if (options.denoiseRadius > 0)
+      raytraceOptions.denoiseRadius = options.denoiseRadius;
+    printf("\tDenoising rendered image (filter radius = %d pixels)\n", 
+    		raytraceOptions.denoiseRadius);
+  }
   if (options.imageSizeSet) {
     raytraceOptions.width = options.imageWidth;
     raytraceOptions.height = options.imageHeight;
   }
-  if (options.saveAlpha)
+  if (options.saveAlpha) {
+    printf("\tRendering alpha mask\n");
     raytraceOptions.mode = ALPHA_MASK;
+  }
+  else if (options.saveObjectIDs) {
+    printf("\tRendering object-ID map\n");
+    raytraceOptions.mode = OBJECT_ID_MAP;
+  }
+  else if (options.saveDepth) {
+    printf("\tRendering depth map\n");
+    raytraceOptions.mode = DEPTH_MAP;
+  }
   if (options.fieldOfViewSet) {
     // User wishes to override FOV specification in scene file, if any
     printf("\tField of view = %f\n", options.fieldOfView);
@@ -81,6 +118,26 @@ int main( int argc, char **argv )
     raytraceOptions.samplerName = options.samplerName;
     printf("\tUsing %s sampler\n", options.samplerName.c_str());
   }
+  if (options.nPixelSamples > 0) {
+    if ((options.samplerName == SAMPLER_UNIFORM) || (options.samplerName == SAMPLER_UNIFORM_JITTER)) {
+      // grid-based samplers can only handle square numbers of samples
+      int  rate = (int)lround(sqrt((double)options.nPixelSamples));
+      if (rate*rate != options.nPixelSamples) {
+        fprintf(stderr, "ERROR: the %s sampler requires a square number of pixel samples ", 
+        		options.samplerName.c_str());
+        fprintf(stderr, "(use --oversample, or the sobol, halton, or cmj samplers)\n");
+        exit(1);
+      }
+      raytraceOptions.oversampling = rate;
+    }
+    else
+      raytraceOptions.nPixelSamples = options.nPixelSamples;
+    printf("\tPixel samples: %d\n", options.nPixelSamples);
+  }
+  if (options.adaptiveSampling) {
+    printf("\tOversampling only near edges\n");
+    raytraceOptions.adaptiveSampling = true;
+  }
   if (! options.noImageName) {
     size_t nChars = options.outputImageName.size();
     // look for output filename suffixes
@@ -95,6 +152,36 @@ int main( int argc, char **argv )
         options.outputImageFormat = IMAGE_PPM;
     }
   }
+  if (options.aovFlags != 0) {
+    if (options.outputImageFormat != IMAGE_EXR) {
+      fprintf(stderr, "*** ERROR: AOVs can only be saved in OpenEXR format (use \".exr\" output name)!\n\n");
+      exit(1);
+    }
+    if (raytraceOptions.mode != DEFAULT_TRACE_MODE) {
+      fprintf(stderr, "*** ERROR: AOVs can't be combined with --alpha, --object-id, or --depth!\n\n");
+      exit(1);
+    }
+    printf("\tSaving AOVs as extra layers of output image\n");
+  }
+  if (options.streamOutput) {
+    if (options.outputImageFormat != IMAGE_EXR) {
+      fprintf(stderr, "*** ERROR: streaming output requires OpenEXR format (use \".exr\" output name)!\n\n");
+      exit(1);
+    }
+    if ((options.aovFlags != 0) || (raytraceOptions.mode != DEFAULT_TRACE_MODE) 
+    		|| options.denoise || options.adaptiveSampling) {
+      fprintf(stderr, "*** ERROR: streaming output can't be combined with --aovs, --denoise, ");
+      fprintf(stderr, "--adaptive, --alpha, --object-id, or --depth!\n\n");
+      exit(1);
+    }
+    printf("\tWriting output image tile by tile during render\n");
+  }
+  if (options.exrCompressionSet)
+    exrOptions.compression = options.exrCompression;
+  if (options.exrFullFloat) {
+    printf("\tSaving OpenEXR channels as 32-bit floats\n");
+    exrOptions.fullFloat = true;
+  }
   
   if (options.noSceneFile) {
     theScene = make_shared<Scene>();
@@ -141,17 +228,53 @@ int main( int argc, char **argv )
   
   printf("Scene camera: FOV = %f\n", theScene->GetCamera()->fieldOfView);
   
-  Color *image = new Color[w*h];
+  // with streaming output, finished tiles go straight to the output file, so we
+  // don't need an image array
+  Color *image = NULL;
+  unique_ptr<TiledEXRWriter> tileWriter;
+  if (options.streamOutput) {
+    int maxQueuedTiles = 4*std::max((int)std::thread::hardware_concurrency(), 1);
+    tileWriter = make_unique<TiledEXRWriter>(options.outputImageName, w, h, RENDER_TILE_SIZE,
+    											maxQueuedTiles, exrOptions);
+    if (! tileWriter->IsOpen()) {
+      fprintf(stderr, "Exiting...\n\n");
+      exit(1);
+    }
+  }
+  else
+    image = new Color[w*h];
   printf("Starting render...\n");
   gettimeofday(&timer_start, NULL);
-  RenderImage(theScene, image, w, h, raytraceOptions); 
+  unique_ptr<AOVBuffers> aovs;
+  if (options.aovFlags != 0)
+    aovs = make_unique<AOVBuffers>(options.aovFlags, w, h, (int)theScene->lights.size());
+  RenderImage(theScene, image, w, h, raytraceOptions, aovs.get(), tileWriter.get()); 
   gettimeofday(&timer_end, NULL);
   microsecs = timer_end.tv_usec - timer_start.tv_usec;
   time_elapsed = timer_end.tv_sec - timer_start.tv_sec + microsecs/1e6;
   printf("Finished with render. (Elapsed time = %.6f sec)\n", time_elapsed);
 
-  // Save image
-  SaveImage(image, w, h, options.outputImageName, options.outputImageFormat);
+  // Save image (visibility-only images are data, so no gamma correction; object IDs
+  // are mapped to colors and depths are scaled to [0,1] unless we're saving as EXR);
+  // streaming output just needs to finish writing the last tiles
+  bool  visibilityOnly = (raytraceOptions.mode != DEFAULT_TRACE_MODE);
+  if (visibilityOnly && (raytraceOptions.mode != ALPHA_MASK) 
+  		&& (options.outputImageFormat != IMAGE_EXR))
+    ScaleVisibilityImage(image, w, h, raytraceOptions.mode);
+  if (tileWriter) {
+    if (! tileWriter->Finish()) {
+      fprintf(stderr, "Exiting...\n\n");
+      exit(1);
+    }
+  }
+  else if (aovs) {
+    vector<exrChannel> channels;
+    aovs->GetEXRChannels(image, channels);
+    SaveImageOpenEXRChannels(channels, w, h, options.outputImageName, exrOptions);
+  }
+  else
+    SaveImage(image, w, h, options.outputImageName, options.outputImageFormat, 
+  				! visibilityOnly, exrOptions);
 
 
   delete [] image;
@@ -181,32 +304,73 @@ void ProcessInput( int argc, char *argv[], commandOptions *theOptions )
   optParser->AddUsageLine(" -o  --output <output-image-root>   root name for output image [default = \"untitled\"]");
   optParser->AddUsageLine("                                    (add \".png\" to save in PNG format)");
   optParser->AddUsageLine("                                    (add \".exr\" to save in OpenEXR format)");
+  optParser->AddUsageLine(" --exr-compression <name>           compression for OpenEXR output [default = \"zip\"]");
+  optParser->AddUsageLine("                                       (\"none\", \"zip\", \"piz\", \"dwaa\" [lossy])");
+  optParser->AddUsageLine(" --exr-float                        save OpenEXR channels as 32-bit float (default = 16-bit half)");
   optParser->AddUsageLine(" --FOV                              camera field of view (degrees; default = 30)");
   optParser->AddUsageLine(" --oversample <size>                pixel oversampling rate (must be positive integer)");
+  optParser->AddUsageLine(" --pixel-samples <n>                total number of subsamples per pixel (alternative to --oversample;");
+  optParser->AddUsageLine("                                       any positive integer for sobol, halton, cmj samplers)");
+  optParser->AddUsageLine(" --adaptive                         oversample only pixels near edges (of shapes, normals, depth,");
+  optParser->AddUsageLine("                                       or color) or which see reflective/refractive surfaces");
   optParser->AddUsageLine(" --sampler <sampler-name>           name of sampler to use [default = \"uniform\"]");
-  optParser->AddUsageLine("                                       (\"uniform\", \"uniform_jitter\")");
+  optParser->AddUsageLine("                                       (\"uniform\", \"uniform_jitter\", \"sobol\", \"halton\", \"cmj\")");
   optParser->AddUsageLine(" --filter <filter-name>             name of image reconstruction filter to use [default = \"block\"]");
   optParser->AddUsageLine("                                       (\"block\", \"gaussian\") [NOT YET IMPLEMENTED!]");
   optParser->AddUsageLine(" --shadow-transparency              trace shadow rays through translucent objects");
-  optParser->AddUsageLine(" --seed <rng-seed>                  integer for RNG seed (0 = use system time)");
+  optParser->AddUsageLine(" --light-samples <n>                sample only n lights (chosen by importance) per shading point");
+  optParser->AddUsageLine("                                       (distant & environment lights are always used)");
+  optParser->AddUsageLine(" --per-pixel-light-samples          area-light nsamples is the number of shadow rays per pixel,");
+  optParser->AddUsageLine("                                       spread across the pixel's subsamples (default = per subsample)");
+  optParser->AddUsageLine(" --light-cutoff <c>                 skip shadow rays for light contributions < c (pixel value,");
+  optParser->AddUsageLine("                                       e.g. 0.0001); point lights get a finite range");
+  optParser->AddUsageLine("                                       (distant lights are always used)");
+  optParser->AddUsageLine(" --denoise                          apply denoising filter (guided by surface albedo, normal, depth)");
+  optParser->AddUsageLine(" --denoise-radius <r>               half-width of denoising filter in pixels [default = 5]");
+  optParser->AddUsageLine(" --aovs <names>                     save AOVs as extra layers of output image (requires .exr):");
+  optParser->AddUsageLine("                                       comma-separated list of albedo, normal, depth, id,");
+  optParser->AddUsageLine("                                       direct, indirect, emission, background, lights (one");
+  optParser->AddUsageLine("                                       layer per light), or all");
+  optParser->AddUsageLine(" --stream                           write output image tile by tile as rendering proceeds");
+  optParser->AddUsageLine("                                       (tiled OpenEXR only; bounded memory for huge images)");
+  optParser->AddUsageLine(" --seed <rng-seed>                  integer seed for RNG and sampling patterns (0 = use system time)");
   optParser->AddUsageLine(" --test-scene                       use internal test scene");
   optParser->AddUsageLine(" --single-pixel <x,y>               single-pixel debugging mode");
-//  optParser->AddUsageLine(" --alpha                            specifies that output image should be alpha mask");
+  optParser->AddUsageLine(" --alpha                            output image is alpha mask (fast; no shading)");
+  optParser->AddUsageLine(" --object-id                        output image is map of object IDs (index of shape + 1;");
+  optParser->AddUsageLine("                                       fast; no shading)");
+  optParser->AddUsageLine(" --depth                            output image is map of distance to nearest surface along");
+  optParser->AddUsageLine("                                       camera ray (fast; no shading)");
+  optParser->AddUsageLine("                                       (except for EXR output, IDs are shown as distinct colors");
+  optParser->AddUsageLine("                                       and depths are scaled to [0,1])");
   optParser->AddUsageLine("");
 
   optParser->AddFlag("help", "h");
-//  optParser->AddFlag("alpha");
+  optParser->AddFlag("alpha");
+  optParser->AddFlag("object-id");
+  optParser->AddFlag("depth");
   optParser->AddOption("output", "o");
   optParser->AddOption("width");
   optParser->AddOption("height");
   optParser->AddOption("size");
   optParser->AddOption("oversample");
+  optParser->AddOption("pixel-samples");
   optParser->AddOption("sampler");
   optParser->AddOption("filter");
   optParser->AddOption("FOV");
   optParser->AddOption("seed");
   optParser->AddOption("single-pixel");
+  optParser->AddOption("light-samples");
+  optParser->AddOption("light-cutoff");
+  optParser->AddOption("denoise-radius");
+  optParser->AddOption("aovs");
+  optParser->AddOption("exr-compression");
   optParser->AddFlag("shadow-transparency");
+  optParser->AddFlag("per-pixel-light-samples");
+  optParser->AddFlag("denoise");
+  optParser->AddFlag("adaptive");
+  optParser->AddFlag("stream");
+  optParser->AddFlag("exr-float");
   optParser->AddFlag("test-scene");
 
   // Comment this out if you want unrecognized (e.g., mis-spelled) flags and options
@@ -293,6 +457,14 @@ void ProcessInput( int argc, char *argv[], commandOptions *theOptions )
     int val = atol(optParser->GetTargetString("oversample").c_str());
     theOptions->oversamplingRate = val;
   }
+  if (optParser->OptionSet("pixel-samples")) {
+    if (NotANumber(optParser->GetTargetString("pixel-samples").c_str(), 0, kPosInt)) {
+      fprintf(stderr, "*** ERROR: pixel-samples should be a positive integer!\n\n");
+      delete optParser;
+      exit(1);
+    }
+    theOptions->nPixelSamples = atol(optParser->GetTargetString("pixel-samples").c_str());
+  }
   if (optParser->OptionSet("seed")) {
     if (NotANumber(optParser->GetTargetString("seed").c_str(), 0, kNonzeroInt)) {
       fprintf(stderr, "*** ERROR: seed should be a non-negative integer!\n\n");
@@ -313,6 +485,16 @@ void ProcessInput( int argc, char *argv[], commandOptions *theOptions )
   }
   if (optParser->OptionSet("sampler")) {
     theOptions->samplerName = optParser->GetTargetString("sampler");
+    if ((theOptions->samplerName != SAMPLER_UNIFORM) 
+    		&& (theOptions->samplerName != SAMPLER_UNIFORM_JITTER)
+    		&& (theOptions->samplerName != SAMPLER_SOBOL) 
+    		&& (theOptions->samplerName != SAMPLER_HALTON)
+    		&& (theOptions->samplerName != SAMPLER_CMJ)) {
+      fprintf(stderr, "*** ERROR: unrecognized sampler name (\"%s\")!\n\n", 
+      			theOptions->samplerName.c_str());
+      delete optParser;
+      exit(1);
+    }
     theOptions->samplerSet = true;
   }
   if (optParser->OptionSet("filter")) {
@@ -323,10 +505,75 @@ void ProcessInput( int argc, char *argv[], commandOptions *theOptions )
     theOptions->outputImageName = optParser->GetTargetString("output");
     theOptions->noImageName = false;
   }
+  if (optParser->OptionSet("light-samples")) {
+    if (NotANumber(optParser->GetTargetString("light-samples").c_str(), 0, kPosInt)) {
+      fprintf(stderr, "*** ERROR: light-samples should be a positive integer!\n\n");
+      delete optParser;
+      exit(1);
+    }
+    theOptions->nLightSamples = atol(optParser->GetTargetString("light-samples").c_str());
+  }
+  if (optParser->OptionSet("light-cutoff")) {
+    if (NotANumber(optParser->GetTargetString("light-cutoff").c_str(), 0, kPosReal)) {
+      fprintf(stderr, "*** ERROR: light-cutoff should be a positive number!\n\n");
+      delete optParser;
+      exit(1);
+    }
+    theOptions->lightCutoff = (float)atof(optParser->GetTargetString("light-cutoff").c_str());
+  }
+  if (optParser->OptionSet("denoise-radius")) {
+    if (NotANumber(optParser->GetTargetString("denoise-radius").c_str(), 0, kPosInt)) {
+      fprintf(stderr, "*** ERROR: denoise-radius should be a positive integer!\n\n");
+      delete optParser;
+      exit(1);
+    }
+    theOptions->denoiseRadius = atol(optParser->GetTargetString("denoise-radius").c_str());
+  }
+  if (optParser->OptionSet("aovs")) {
+    theOptions->aovFlags = ParseAOVNames(optParser->GetTargetString("aovs"));
+    if (theOptions->aovFlags < 0) {
+      fprintf(stderr, "*** ERROR: unrecognized AOV name in \"%s\"!\n\n", 
+      		optParser->GetTargetString("aovs").c_str());
+      delete optParser;
+      exit(1);
+    }
+  }
   if ( optParser->FlagSet("shadow-transparency") ) {
     theOptions->shadowTransparency = true;
     printf("Shadow rays will be traced through transparent objects!\n");
   }
+  if ( optParser->FlagSet("per-pixel-light-samples") )
+    theOptions->perPixelLightSamples = true;
+  if ( optParser->FlagSet("denoise") )
+    theOptions->denoise = true;
+  if ( optParser->FlagSet("adaptive") )
+    theOptions->adaptiveSampling = true;
+  if (optParser->OptionSet("exr-compression")) {
+    theOptions->exrCompression = ParseEXRCompression(optParser->GetTargetString("exr-compression"));
+    if (theOptions->exrCompression < 0) {
+      fprintf(stderr, "*** ERROR: unrecognized EXR compression \"%s\" ", 
+      		optParser->GetTargetString("exr-compression").c_str());
+      fprintf(stderr, "(should be \"none\", \"zip\", \"piz\", or \"dwaa\")!\n\n");
+      delete optParser;
+      exit(1);
+    }
+    theOptions->exrCompressionSet = true;
+  }
+  if ( optParser->FlagSet("exr-float") )
+    theOptions->exrFullFloat = true;
+  if ( optParser->FlagSet("stream") )
+    theOptions->streamOutput = true;
+  if ( optParser->FlagSet("alpha") )
+    theOptions->saveAlpha = true;
+  if ( optParser->FlagSet("object-id") )
+    theOptions->saveObjectIDs = true;
+  if ( optParser->FlagSet("depth") )
+    theOptions->saveDepth = true;
+  if ((int)theOptions->saveAlpha + (int)theOptions->saveObjectIDs + (int)theOptions->saveDepth > 1) {
+    fprintf(stderr, "*** ERROR: only one of --alpha, --object-id, --depth can be used!\n\n");
+    delete optParser;
+    exit(1);
+  }
   if ( optParser->FlagSet("test-scene") ) {
     theOptions->useTestScene = true;
     printf("Using test scene!\n");
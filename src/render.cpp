@@ -18,6 +18,14 @@ using namespace std;
 #include "cameras.h"
 #include "environment_map.h"
 #include "render_utils.h"
+#include "light_bvh.h"
+#include "tile_lights.h"
+#include "denoise.h"
+#include "adaptive_sampling.h"
+#include "low_discrepancy.h"
+#include "trace_context.h"
+#include "aovs.h"
+#include "exr_tile_writer.h"
 
 
 
@@ -28,14 +36,46 @@ float mix( const float a, const float b, const float mix )
 }
 
 
+// Returns true if shape j blocks the shadow ray toward a light at lightDistance
+inline bool ShapeBlocksRay( const shared_ptr<Shape> &shape, const Point &rayOrigin, 
+							const Vector &lightDirection, const float lightDistance, int j,
+							bool verbose )
+{
+  if (auto result = shape->intersect(rayOrigin, lightDirection); result) {
+    // we intersected a shape; check to see if it's closer to us than the light
+    intersectionResult  intersection = result.value();
+    if (verbose)
+      printf("\n      TraceShadowRay -- intersection: shape j = %d, t_0,t_1 = %f,%f\n",
+      			j, intersection.t_0, intersection.t_1);
+    if ((intersection.t_0 < lightDistance) || (intersection.t_1 < lightDistance))
+      return true;
+  }
+  return false;
+}
+
+
 // Given a point p_hit with surface normal n_hit and vector lightDirection to some 
 // light at a distance of lightDistance along the vector, determine whether any shapes 
 // are in between the point and the light.
+// If lastOccluder is not NULL, it points to the index of the shape which last
+// blocked a shadow ray toward this light (or -1); that shape is tested first (since
+// nearby shading points are usually blocked by the same shape), and *lastOccluder
+// is updated whenever a different shape blocks the ray.
+// If shapeSubset is not NULL, only the shapes with indices in it are tested (plus
+// the cached shape).
 bool TraceShadowRay( const Vector &lightDirection, const float lightDistance, 
-					const std::vector<shared_ptr<Shape>> shapes, const Point &p_hit,
-					const Vector &n_hit, bool verbose )
+					const std::vector<shared_ptr<Shape>> &shapes, const Point &p_hit,
+					const Vector &n_hit, int *lastOccluder, 
+					const std::vector<int> *shapeSubset, bool verbose )
 {
   bool blocked = false;
+  Point rayOrigin = p_hit + n_hit*BIAS;
+  int cachedShape = (lastOccluder != NULL) ? *lastOccluder : -1;
+  if ((cachedShape >= 0) 
+  		&& ShapeBlocksRay(shapes[cachedShape], rayOrigin, lightDirection, lightDistance, 
+  							cachedShape, verbose))
+    return true;
+
   // Check to see if another shape is blocking path to light (shadow rays).
   // We use the same basic algorithm as for camera raytracing, which means that
   // lightDirection must be the direction ray from the shaded point *to*
@@ -45,52 +85,61 @@ bool TraceShadowRay( const Vector &lightDirection, const float lightDistance,
   // Also note that we assume blocking shapes (between this point and the light)
   // are *opaque*; we are not attempting to handle transparent/translucent shapes
   // (which, to be correct, would involve refraction and caustics...)
-  for (int j = 0; j < shapes.size(); ++j) {
-    if (auto result = shapes[j]->intersect(p_hit + n_hit*BIAS, lightDirection); result) {
-      // we intersected a shape; check to see if it's closer to us than the light
-      intersectionResult  intersection = result.value();
-      if (verbose)
-        printf("\n      TraceShadowRay -- intersection: shape j = %d, t_0,t_1 = %f,%f\n",
-        			j, intersection.t_0, intersection.t_1);
-      if ((intersection.t_0 < lightDistance) || (intersection.t_1 < lightDistance)) {
-        blocked = true;
-        break;
-      }
+  int nShapesToTest = (shapeSubset != NULL) ? (int)shapeSubset->size() : (int)shapes.size();
+  for (int i = 0; i < nShapesToTest; ++i) {
+    int j = (shapeSubset != NULL) ? (*shapeSubset)[i] : i;
+    if (j == cachedShape)
+      continue;
+    if (ShapeBlocksRay(shapes[j], rayOrigin, lightDirection, lightDistance, j, verbose)) {
+      blocked = true;
+      if (lastOccluder != NULL)
+        *lastOccluder = j;
+      break;
     }
   }
   return blocked;
 }
 
 // Same as TraceShadowRay(), except we check to see if intersected objects
-// are transparent (while not worrying about refraction).
+// are transparent (while not worrying about refraction). Only opaque shapes
+// are stored in *lastOccluder.
 bool TraceShadowRay2( const Vector &lightDirection, const float lightDistance, 
-					const std::vector<shared_ptr<Shape>> shapes, const Point &p_hit,
-					const Vector &n_hit, float *attenuation, bool verbose )
+					const std::vector<shared_ptr<Shape>> &shapes, const Point &p_hit,
+					const Vector &n_hit, float *attenuation, int *lastOccluder, 
+					const std::vector<int> *shapeSubset, bool verbose )
 {
+  Point rayOrigin = p_hit + n_hit*BIAS;
+  int cachedShape = (lastOccluder != NULL) ? *lastOccluder : -1;
+  *attenuation = 1.0;
+  if ((cachedShape >= 0) 
+  		&& ShapeBlocksRay(shapes[cachedShape], rayOrigin, lightDirection, lightDistance, 
+  							cachedShape, verbose))
+    return true;
+
   // Check to see if another shape is blocking path to light (shadow rays).
   // We use the same basic algorithm as for camera raytracing, which means that
   // lightDirection must be the direction ray from the shaded point *to*
   // the light. (So in most cases this function should be called with -lightDir
   // where lightDir is direction ray from light to point produced by a light's
   // Illuminate method.
-  for (int j = 0; j < shapes.size(); ++j) {
+  int nShapesToTest = (shapeSubset != NULL) ? (int)shapeSubset->size() : (int)shapes.size();
+  for (int i = 0; i < nShapesToTest; ++i) {
+    int j = (shapeSubset != NULL) ? (*shapeSubset)[i] : i;
     *attenuation = 1.0;
-    if (auto result = shapes[j]->intersect(p_hit + n_hit*BIAS, lightDirection); result) {
-      // we intersected a shape; check to see if it's closer to us than the light
-      intersectionResult  intersection = result.value();
-      if (verbose)
-        printf("\n      TraceShadowRay -- intersection: shape j = %d, t_0,t_1 = %f,%f\n",
-        			j, intersection.t_0, intersection.t_1);
-      if ((intersection.t_0 < lightDistance) || (intersection.t_1 < lightDistance)) {
-        // OK, check if it's at least partially transparent
-        shared_ptr<Material> thisMaterial = shapes[j]->GetMaterial();
-        if (thisMaterial->translucent) {
-          // FIXME: handle partial transparency properly!
-          ;
-          // *attenuation *= shapes[j]->transparency;  -- WRONG!
-        } 
-        else  // opaque object between use and light --> BLOCKED!
-    	  return true;
+    if (j == cachedShape)
+      continue;
+    if (ShapeBlocksRay(shapes[j], rayOrigin, lightDirection, lightDistance, j, verbose)) {
+      // OK, check if it's at least partially transparent
+      shared_ptr<Material> thisMaterial = shapes[j]->GetMaterial();
+      if (thisMaterial->translucent) {
+        // FIXME: handle partial transparency properly!
+        ;
+        // *attenuation *= shapes[j]->transparency;  -- WRONG!
+      } 
+      else {  // opaque object between use and light --> BLOCKED!
+        if (lastOccluder != NULL)
+          *lastOccluder = j;
+    	return true;
       }
     }
   }
@@ -100,6 +149,199 @@ bool TraceShadowRay2( const Vector &lightDirection, const float lightDistance,
 }
 
 
+// Possible outcomes of CullShapesForLight()
+const int  PACKET_FULLY_LIT = 0;
+const int  PACKET_FULLY_SHADOWED = 1;
+const int  PACKET_PARTIAL = 2;
+
+// Sets up a shadow-ray "packet" for all the samples of a bounded light seen from
+// p_hit: every shadow ray lies inside the cone from p_hit which encloses the
+// light's bounding sphere, so shapes whose bounding spheres lie outside the cone
+// can't block any of them. The indices of the remaining shapes (including shapes
+// without bounding spheres) are stored in candidateShapes. If shapeSubset is not
+// NULL, only the shapes with indices in it are considered.
+// Returns PACKET_FULLY_SHADOWED if an opaque shape's inscribed sphere covers the
+// whole cone in front of the light; PACKET_FULLY_LIT if no shape can block any of
+// the rays; and PACKET_PARTIAL otherwise. 
+// If cachedShape >= 0 (the last shape to block this light), it is checked first,
+// so that points deep in its shadow don't need to look at the other shapes.
+// Shadow rays actually start at p_hit + n_hit*BIAS, so shape spheres are grown 
+// (bounding) or shrunk (inscribed) by BIAS, and the distance limits are padded
+// by 2*BIAS.
+int CullShapesForLight( const Point &lightMin, const Point &lightMax, const Point &p_hit,
+						const std::vector<shared_ptr<Shape>> &shapes, 
+						const std::vector<int> *shapeSubset, int cachedShape,
+						bool transparentShadows, std::vector<int> &candidateShapes )
+{
+  Vector  lightDiagonal = lightMax - lightMin;
+  Point  lightCenter = lightMin + 0.5*lightDiagonal;
+  float  lightRadius = 0.5*lightDiagonal.Length();
+  Vector  toLight = lightCenter - p_hit;
+  float  lightDist = toLight.Length();
+
+  int  nShapesToTest = (shapeSubset != NULL) ? (int)shapeSubset->size() : (int)shapes.size();
+  candidateShapes.clear();
+  if (lightDist <= lightRadius + 2*BIAS) {
+    // point is (almost) inside the light's bounds, so the "cone" covers everything
+    for (int i = 0; i < nShapesToTest; ++i)
+      candidateShapes.push_back((shapeSubset != NULL) ? (*shapeSubset)[i] : i);
+    return PACKET_PARTIAL;
+  }
+  Vector  axis = toLight / lightDist;
+  float  sinAngle = lightRadius / lightDist;
+  float  cosAngle = sqrtf(1.0f - sinAngle*sinAngle);
+  float  maxDistance = lightDist + lightRadius + 2*BIAS;
+  float  minDistance = lightDist - lightRadius - 2*BIAS;
+
+  Point  sphereCenter;
+  float  sphereRadius;
+  if ((cachedShape >= 0) && shapes[cachedShape]->GetInscribedSphere(sphereCenter, sphereRadius)
+  		&& SphereBlocksCone(sphereCenter, sphereRadius - BIAS, p_hit, axis, cosAngle, 
+    						sinAngle, minDistance))
+    return PACKET_FULLY_SHADOWED;
+  for (int i = 0; i < nShapesToTest; ++i) {
+    int  j = (shapeSubset != NULL) ? (*shapeSubset)[i] : i;
+    if (! shapes[j]->GetBoundingSphere(sphereCenter, sphereRadius)) {
+      candidateShapes.push_back(j);
+      continue;
+    }
+    if (! SphereOverlapsCone(sphereCenter, sphereRadius + BIAS, p_hit, axis, cosAngle, 
+    						sinAngle, maxDistance))
+      continue;
+    if (((! transparentShadows) || (! shapes[j]->GetMaterial()->translucent))
+    		&& shapes[j]->GetInscribedSphere(sphereCenter, sphereRadius)
+    		&& SphereBlocksCone(sphereCenter, sphereRadius - BIAS, p_hit, axis, cosAngle, 
+    						sinAngle, minDistance))
+      return PACKET_FULLY_SHADOWED;
+    candidateShapes.push_back(j);
+  }
+  if (candidateShapes.size() == 0)
+    return PACKET_FULLY_LIT;
+  return PACKET_PARTIAL;
+}
+
+
+// Returns the diffuse illumination at point p_hit (with normal n_hit) from all the
+// samples of a single light, scaled by weight. Each light sample is shaded with
+// its own direction and intensity (they differ from sample to sample for area
+// and environment lights).
+// Points on the light come from the light-sampling dimension of the pixel
+// sampler (by default, a 2D Owen-scrambled Sobol' sequence), scrambled by
+// lightSeed (which should be different for each pixel and light). Successive
+// camera rays within a pixel continue the same sequence, so the light samples
+// for the whole pixel are stratified together.
+// If context.perPixelLightSamples is true, an area light's nsamples is instead a
+// budget for the whole pixel: light sample k goes to one of the pixel's camera rays
+// (k modulo the number of rays, cyclically shifted by a per-pixel hash so that
+// which rays get the extra samples is random), and each sample is weighted by
+// (number of rays)/nsamples, so the pixel average is unchanged (see LightSampleRange).
+// lightIndex = index of the light in the scene's list (used to look up the
+// per-thread occluder cache in context, if any).
+// shadowCasters = indices of the shapes which can block light from this light
+// (see Scene::BuildShadowCasterLists); NULL means all shapes. Points outside the
+// light's sphere of influence, or behind a one-sided light, get no light from it.
+// If context.lightCutoff > 0, samples whose unoccluded contribution (light intensity
+// x diffuse color) is below the cutoff in every channel are skipped without tracing
+// their shadow rays (except for distant lights).
+// When more than one sample of a bounded light is traced (and context has a
+// scratch list for it), the shadow rays are treated as a packet sharing the same
+// origin: the shapes are culled once against the cone enclosing the light (see
+// CullShapesForLight), and the individual rays are tested only against the
+// surviving shapes -- or not at all, if the packet is fully lit or fully shadowed.
+Color IlluminationFromLight( const shared_ptr<Light> &light, const int lightIndex, 
+							const float weight, 
+							const Point &p_hit, const Vector &n_hit, const Vector &raydir, 
+							const shared_ptr<Material> &material, 
+							const std::vector<shared_ptr<Shape>> &shapes, 
+							const std::vector<int> *shadowCasters,
+							const traceContext &context, const uint32_t lightSeed,
+							bool transparentShadows, bool debug )
+{
+  Color illumination = 0;
+  bool blocked;
+  bool verboseShadowRay = false;
+  Color lightIntensity(0);   // incoming spectrum from light
+  Vector lightDirection;   // direction ray *from light to p_hit*
+  float lightDistance;
+  auto logger = spdlog::get("rt_logger");
+  int *lastOccluder = (context.lastOccluders != NULL) ? &context.lastOccluders[lightIndex] : NULL;
+
+  Point influenceCenter;
+  float influenceRadius;
+  if (light->GetInfluenceSphere(influenceCenter, influenceRadius)
+  		&& ((p_hit - influenceCenter).LengthSquared() > influenceRadius*influenceRadius))
+    return illumination;
+  Point planePoint;
+  Vector planeNormal;
+  if (light->GetEmissionPlane(planePoint, planeNormal) 
+  		&& (Dot(p_hit - planePoint, planeNormal) <= 0.0))
+    return illumination;
+
+  int nSamplesForLight = light->NSamples();   // = 1, except for area lights
+  int firstSampleIndex, endSampleIndex, sampleStep;
+  float perSampleVisibilityFactor;
+  LightSampleRange(nSamplesForLight, context.subsampleIndex, context.nSubsamples, 
+  					context.perPixelLightSamples, PCGHash(lightSeed), &firstSampleIndex, 
+  					&endSampleIndex, &sampleStep, &perSampleVisibilityFactor);
+
+  const std::vector<int> *shapeSubset = shadowCasters;
+  bool packetFullyLit = false;
+  Point lightMin, lightMax;
+  if ((context.packetShapes != NULL) && (endSampleIndex - firstSampleIndex > sampleStep)
+  		&& light->GetBounds(lightMin, lightMax)) {
+    int cachedShape = (lastOccluder != NULL) ? *lastOccluder : -1;
+    int packetStatus = CullShapesForLight(lightMin, lightMax, p_hit, shapes, shadowCasters, 
+    										cachedShape, transparentShadows, *context.packetShapes);
+    if (packetStatus == PACKET_FULLY_SHADOWED)
+      return illumination;
+    packetFullyLit = (packetStatus == PACKET_FULLY_LIT);
+    shapeSubset = context.packetShapes;
+    if (debug)
+      logger->debug("      Shadow-ray packet: status = {}, {} candidate shapes", 
+      				packetStatus, context.packetShapes->size());
+  }
+
+  for (int k = firstSampleIndex; k < endSampleIndex; k += sampleStep) {
+    // get a new shadow ray toward light
+    float u, v;
+    context.sampler->GetSample2D(k, SAMPLE_DIMENSION_LIGHT, lightSeed, &u, &v);
+    light->Illuminate(p_hit, u, v, lightDirection, lightIntensity, lightDistance);
+    lightDirection = Normalize(lightDirection);
+    // samples from behind the surface contribute nothing, so skip the shadow ray
+    if (Dot(n_hit, lightDirection) >= 0.0)
+      continue;
+    // get the shape's base diffuse + specular color combination
+    Color shapeBaseColor = material->GetDiffuseColor(raydir, n_hit, lightDirection);
+    if ((context.lightCutoff > 0.0) && (light->GetType() != LIGHT_DISTANT)
+    		&& (MaxComponent(lightIntensity * shapeBaseColor) < context.lightCutoff))
+      continue;
+    if (debug) {
+      verboseShadowRay = true;
+      logger->debug("      Tracing shadow ray: lightDirection = ({:.2f},{:.2f},{:.2f}), d = {:f}", 
+		       		lightDirection.x,lightDirection.y,lightDirection.z, lightDistance);
+    }
+	float translucencyFactor = 1.0;
+    // do we trace shadow rays through transparent/translucent objects?
+    if (packetFullyLit)
+      blocked = false;
+	else if (transparentShadows)
+      blocked = TraceShadowRay2(-lightDirection, lightDistance, shapes, p_hit, n_hit, 
+    	   						&translucencyFactor, lastOccluder, shapeSubset, verboseShadowRay);
+    else
+      blocked = TraceShadowRay(-lightDirection, lightDistance, shapes, p_hit, n_hit, 
+       							lastOccluder, shapeSubset, verboseShadowRay);
+    if (debug)
+      logger->debug("      blocked = {}", blocked);
+    if (! blocked) {
+      // OK, light from this sample reaches this part of the shape
+      float visibility = translucencyFactor*perSampleVisibilityFactor*weight;
+      illumination += lightIntensity * visibility * shapeBaseColor;
+    }
+  }
+  return illumination;
+}
+
+
 // This is the main ray tracing function. It takes a ray as argument (defined by its origin
 // and direction). We test if this ray intersects any of the geometry in the scene. 
 // If the ray intersects a shape, we compute the intersection point and the normal at
@@ -107,50 +349,48 @@ bool TraceShadowRay2( const Vector &lightDirection, const float lightDistance,
 // depends on the surface property (is it transparent, reflective, diffuse). The function 
 // returns a color for the ray. If the ray intersects a shape, this is the color of the 
 // shape at the intersection point, otherwise it returns the background color.
+//    context = per-camera-ray state (pixel seed, subsample index)
 //    x,y = pixel coordinates for debugging printouts
-Color RayTrace( const Ray currentRay, shared_ptr<Scene> theScene, float *t, const float x=0.f, 
+Color RayTrace( const Ray currentRay, shared_ptr<Scene> theScene, float *t, 
+				const traceContext &context, const float x=0.f, 
 				const float y=0.f, bool transparentShadows=false, bool debug=false )
 {
-  std::vector<shared_ptr<Shape>> shapes = theScene->shapes;
-  std::vector<shared_ptr<Light>> lights = theScene->lights;
+  const std::vector<shared_ptr<Shape>> &shapes = theScene->shapes;
+  const std::vector<shared_ptr<Light>> &lights = theScene->lights;
   shared_ptr<Environment> environment = theScene->environment;
   float  t_newRay;  // will hold distance to intersection of any reflection or
                     // transmission rays launched by this function
   auto logger = spdlog::get("rt_logger");
   if (debug)
-    logger->debug("   Starting RayTrace...");
+    logger->debug("   Starting RayTrace: pixel x,y = {:f},{:f}...", x, y);
 
   // extract Ray data for convenience
   Point  rayorig = currentRay.o;
   Vector  raydir = currentRay.dir;
   int  depth = currentRay.depth;
   
-  float t_nearest = kInfinity;
+  float t_nearest;
   shared_ptr<Shape> intersectedShape = NULL;
   // find intersection of this ray with shapes in the scene
-  int  intersectedObjIndex = -1;
-  for (int i = 0; i < shapes.size(); ++i) {
-    if (auto result = shapes[i]->intersect(rayorig, raydir); result) {
-      intersectionResult  intersection = result.value();
-      if (intersection.t_0 < 0)  // first intersection is *behind* camera, so use the second
-        intersection.t_0 = intersection.t_1;
-      if (intersection.t_0 < t_nearest) {
-          // this shape is closest of all so far
-          t_nearest = intersection.t_0;
-          intersectedShape = shapes[i];
-          intersectedObjIndex = i;
-      }
-    }
-  }
+  int  intersectedObjIndex = NearestIntersection(shapes, rayorig, raydir, &t_nearest);
+  if (intersectedObjIndex >= 0)
+    intersectedShape = shapes[intersectedObjIndex];
   *t = t_nearest;
   if (debug) {
     logger->debug("   RayTrace: End of intersection search: t_nearest = {:f}", t_nearest);
     if (! intersectedShape)
       logger->debug("             No intersection found!");
   }
+  // lighting components are recorded for camera rays only (see aovs.h)
+  Color *lighting = (depth == 1) ? context.lighting : NULL;
+  bool recordPerLight = ((lighting != NULL) && (context.nLightingTerms > N_LIGHTING_COMPONENTS));
   // if there's no intersection, return background color
-  if (! intersectedShape)
-    return environment->GetEnvironmentColor(currentRay);
+  if (! intersectedShape) {
+    Color backgroundColor = environment->GetEnvironmentColor(currentRay);
+    if (lighting != NULL)
+      lighting[LIGHTING_BACKGROUND] += backgroundColor;
+    return backgroundColor;
+  }
   
   
   shared_ptr<Material> material = intersectedShape->GetMaterial();
@@ -173,6 +413,16 @@ Color RayTrace( const Ray currentRay, shared_ptr<Scene> theScene, float *t, cons
   if (debug)
     logger->debug("   RayTrace: n_hit = ({:.2f},{:.2f},{:.2f})", n_hit.x,n_hit.y,n_hit.z);
 
+  // record first-hit features of camera rays (e.g., for denoising)
+  if ((depth == 1) && (context.features != NULL)) {
+    context.features->albedo += material->GetBaseColor();
+    context.features->normal += n_hit;
+    context.features->depth += t_nearest;
+    context.features->coverage += 1.0;
+    context.features->shapeIndex = intersectedObjIndex;
+    if (material->metallic || material->specular || material->translucent)
+      context.features->specularHit = true;
+  }
   
   if (debug)
     logger->debug("   RayTrace: metallic = {}, specular = {}, translucent = {}", 
@@ -192,11 +442,16 @@ Color RayTrace( const Ray currentRay, shared_ptr<Scene> theScene, float *t, cons
       Vector refldir = raydir - n_hit*2*Dot(raydir, n_hit);  // reflection direction
       // This is a reflection, so IOR doesn't change
       Ray reflectionRay(p_hit + n_hit*BIAS, refldir, depth + 1, currentRay.currentIOR);
+      // a curved mirror spreads the ray cone by ~ 2 x (cone width) x curvature
+      float  coneWidthAtHit = currentRay.ConeWidthAt(t_nearest);
+      reflectionRay.coneWidth = coneWidthAtHit;
+      reflectionRay.coneSpread = currentRay.coneSpread + 
+      						2.0*coneWidthAtHit*intersectedShape->GetCurvature(p_hit);
       if (debug) {
         logger->debug("      *Launching reflection ray...");
         logger->debug("      raydir = ({:f},{:f},{:f})", refldir.x,refldir.y,refldir.z);
       }
-      cumulativeReflectionColor = RayTrace(reflectionRay, theScene, &t_newRay, 0.0,0.0,
+      cumulativeReflectionColor = RayTrace(reflectionRay, theScene, &t_newRay, context, 0.0,0.0,
       										transparentShadows);
       if (debug)
         logger->debug("      RETURNED: t_newRay = {:f}; color = ({:f},{:f},{:f})",
@@ -236,7 +491,10 @@ Color RayTrace( const Ray currentRay, shared_ptr<Scene> theScene, float *t, cons
           				refractionDir.x,refractionDir.y,refractionDir.z, outgoingIOR);
         }
         Ray refractionRay(p_hit - n_hit*BIAS, refractionDir, depth + 1, outgoingIOR);
-        cumulativeRefractionColor = RayTrace(refractionRay, theScene, &t_newRay, 0.0,0.0,transparentShadows);
+        refractionRay.coneWidth = currentRay.ConeWidthAt(t_nearest);
+        refractionRay.coneSpread = currentRay.coneSpread;
+        cumulativeRefractionColor = RayTrace(refractionRay, theScene, &t_newRay, context, 0.0,0.0,
+        										transparentShadows);
         if (debug)
           logger->debug("      RETURNED: t_newRay = {:f}; color = ({:f},{:f},{:f})",
         			t_newRay, cumulativeRefractionColor.r,cumulativeRefractionColor.g,
@@ -265,56 +523,88 @@ Color RayTrace( const Ray currentRay, shared_ptr<Scene> theScene, float *t, cons
 //     					(1.0 - R_fresnel)*cumulativeRefractionColor*intersectedShape->transparency;
     surfaceColor = R_fresnel*cumulativeReflectionColor +
     					(1.0 - R_fresnel)*cumulativeRefractionColor;
+    if (lighting != NULL)
+      lighting[LIGHTING_INDIRECT] += surfaceColor;
   }
   
   
   else {
     // it's a diffuse shape, no need to raytrace any further; instead, trace some
     // shadow rays to lights
-    bool blocked;
-    bool verboseShadowRay = false;
     if (debug)
       logger->debug("      *Diffuse reflection:");
-    Color lightIntensity(0);   // incoming spectrum from light
-    Vector lightDirection;   // direction ray *from light to p_hit*
-    float lightDistance;
-    for (int i_light = 0; i_light < lights.size(); ++i_light) {
-      int nSamplesForLight = lights[i_light]->NSamples();   // = 1, except for area lights
-      float perSampleVisibilityFactor = 1.0 / nSamplesForLight;
-      float visibility = 0.0;  // = 0--1 = complete shadowing to no shadowing from this light
-      for (int nn = 0; nn < nSamplesForLight; nn++) {
-        // get a new shadow ray toward light
-        lights[i_light]->Illuminate(p_hit, lightDirection, lightIntensity, lightDistance);
-        lightDirection = Normalize(lightDirection);
-        if (debug) {
-          verboseShadowRay = true;
-          logger->debug("      Tracing shadow ray: lightDirection = ({:.2f},{:.2f},{:.2f}), d = {:f}", 
-		        		lightDirection.x,lightDirection.y,lightDirection.z, lightDistance);
-//           logger->debug("      p_hit = ({:.2f},{:.2f},{:.2f}), n_hit = ({:.2f},{:.2f},{:.2f})",
-//           				p_hit.x,p_hit.y,p_hit.z, n_hit.x,n_hit.y,n_hit.z);
-//           logger->debug("      lightDirection = ({:.2f},{:.2f},{:.2f}), d = {:f}", 
-// 		        		lightDirection.x,lightDirection.y,lightDirection.z, lightDistance);
-        }
-		float translucencyFactor = 1.0;
-        // do we trace shadow rays through transparent/translucent objects?
-		if (transparentShadows)
-          blocked = TraceShadowRay2(-lightDirection, lightDistance, shapes, p_hit, n_hit, 
-    	      						&translucencyFactor, verboseShadowRay);
-    	else
-          blocked = TraceShadowRay(-lightDirection, lightDistance, shapes, p_hit, n_hit, 
-        							verboseShadowRay);
+    // with light linking, only some lights illuminate this shape
+    const std::vector<int> *linkedLights = theScene->LightsForShape(intersectedObjIndex);
+    if (theScene->lightBVH) {
+      // Many-light sampling: lights without finite bounds are always evaluated;
+      // the rest are sampled from the light hierarchy, with each chosen light
+      // weighted by 1/(probability x number of samples). (Sampled lights which
+      // aren't linked to this shape contribute nothing.)
+      for (int i_light : theScene->lightBVH->UnboundedLights()) {
+        if (! theScene->LightIlluminatesShape(i_light, intersectedObjIndex))
+          continue;
+        uint32_t lightSeed = HashCombine(HashCombine(context.pixelSeed, i_light), depth);
+        Color lightColor = IlluminationFromLight(lights[i_light], i_light, 1.0, p_hit, n_hit, 
+        									raydir, material, shapes, theScene->ShadowCasters(i_light), 
+        									context, lightSeed, transparentShadows, debug);
+        surfaceColor += lightColor;
+        if (recordPerLight)
+          lighting[N_LIGHTING_COMPONENTS + i_light] += lightColor;
+      }
+      int nLightSamples = theScene->nLightSamples;
+      uint32_t choiceSeed = HashCombine(context.pixelSeed, depth);
+      for (int n = 0; n < nLightSamples; n++) {
+        float  pdf, uChoice, vUnused;
+        context.sampler->GetSample2D(context.subsampleIndex*nLightSamples + n, 
+        							SAMPLE_DIMENSION_LIGHT_CHOICE, choiceSeed, &uChoice, &vUnused);
+        int i_light = theScene->lightBVH->SampleLight(p_hit, n_hit, uChoice, &pdf);
+        if (i_light < 0)   // no light in the hierarchy can reach this point
+          break;
         if (debug)
-          logger->debug("      blocked = {}", blocked);
-        if (! blocked)
-          visibility += translucencyFactor*perSampleVisibilityFactor;
+          logger->debug("      Sampled light {:d} with probability {:f}", i_light, pdf);
+        if (! theScene->LightIlluminatesShape(i_light, intersectedObjIndex))
+          continue;
+        // (the same light can be chosen more than once, so include n in the seed)
+        uint32_t lightSeed = HashCombine(HashCombine(HashCombine(context.pixelSeed, i_light), 
+        									depth), lights.size() + n);
+        Color lightColor = IlluminationFromLight(lights[i_light], i_light, 
+        									1.0 / (pdf*nLightSamples), p_hit, n_hit, raydir, 
+        									material, shapes, theScene->ShadowCasters(i_light), 
+        									context, lightSeed, transparentShadows, debug);
+        surfaceColor += lightColor;
+        if (recordPerLight)
+          lighting[N_LIGHTING_COMPONENTS + i_light] += lightColor;
       }
-      if (visibility > 0.0) {
-        // OK, light from this particular light source reaches this part of the shape;
-        // get the shape's base diffuse + specular color combination
-        Color shapeBaseColor = material->GetDiffuseColor(raydir, n_hit, lightDirection);
-        surfaceColor += lightIntensity * visibility * shapeBaseColor;
+    }
+    else {
+      // for camera rays (depth = 1), use the screen tile's lights if the hit is
+      // within the tile's depth range (still checking light linking, if any)
+      const std::vector<int> *lightList = linkedLights;
+      bool checkLinks = false;
+      const std::vector<int> *tileList = NULL;
+      if (depth == 1)
+        tileList = TileLightsForDepth(context.tileLights, context.tileDepthMin, 
+        								context.tileDepthMax, -p_hit.z);
+      if (tileList != NULL) {
+        lightList = tileList;
+        checkLinks = (linkedLights != NULL);
+      }
+      int nLightsToUse = (lightList != NULL) ? (int)lightList->size() : (int)lights.size();
+      for (int i = 0; i < nLightsToUse; ++i) {
+        int i_light = (lightList != NULL) ? (*lightList)[i] : i;
+        if (checkLinks && (! theScene->LightIlluminatesShape(i_light, intersectedObjIndex)))
+          continue;
+        uint32_t lightSeed = HashCombine(HashCombine(context.pixelSeed, i_light), depth);
+        Color lightColor = IlluminationFromLight(lights[i_light], i_light, 1.0, p_hit, n_hit, 
+        									raydir, material, shapes, theScene->ShadowCasters(i_light), 
+        									context, lightSeed, transparentShadows, debug);
+        surfaceColor += lightColor;
+        if (recordPerLight)
+          lighting[N_LIGHTING_COMPONENTS + i_light] += lightColor;
       }
     }
+    if (lighting != NULL)
+      lighting[LIGHTING_DIRECT] += surfaceColor;
   }
 
   if (debug) {
@@ -323,11 +613,107 @@ Color RayTrace( const Ray currentRay, shared_ptr<Scene> theScene, float *t, cons
     Color emiss = material->GetEmissionColor();
   	logger->debug("      emissionColor = ({:f}, {:f}, {:f})", emiss.r, emiss.g, emiss.b);
   }
-  return surfaceColor + material->GetEmissionColor();
+  Color emissionColor = material->GetEmissionColor();
+  if (lighting != NULL)
+    lighting[LIGHTING_EMISSION] += emissionColor;
+  return surfaceColor + emissionColor;
 }
 
 
 
+// Seed for pixel (x,y)'s sampling patterns (camera subsamples, light samples); the
+// render seed (--seed) changes the patterns of every pixel
+inline uint32_t PixelSeed( int x, int y, uint32_t renderSeed )
+{
+  return HashCombine(HashCombine(PCGHash(x), y), renderSeed);
+}
+
+
+// Fast visibility-only rendering for the alpha-mask, object-ID, and depth modes: only
+// camera rays are traced (no shading, shadows, or secondary rays), and the result is
+// stored in all three channels of each pixel.
+//    ALPHA_MASK: fraction of the pixel's camera rays (subsamples) which hit anything
+//    OBJECT_ID_MAP: 1 + index of the shape seen through the pixel center (0 = none)
+//    DEPTH_MAP: distance along the ray through the pixel center to the nearest
+//       shape (kInfinity = none)
+// (Object IDs and depths can't be meaningfully averaged, so these use one ray per pixel.)
+void RenderVisibilityImage( const vector<shared_ptr<Shape>> &shapes, const Camera &camera,
+							Color *image, const int width, const int height, const int mode,
+							uint32_t renderSeed )
+{
+  int  nSubsamples = camera.sampler->NSamples();
+  
+  #pragma omp parallel for schedule(dynamic)
+  for (int y = 0; y < height; ++y) {
+    float  xx, yy, t_nearest;
+    for (int x = 0; x < width; ++x) {
+      float  value;
+      if (mode == ALPHA_MASK) {
+        uint32_t  pixelSeed = PixelSeed(x, y, renderSeed);
+        int  nHits = 0;
+        for (int n = 0; n < nSubsamples; ++n) {
+          Ray cameraRay = camera.GenerateCameraRay(x, y, n, pixelSeed, &xx, &yy);
+          if (camera.apertureRadius > 0.0)
+            cameraRay = camera.GenerateLensRay(cameraRay, n, pixelSeed);
+          if (AnyIntersection(shapes, cameraRay.o, cameraRay.dir))
+            nHits++;
+        }
+        value = (float)nHits / nSubsamples;
+      }
+      else {
+        Ray cameraRay = camera.GeneratePixelCenterRay(x, y);
+        int  shapeIndex = NearestIntersection(shapes, cameraRay.o, cameraRay.dir, &t_nearest);
+        if (mode == OBJECT_ID_MAP)
+          value = shapeIndex + 1;
+        else
+          value = t_nearest;
+      }
+      image[y*width + x] = Color(value);
+    }
+  }
+}
+
+
+// Pseudo-random (but repeatable) color for an object ID: each of r, g, b is taken
+// from one byte of the ID's hash and lies in [0.2,1], so no object is black
+Color ObjectIDColor( int objectID )
+{
+  uint32_t  hash = PCGHash(objectID);
+  float  r = 0.2 + 0.8*(hash & 0xff)/255.0;
+  float  g = 0.2 + 0.8*((hash >> 8) & 0xff)/255.0;
+  float  b = 0.2 + 0.8*((hash >> 16) & 0xff)/255.0;
+  return Color(r, g, b);
+}
+
+
+// Rescales an object-ID or depth image from RenderImage() so that it can be saved
+// as an 8-bit image (without gamma correction). Each object ID becomes its own color
+// (see ObjectIDColor; 0 = no object stays black), since there are generally more IDs
+// than byte values; to recover the actual IDs, save the image as EXR. Depths are
+// divided by the largest depth in the image (pixels which don't see anything are
+// white).
+void ScaleVisibilityImage( Color *image, const int width, const int height, const int mode )
+{
+  int  nPixels = width*height;
+  if (mode == OBJECT_ID_MAP) {
+    for (int i = 0; i < nPixels; i++) {
+      int  objectID = (int)image[i].r;
+      image[i] = (objectID > 0) ? ObjectIDColor(objectID) : Color(0);
+    }
+    return;
+  }
+
+  float  maxDepth = 0.0;
+  for (int i = 0; i < nPixels; i++) {
+    if (image[i].r < kInfinity)
+      maxDepth = fmaxf(maxDepth, image[i].r);
+  }
+  float  scale = (maxDepth > 0.0) ? 1.0 / maxDepth : 1.0;
+  for (int i = 0; i < nPixels; i++)
+    image[i] = (image[i].r < kInfinity) ? image[i]*scale : Color(1);
+}
+
+
 // Main rendering function. We compute a camera ray for each pixel of the image,
 // trace it, and return a color. 
 // (If oversampleRate > 1, we do this multiple tiomes for each pixel and add up the
@@ -335,13 +721,12 @@ Color RayTrace( const Ray currentRay, shared_ptr<Scene> theScene, float *t, cons
 // If a ray hits a shape, we return the color of the shape at the intersection 
 // point, otherwise we return the background color.
 void RenderImage( shared_ptr<Scene> theScene, Color *image, const int width, const int height, 
-				const traceOptions &options )
+				const traceOptions &options, AOVBuffers *aovs, TiledEXRWriter *tileWriter )
 {
   Color *pixelArray = image;
   std::shared_ptr<Camera> theCamera;
   //Ray  cameraRay;
   Vector  cameraRay_dir;
-  int  oversampleRate = 1;
   float  xx, yy, oversampleScaling;
   float  t_newRay;  // will hold distance traveled by primary ray (not used, but needed by RayTrace)
   int  nSubsamples, iCurrentPix;
@@ -351,16 +736,39 @@ void RenderImage( shared_ptr<Scene> theScene, Color *image, const int width, con
   auto logger = spdlog::get("rt_logger");
   logger->info("Starting RenderImage...");
   
+  // wait for anything still loading in the background (e.g., environment maps)
+  // (not needed for the visibility-only modes, which don't use lights)
+  bool  visibilityOnly = (options.mode != DEFAULT_TRACE_MODE);
+  if (! visibilityOnly) {
+    theScene->SetLightSampling(options.nLightSamples);
+    theScene->SetLightCutoff(options.lightCutoff);
+    theScene->PrepareForRender();
+    logger->info("RenderImage: scene is ready.");
+  }
+
   theCamera = theScene->GetCamera();
   if (options.fieldOfViewSet)
     theCamera->SetFOV(options.fieldOfView);
   theCamera->SetImageSize(width, height);
 
   // setup for oversampling
-  theCamera->SetSampling(options.oversampling, options.samplerName);
-  oversampleRate = options.oversampling;
-  nSubsamples = oversampleRate*oversampleRate;
-  oversampleScaling = 1.0 / (oversampleRate * oversampleRate);
+  theCamera->SetSampling(options.oversampling, options.samplerName, options.nPixelSamples);
+  nSubsamples = theCamera->sampler->NSamples();
+  oversampleScaling = 1.0 / nSubsamples;
+  uint32_t  renderSeed = (uint32_t)options.rngSeed;
+
+  // from here on, the camera and its sampler are read-only (and shared by all threads)
+  const Camera &camera = *theCamera;
+  
+  
+  // FAST VISIBILITY-ONLY MODES (alpha mask, object IDs, depth)
+  if (visibilityOnly) {
+    RenderVisibilityImage(theScene->shapes, camera, pixelArray, width, height, options.mode,
+    						renderSeed);
+    logger->info("RenderImage: Done with visibility-only render.");
+    printf("\nDone with render.\n");  
+    return;
+  }
   
   
   // SPECIAL SINGLE-PIXEL DEBUGGING MODE
@@ -369,8 +777,16 @@ void RenderImage( shared_ptr<Scene> theScene, Color *image, const int width, con
     Color cumulativeColor = Color(0);
     int x = options.singlePixel_x;
     int y = options.singlePixel_y;
-    Ray cameraRay = theCamera->GenerateCameraRay(x, y, 0, &xx, &yy);
-    cumulativeColor += RayTrace(cameraRay, theScene, &t_newRay, xx, yy,
+    traceContext  context;
+    vector<int>  lastOccluders(theScene->lights.size(), -1);
+    vector<int>  packetShapes;
+    context.pixelSeed = PixelSeed(x, y, renderSeed);
+    context.sampler = camera.sampler.get();
+    context.lastOccluders = lastOccluders.data();
+    context.packetShapes = &packetShapes;
+    context.lightCutoff = options.lightCutoff;
+    Ray cameraRay = camera.GenerateCameraRay(x, y, 0, context.pixelSeed, &xx, &yy);
+    cumulativeColor += RayTrace(cameraRay, theScene, &t_newRay, context, xx, yy,
         						options.shadowTransparency, true);
     logger->debug("RenderImage: Done with single-pixel debug mode.");
     return;
@@ -378,46 +794,169 @@ void RenderImage( shared_ptr<Scene> theScene, Color *image, const int width, con
   
   
   // NORMAL FULL-IMAGE-RENDERING MODE
-  // Trace the rays, with possible per-pixel oversampling
+  // Per-tile light lists are only useful if some lights have limited influence,
+  // and require a pinhole camera (and aren't used with the light hierarchy)
+  unique_ptr<TileLightLists>  tileLightLists;
+  bool  limitedLightsPresent = false;
+  Point  influenceCenter;
+  float  influenceRadius;
+  for (auto &light : theScene->lights) {
+    if (light->GetInfluenceSphere(influenceCenter, influenceRadius))
+      limitedLightsPresent = true;
+  }
+  if (limitedLightsPresent && (camera.apertureRadius <= 0.0) && (! theScene->lightBVH)) {
+    tileLightLists = make_unique<TileLightLists>(camera, width, height, theScene->shapes,
+    												theScene->lights);
+    logger->info("RenderImage: built per-tile light lists.");
+  }
+
+  // Trace the rays, with possible per-pixel oversampling, one tile at a time.
+  // Pixel values don't depend on which thread renders them, so tiles can be
+  // scheduled dynamically.
+  int nTilesX = (width + RENDER_TILE_SIZE - 1) / RENDER_TILE_SIZE;
+  int nTilesY = (height + RENDER_TILE_SIZE - 1) / RENDER_TILE_SIZE;
   int nDone = 0;
 
+  // Edge-adaptive oversampling: a first pass traces one ray through the center of
+  // each pixel; the second pass then oversamples only the pixels near edges (see
+  // FindPixelsToRefine), keeping the first-pass colors for the rest
+  bool  adaptive = (options.adaptiveSampling && (nSubsamples > 1));
+  if (adaptive && (camera.apertureRadius > 0.0)) {
+    printf("   Adaptive oversampling can't be used with depth of field; ignoring it.\n");
+    adaptive = false;
+  }
+  // (streaming output means we never have the whole image, which adaptive
+  // oversampling and denoising need)
+  bool  denoise = options.denoise;
+  if ((tileWriter != NULL) && (adaptive || denoise)) {
+    printf("   Adaptive oversampling and denoising can't be used with streaming output; ignoring them.\n");
+    adaptive = denoise = false;
+  }
+  // first-hit feature buffers (for the denoiser, the adaptive-oversampling pass,
+  // and AOVs)
+  bool  recordFeatures = (denoise || adaptive || (aovs != NULL));
+  vector<pixelFeatures>  localFeatures;
+  pixelFeatures  *features = NULL;
+  if (aovs != NULL)
+    features = aovs->Features();
+  else if (recordFeatures) {
+    localFeatures.resize(nPixTot);
+    features = localFeatures.data();
+  }
+  bool  recordLighting = ((aovs != NULL) && (aovs->NLightingTerms() > 0));
+  vector<uint8_t>  refinePixel;
+
 #pragma omp parallel private(iCurrentPix,xx,yy,t_newRay)
   {
-  // specify static scheduling with fixed chunk size to keep things deterministic
-  #pragma omp for schedule(static,10)
-  for (int y = 0; y < height; ++y) {
-    for (int x = 0; x < width; ++x) {
-      Color cumulativeColor = Color(0);
-      //theCamera->UpdateSampler();
-      for (int n = 0; n < nSubsamples; ++n) {
-        Ray cameraRay = theCamera->GenerateCameraRay(x, y, n, &xx, &yy);
-        if (theCamera->apertureRadius > 0.0) {
-          // Depth-of-field!
-          // Determine intersection of cameraRay with focalDistance plane
-          // (cameraRay.dir.z is < 0, so we need to take negative of that to
-          // get positive distance value)
-          float  dist_to_focalPlane = theCamera->focalDistance / (-cameraRay.dir.z);
-          Point focalPoint = cameraRay(dist_to_focalPlane);
-          // Pick point on camera "lens"
-          Point lensOffsetPoint = theCamera->GenerateLensPoint();
-          cameraRay = Ray(lensOffsetPoint, focalPoint - lensOffsetPoint);
-        }
-        cumulativeColor += RayTrace(cameraRay, theScene, &t_newRay, xx, yy,
-        							options.shadowTransparency);
+  // per-thread cache of the last shape to block each light (see TraceShadowRay)
+  vector<int>  lastOccluders(theScene->lights.size(), -1);
+  // per-thread scratch list of shapes for shadow-ray packets
+  vector<int>  packetShapes;
+  packetShapes.reserve(theScene->shapes.size());
+  // per-thread tile buffer for streaming output
+  vector<Color>  tilePixels;
+  if (tileWriter != NULL)
+    tilePixels.resize(RENDER_TILE_SIZE*RENDER_TILE_SIZE);
+  // pass 0 = first (single-ray) pass of adaptive oversampling; pass 1 = main pass
+  for (int pass = (adaptive ? 0 : 1); pass < 2; ++pass) {
+    bool firstPass = (pass == 0);
+    int nRaysPerPixel = firstPass ? 1 : nSubsamples;
+    if (adaptive && (! firstPass)) {
+      #pragma omp single
+      {
+      int nRefine = FindPixelsToRefine(pixelArray, features, width, height, refinePixel);
+      printf("   Oversampling %d of %d pixels\n", nRefine, nPixTot);
+      logger->info("RenderImage: oversampling {:d} of {:d} pixels.", nRefine, nPixTot);
+      // progress reports are for the pixels rendered in this pass
+      tenPercent = std::max(nRefine / 10, 1);
+      // pixels which won't be oversampled are smooth (as far as the first pass can
+      // tell), so the denoiser can treat them as noise-free
+      for (int i = 0; i < nPixTot; i++) {
+        if (! refinePixel[i])
+          features[i].colorVariance = Color(0);
       }
-      iCurrentPix = y*width + x;
-      pixelArray[iCurrentPix] = cumulativeColor * oversampleScaling;
-      nDone++;
-      if ((nDone % tenPercent) == 0) {
-      	//int percentSoFar = (int)(nDone / tenPercent);
-        printf("... %d0%% ", (int)(nDone / tenPercent));
-        fflush(stdout);
       }
-    } 
+    }
+    #pragma omp for schedule(dynamic)
+    for (int tile = 0; tile < nTilesX*nTilesY; ++tile) {
+      int x0 = (tile % nTilesX)*RENDER_TILE_SIZE;
+      int y0 = (tile / nTilesX)*RENDER_TILE_SIZE;
+      for (int y = y0; y < std::min(y0 + RENDER_TILE_SIZE, height); ++y) {
+        for (int x = x0; x < std::min(x0 + RENDER_TILE_SIZE, width); ++x) {
+          iCurrentPix = y*width + x;
+          if ((! firstPass) && adaptive && (! refinePixel[iCurrentPix]))
+            continue;
+          Color cumulativeColor = Color(0);
+          traceContext  context;
+          context.pixelSeed = PixelSeed(x, y, renderSeed);
+          context.sampler = camera.sampler.get();
+          context.lastOccluders = lastOccluders.data();
+          context.packetShapes = &packetShapes;
+          context.nSubsamples = nRaysPerPixel;
+          context.perPixelLightSamples = options.perPixelLightSamples;
+          context.lightCutoff = options.lightCutoff;
+          if (tileLightLists) {
+            context.tileLights = &tileLightLists->Lights(tile);
+            context.tileDepthMin = tileLightLists->DepthMin(tile);
+            context.tileDepthMax = tileLightLists->DepthMax(tile);
+          }
+          if (recordFeatures) {
+            features[iCurrentPix] = pixelFeatures();
+            context.features = &features[iCurrentPix];
+          }
+          if (recordLighting) {
+            aovs->ClearLighting(iCurrentPix);
+            context.lighting = aovs->Lighting(iCurrentPix);
+            context.nLightingTerms = aovs->NLightingTerms();
+          }
+          for (int n = 0; n < nRaysPerPixel; ++n) {
+            context.subsampleIndex = n;
+            Ray cameraRay;
+            if (firstPass) {
+              cameraRay = camera.GeneratePixelCenterRay(x, y);
+              xx = x;
+              yy = y;
+            }
+            else
+              cameraRay = camera.GenerateCameraRay(x, y, n, context.pixelSeed, &xx, &yy);
+            if (camera.apertureRadius > 0.0)   // depth-of-field!
+              cameraRay = camera.GenerateLensRay(cameraRay, n, context.pixelSeed);
+            Color sampleColor = RayTrace(cameraRay, theScene, &t_newRay, context, xx, yy,
+            							options.shadowTransparency);
+            cumulativeColor += sampleColor;
+            if (recordFeatures)
+              context.features->colorVariance += sampleColor*sampleColor;
+          }
+          Color &pixelColor = (tileWriter != NULL) ? tilePixels[(y - y0)*RENDER_TILE_SIZE + x - x0]
+          											: pixelArray[iCurrentPix];
+          pixelColor = firstPass ? cumulativeColor : cumulativeColor * oversampleScaling;
+          if (recordFeatures)
+            NormalizePixelFeatures(features[iCurrentPix], nRaysPerPixel, pixelColor);
+          if (recordLighting)
+            aovs->NormalizeLighting(iCurrentPix, nRaysPerPixel);
+          if (firstPass)
+            continue;
+          nDone++;
+          if ((nDone % tenPercent) == 0) {
+          	//int percentSoFar = (int)(nDone / tenPercent);
+            printf("... %d0%% ", (int)(nDone / tenPercent));
+            fflush(stdout);
+          }
+        } 
+      }
+      if (tileWriter != NULL)
+        tileWriter->SubmitTile(tile % nTilesX, tile / nTilesX, tilePixels.data());
+    }
   }
 
   } // end omp parallel section
 
   logger->info("RenderImage: Done with render.");
   printf("\nDone with render.\n");  
+
+  if (denoise) {
+    printf("Denoising image...\n");
+    DenoiseImage(pixelArray, features, width, height, options.denoiseRadius);
+    logger->info("RenderImage: Done with denoising.");
+  }
 }
@@ -8,11 +8,41 @@
 
 #include "scene.h"
 #include "color.h"
+#include "geometry.h"
+#include "shapes.h"
 #include "option_structs.h"
+#include "aovs.h"
+#include "exr_tile_writer.h"
 
 
+/// If aovs is non-NULL, the AOVs it requests are recorded along with the image.
+/// If tileWriter is non-NULL (streaming output), each tile is handed to it as soon
+/// as it's finished instead of being stored in image, which can then be NULL;
+/// adaptive oversampling, denoising, and AOVs aren't available in this case.
 void RenderImage( shared_ptr<Scene> theScene, Color *image, const int width, const int height, 
-					const traceOptions &options );
+					const traceOptions &options, AOVBuffers *aovs=NULL, 
+					TiledEXRWriter *tileWriter=NULL );
+
+/// Returns true if any shape blocks the shadow ray from p_hit toward a light at
+/// lightDistance along lightDirection. If lastOccluder is non-NULL, the shape it
+/// names is tested first, and it's updated when another shape blocks the ray
+bool TraceShadowRay( const Vector &lightDirection, const float lightDistance, 
+					const std::vector<shared_ptr<Shape>> &shapes, const Point &p_hit,
+					const Vector &n_hit, int *lastOccluder, 
+					const std::vector<int> *shapeSubset, bool verbose );
+
+/// Same as TraceShadowRay, but translucent shapes don't block the ray (and are
+/// never stored in *lastOccluder)
+bool TraceShadowRay2( const Vector &lightDirection, const float lightDistance, 
+					const std::vector<shared_ptr<Shape>> &shapes, const Point &p_hit,
+					const Vector &n_hit, float *attenuation, int *lastOccluder, 
+					const std::vector<int> *shapeSubset, bool verbose );
+
+/// Distinct (non-black) color for displaying an object ID in 8-bit images
+Color ObjectIDColor( int objectID );
+
+/// Converts an object-ID or depth image to displayable colors (for non-EXR output)
+void ScaleVisibilityImage( Color *image, const int width, const int height, const int mode );
 
 
 #endif   // _RENDER_H_
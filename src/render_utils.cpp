@@ -1,25 +1,74 @@
 #include <math.h>
 #include <vector>
+#include <algorithm>
 
 #include "geometry.h"
+#include "definitions.h"
 #include "render_utils.h"
-#include "mersenne_twister.h"
 
 
-// Generate random position (x,y,0) within unit disk, using rejection sampling
+// Maps uniform sample (u,v) in [0,1)^2 to position (x,y,0) within the unit disk,
+// using the concentric mapping of Shirley & Chiu (1997), which maps concentric
+// squares to concentric circles (so stratification of (u,v) is preserved).
 // For simplicity in use by Camera::GenerateLensePoint, we actually output this
 // as a Vector (in effect, the vector offset from the center of the unit circle).
-Vector UnitDisk_RejectionSample()
+Vector UnitDisk_ConcentricSample( float u, float v )
 {
-  float  x, y;
-  do {
-    // generate random numbers in range [-0.5,0.5]
-    x = (float)genrand_real1() - 0.5;
-    y = (float)genrand_real1() - 0.5;
-  } while ((x*x + y*y) >= 0.25);
-  // Generate point offset in x,y (multiply by 2 to convert [-0.5,0.5]
-  // to [-1,1])
-  return Vector(2.0*x, 2.0*y, 0);
+  // map to [-1,1]^2
+  float  a = 2.0*u - 1.0;
+  float  b = 2.0*v - 1.0;
+  if ((a == 0.0) && (b == 0.0))
+    return Vector(0, 0, 0);
+
+  float  r, theta;
+  if (fabsf(a) > fabsf(b)) {
+    r = a;
+    theta = (PI/4.0) * (b/a);
+  }
+  else {
+    r = b;
+    theta = PI/2.0 - (PI/4.0) * (a/b);
+  }
+  return Vector(r*cosf(theta), r*sinf(theta), 0);
+}
+
+
+// Computes the cumulative distribution of triangle areas for the fan of
+// triangles (center, vertex i, vertex i+1) making up the polygon; triangleCDF
+// must have room for nSides + 1 values (triangleCDF[0] = 0, triangleCDF[nSides] = 1)
+void MakePolygonTriangleCDF( int nSides, const float vertices[], float triangleCDF[] )
+{
+  triangleCDF[0] = 0.0;
+  for (int i = 0; i < nSides; i++) {
+    int  next = (i + 1) % nSides;
+    float  area = 0.5*fabsf(vertices[2*i]*vertices[2*next + 1] - vertices[2*next]*vertices[2*i + 1]);
+    triangleCDF[i + 1] = triangleCDF[i] + area;
+  }
+  for (int i = 1; i <= nSides; i++)
+    triangleCDF[i] /= triangleCDF[nSides];
+}
+
+
+// Maps uniform sample (u,v) in [0,1)^2 to position (x,y,0) within the polygon
+// (which must be star-shaped with respect to the origin -- true for the regular
+// aperture polygons). u selects one of the fan triangles (center, vertex i, vertex
+// i+1) in proportion to its area and is then rescaled for re-use; the point is
+// then placed within the triangle using the standard square-root mapping.
+// For simplicity in use by Camera::GenerateLensePoint, we actually output this
+// as a Vector (in effect, the vector offset from the center of the unit circle).
+Vector UnitPolygon_Sample( float u, float v, int nSides, const float vertices[], 
+							const float triangleCDF[] )
+{
+  int  i = (int)(std::upper_bound(triangleCDF + 1, triangleCDF + nSides, u) - (triangleCDF + 1));
+  int  next = (i + 1) % nSides;
+  float  uTriangle = (u - triangleCDF[i]) / (triangleCDF[i + 1] - triangleCDF[i]);
+
+  // distance from center (as fraction of the way to the outer edge), then position
+  // along the outer edge
+  float  s = sqrtf(fminf(uTriangle, 1.0f));
+  float  x = s*((1.0f - v)*vertices[2*i] + v*vertices[2*next]);
+  float  y = s*((1.0f - v)*vertices[2*i + 1] + v*vertices[2*next + 1]);
+  return Vector(x, y, 0);
 }
 
 
@@ -127,19 +176,67 @@ bool InsidePolygon( float x, float y, int nSides, const float vertices[] )
 }
 
 
-// Generate random position (x,y,0) within unit polygon, using rejection sampling
-// For simplicity in use by Camera::GenerateLensePoint, we actually output this
-// as a Vector (in effect, the vector offset from the center of the unit circle).
-Vector UnitPolygon_RejectionSample( int nSides, const float vertices[] )
+// Conservative test for overlap between a sphere and a cone truncated at maxDistance
+// (used to cull shapes for shadow-ray packets). For a sphere in front of the apex,
+// perpendicular*cosAngle - along*sinAngle is the distance from the sphere's center
+// to the plane through the apex which touches the cone along the generator nearest
+// to the center; since the cone lies entirely on one side of that plane, the
+// sphere can't overlap the cone if this distance is > radius.
+bool SphereOverlapsCone( const Point &center, float radius, const Point &apex, 
+						const Vector &axis, float cosAngle, float sinAngle, float maxDistance )
 {
-  float  x, y;
-  do {
-    // generate random numbers in range [-1,1]
-    x = 2.0 * ((float)genrand_real1() - 0.5);
-    y = 2.0 * ((float)genrand_real1() - 0.5);
-  } while (! InsidePolygon(x, y, nSides, vertices));
-  // Generate point offset in x,y
-  return Vector(x, y, 0);
+  Vector  w = center - apex;
+  if (w.LengthSquared() <= radius*radius)   // apex is inside the sphere
+    return true;
+  float  along = Dot(w, axis);
+  if ((along < -radius) || (along - radius > maxDistance))
+    return false;
+  float  perpendicular = (w - along*axis).Length();
+  return (perpendicular*cosAngle - along*sinAngle <= radius);
+}
+
+
+// The sphere (seen from the apex) covers a circle of angular radius alpha, with
+// sin(alpha) = radius/distance; it covers the whole cone if the angle between the
+// cone axis and the direction to the sphere (beta) satisfies beta + theta <= alpha.
+// Every such ray enters the sphere at a distance <= the distance to its center,
+// so the sphere blocks the rays if that is < minDistance.
+bool SphereBlocksCone( const Point &center, float radius, const Point &apex, 
+						const Vector &axis, float cosAngle, float sinAngle, float minDistance )
+{
+  Vector  w = center - apex;
+  float  distance = w.Length();
+  if ((distance <= radius) || (distance >= minDistance))
+    return false;
+  float  sinAlpha = radius / distance;
+  float  cosAlpha = sqrtf(1.0f - sinAlpha*sinAlpha);
+  float  cosBeta = Dot(w, axis) / distance;
+  float  sinBeta = sqrtf(fmaxf(0.0f, 1.0f - cosBeta*cosBeta));
+  // cos(beta + theta) >= cos(alpha)
+  return (cosBeta*cosAngle - sinBeta*sinAngle >= cosAlpha);
+}
+
+
+// Per-pixel budget: ray s takes samples first, first + N, first + 2N, ... (N =
+// nSubsamples), with first = (s + shift) mod N. As s runs over the pixel's rays,
+// first takes each value 0 ... N-1 once, so each of the nSamples indices is used
+// by exactly one ray (and rays with first >= nSamples trace none). Reducing shift
+// modulo N first keeps s + shift from wrapping around, which would break this.
+void LightSampleRange( int nSamples, int subsampleIndex, int nSubsamples, bool perPixel, 
+						uint32_t shift, int *first, int *end, int *step, float *weight )
+{
+  if (perPixel && (nSamples > 1)) {
+    *first = (subsampleIndex + (int)(shift % nSubsamples)) % nSubsamples;
+    *end = nSamples;
+    *step = nSubsamples;
+    *weight = (float)nSubsamples / nSamples;
+  }
+  else {
+    *first = subsampleIndex*nSamples;
+    *end = *first + nSamples;
+    *step = 1;
+    *weight = 1.0 / nSamples;
+  }
 }
 
 
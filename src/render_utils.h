@@ -6,6 +6,7 @@
 
 #include <string>
 #include <vector>
+#include <stdint.h>
 #include "geometry.h"
 
 /// simple class for holding return data for a successful intersection
@@ -15,11 +16,36 @@ typedef struct {
 } intersectionResult;
 
 
-/// Returns random position within unit disk
-Vector UnitDisk_RejectionSample();
+/// Returns position within unit disk, given uniform sample (u,v) in [0,1)^2
+Vector UnitDisk_ConcentricSample( float u, float v );
 
-/// Returns random position within unit polygon
-Vector UnitPolygon_RejectionSample( int nSides, const float vertices[] );
+/// Computes cumulative area fractions (nSides + 1 values) for the triangle fan of a polygon
+void MakePolygonTriangleCDF( int nSides, const float vertices[], float triangleCDF[] );
+
+/// Returns position within unit polygon, given uniform sample (u,v) in [0,1)^2
+Vector UnitPolygon_Sample( float u, float v, int nSides, const float vertices[], 
+							const float triangleCDF[] );
+
+/// Returns true if (x,y) is inside the polygon
+bool InsidePolygon( float x, float y, int nSides, const float vertices[] );
+
+/// Returns false if the sphere cannot overlap the cone with the given apex, (unit)
+/// axis, and half-angle (cosAngle, sinAngle), truncated at maxDistance from the
+/// apex (conservative: true means "might overlap")
+bool SphereOverlapsCone( const Point &center, float radius, const Point &apex, 
+						const Vector &axis, float cosAngle, float sinAngle, float maxDistance );
+
+/// Returns true if every ray from apex within the cone hits the sphere at less than
+/// minDistance from the apex
+bool SphereBlocksCone( const Point &center, float radius, const Point &apex, 
+						const Vector &axis, float cosAngle, float sinAngle, float minDistance );
+
+/// Range of light-sample indices k (first <= k < end, in steps of step) traced by
+/// camera ray subsampleIndex of a pixel for a light with nSamples samples, and the
+/// weight of each sample. If perPixel is true, nSamples is a budget for the pixel's
+/// nSubsamples rays, rotated among them by shift (e.g., a per-pixel hash)
+void LightSampleRange( int nSamples, int subsampleIndex, int nSubsamples, bool perPixel, 
+						uint32_t shift, int *first, int *end, int *step, float *weight );
 
 /// Returns refraction direction as vector -- NO LONGER NEEDED?
 Vector Refraction( const Vector &incident, const Vector &normal, float ior1, float ior2 );
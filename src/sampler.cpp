@@ -1,4 +1,6 @@
 #include "sampler.h"
+#include "low_discrepancy.h"
+
 
 Sampler::Sampler( const int sampleRate )
 {
@@ -8,15 +10,6 @@ Sampler::Sampler( const int sampleRate )
 }
 
 
-/// To be redefined in other classes or subclasses (e.g., for random sampling,
-/// we want to compute new values for xOffsets and yOffsets whenever this is
-/// called
-void Sampler::Update( )
-{
-  ;
-}
-
-
 Sampler::~Sampler( )
 {
   ;
@@ -31,3 +24,23 @@ void Sampler::GetOffsetCoords( const int n, float *xOffset, float *yOffset ) con
   *yOffset = 0.0;
 }
 
+
+
+void Sampler::GetOffsetCoords( const int n, const uint32_t, float *xOffset, 
+								float *yOffset ) const
+{
+  GetOffsetCoords(n, xOffset, yOffset);
+}
+
+
+void Sampler::GetSample2D( const int n, const int dimension, const uint32_t seed, 
+							float *u, float *v ) const
+{
+  if (dimension == SAMPLE_DIMENSION_PIXEL) {
+    GetOffsetCoords(n, seed, u, v);
+    *u += 0.5;
+    *v += 0.5;
+  }
+  else
+    SobolOwen2D(n, HashCombine(seed, dimension), u, v);
+}
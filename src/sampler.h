@@ -4,10 +4,23 @@
 #ifndef _SAMPLER_H_
 #define _SAMPLER_H_
 
+#include <stdint.h>
+
+
+// Sampling "dimensions": each is a separate 2D sample pattern, so that (e.g.)
+// the lens positions for a pixel's subsamples are decorrelated from their
+// image-plane positions
+const int SAMPLE_DIMENSION_PIXEL = 0;
+const int SAMPLE_DIMENSION_LENS = 1;
+const int SAMPLE_DIMENSION_LIGHT = 2;
+const int SAMPLE_DIMENSION_LIGHT_CHOICE = 3;   // choosing which light to sample
+
 
 // The idea is to have an object which will precompute the coordinates of each
 // subsample (relative to the pixel center), and pass those coordinates out one
-// by one.
+// by one. Samplers are not modified after construction; any randomness is
+// derived from the sample number and a seed, so they can be shared between
+// threads.
 
 class Sampler 
 { 
@@ -17,12 +30,25 @@ public:
   Sampler( const int sampleRate=1 );
   virtual ~Sampler( );
 
-  /// Recompute internal offset vectors (if implemented)
-  virtual void Update( );
-  
   /// Computes offset in x and y xOffset, yOffset for sample number n
   virtual void GetOffsetCoords( const int n, float *xOffset, float *yOffset ) const;
 
+  /// Same, but with the sample pattern decorrelated between pixels via pixelSeed
+  /// (default is to ignore pixelSeed)
+  virtual void GetOffsetCoords( const int n, const uint32_t pixelSeed, float *xOffset, 
+  								float *yOffset ) const;
+
+  /// Computes 2D sample (u,v) in [0,1) x [0,1) for sample number n of the specified
+  /// sampling dimension, with the pattern decorrelated via seed. Sample numbers can
+  /// be >= NSamples() (e.g., several light samples per subsample). Default is
+  /// offset + 0.5 for the pixel dimension and Owen-scrambled Sobol' points for
+  /// all others.
+  virtual void GetSample2D( const int n, const int dimension, const uint32_t seed, 
+  							float *u, float *v ) const;
+
+  /// Total number of subsamples per pixel
+  int NSamples( ) const { return nSamples2D; };
+
 //protected:
   int nSamples1D, nSamples2D;
   float *xOffsets, *yOffsets;
@@ -3,7 +3,10 @@
 
 #include <vector>
 #include <memory>
+#include <string>
+#include <algorithm>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "definitions.h"
 #include "geometry.h"
@@ -14,6 +17,7 @@
 #include "materials.h"
 #include "cameras.h"
 #include "environment_map.h"
+#include "light_bvh.h"
 
 using namespace std;
 
@@ -29,6 +33,8 @@ public:
   map<string, shared_ptr<Material>> materials;
   shared_ptr<Camera> camera;
   shared_ptr<Environment> environment;
+  unique_ptr<LightBVH> lightBVH;  // only used if nLightSamples > 0
+  int  nLightSamples = 0;  // number of lights to sample per shading point (0 = all)
   float  defaultIOR;  // default index of refraction for scene
   Transform *transformPtr;  // replace with vector<Transform *> later...
   
@@ -223,6 +229,14 @@ public:
   }
 
 
+  void AddEnvironmentLight( const float luminosity, const int nSamples )
+  {
+    shared_ptr<Light> lightPtr = make_shared<EnvironmentLight>(environment, luminosity, nSamples);
+    lightPtr->AddTransform(transformPtr);
+    lights.push_back(lightPtr);
+  }
+
+
   void AddRectLight( const Point &pos, const float xSize, const float zSize, 
   						const Color &color, const float luminosity, const int nSamples )
   {
@@ -270,6 +284,155 @@ public:
     return camera;
   }
 
+
+  // Sample only nSamples lights (chosen from a light hierarchy) at each
+  // shading point, instead of all lights; 0 = use all lights
+  void SetLightSampling( int nSamples )
+  {
+    nLightSamples = nSamples;
+  }
+
+
+  // Gives each light with distance falloff a finite range, beyond which its
+  // contribution would be < cutoff (see Light::SetContributionCutoff); 0 = no cutoff.
+  // Must be called before PrepareForRender.
+  void SetLightCutoff( float cutoff )
+  {
+    if (cutoff <= 0.0)
+      return;
+    for (auto &light : lights)
+      light->SetContributionCutoff(cutoff);
+  }
+
+
+  // List of indices of the shapes which can cast shadows from light i (i.e., which
+  // overlap the light's sphere of influence, aren't entirely behind a one-sided
+  // light, and aren't flagged as non-shadowing); NULL means all shapes can
+  const vector<int> * ShadowCasters( int i ) const
+  {
+    if (hasShadowCasterList[i])
+      return &shadowCasters[i];
+    return NULL;
+  }
+
+
+  // Builds the per-light shadow-caster lists. A shadow ray runs from a point the
+  // light affects (inside its sphere of influence) to a point on the light (also
+  // inside the sphere), so only shapes overlapping the sphere can block it.
+  // (Lights only have a finite sphere of influence if something, such as a
+  // contribution cutoff, sets their influenceRadius.) Similarly, shadow rays to a
+  // one-sided (rect) light lie entirely in front of its plane, so shapes entirely
+  // behind the plane can't block them.
+  // Shapes with castsShadows = false are left out of all the lists. For lights
+  // with unlimited influence which emit in all directions (including distant and
+  // environment lights, which shine on the whole scene), only those shapes are
+  // left out. Lights whose list would include every shape have no list. Unbounded
+  // shapes are always included.
+  void BuildShadowCasterLists( )
+  {
+    Point  lightCenter, shapeCenter, planePoint;
+    Vector  planeNormal;
+    float  lightRadius, shapeRadius;
+
+    shadowCasters.assign(lights.size(), vector<int>());
+    hasShadowCasterList.assign(lights.size(), false);
+    for (int i = 0; i < (int)lights.size(); i++) {
+      bool  limitedInfluence = lights[i]->GetInfluenceSphere(lightCenter, lightRadius);
+      bool  oneSided = lights[i]->GetEmissionPlane(planePoint, planeNormal);
+      for (int j = 0; j < (int)shapes.size(); j++) {
+        if (! shapes[j]->castsShadows)
+          continue;
+        if (shapes[j]->GetBoundingSphere(shapeCenter, shapeRadius)) {
+          float  maxDist = lightRadius + shapeRadius;
+          if (limitedInfluence && ((shapeCenter - lightCenter).LengthSquared() > maxDist*maxDist))
+            continue;
+          if (oneSided && (Dot(shapeCenter - planePoint, planeNormal) < -shapeRadius))
+            continue;
+        }
+        shadowCasters[i].push_back(j);
+      }
+      hasShadowCasterList[i] = (shadowCasters[i].size() < shapes.size());
+      if (! hasShadowCasterList[i])
+        shadowCasters[i].clear();
+    }
+  }
+
+
+  // List of indices of the lights which illuminate shape j (see BuildLightLinks);
+  // NULL means all lights do
+  const vector<int> * LightsForShape( int j ) const
+  {
+    if (lightLinksPresent)
+      return &lightsForShapes[j];
+    return NULL;
+  }
+
+  // True if light i illuminates shape j
+  bool LightIlluminatesShape( int i, int j ) const
+  {
+    return (! lightLinksPresent) || illuminatedShapes[i][j];
+  }
+
+
+  // Resolves light linking: a light with a list of shape names illuminates only
+  // shapes with one of those names; lights without such a list illuminate all shapes.
+  void BuildLightLinks( )
+  {
+    lightLinksPresent = false;
+    for (auto &light : lights) {
+      if (light->linkedShapeNames.size() > 0)
+        lightLinksPresent = true;
+    }
+    if (! lightLinksPresent)
+      return;
+    
+    illuminatedShapes.assign(lights.size(), vector<bool>(shapes.size(), true));
+    lightsForShapes.assign(shapes.size(), vector<int>());
+    for (int i = 0; i < (int)lights.size(); i++) {
+      const vector<string> &linkedNames = lights[i]->linkedShapeNames;
+      for (int j = 0; j < (int)shapes.size(); j++) {
+        if (linkedNames.size() > 0)
+          illuminatedShapes[i][j] = (find(linkedNames.begin(), linkedNames.end(), 
+          								shapes[j]->name) != linkedNames.end());
+        if (illuminatedShapes[i][j])
+          lightsForShapes[j].push_back(i);
+      }
+    }
+  }
+
+
+  // Final setup before rendering. Environment images are decoded in background
+  // tasks that were started while the scene file was being parsed; any
+  // geometry-side preprocessing should go *before* the wait, so that it
+  // overlaps with the image decoding. Safe to call more than once.
+  void PrepareForRender( )
+  {
+    if (preparedForRender)
+      return;
+    if (nLightSamples > 0)
+      lightBVH = make_unique<LightBVH>(lights);
+    BuildShadowCasterLists();
+    BuildLightLinks();
+    if (! environment->WaitForImages()) {
+      fprintf(stderr, "Exiting...\n\n");
+      exit(1);
+    }
+    // environment lights sample the (now available) environment images
+    for (auto &light : lights) {
+      if (light->GetType() == LIGHT_ENVIRONMENT)
+        static_pointer_cast<EnvironmentLight>(light)->BuildDistribution();
+    }
+    preparedForRender = true;
+  }
+
+private:
+  bool  preparedForRender = false;
+  vector<vector<int>>  shadowCasters;   // see BuildShadowCasterLists()
+  vector<bool>  hasShadowCasterList;
+  bool  lightLinksPresent = false;
+  vector<vector<bool>>  illuminatedShapes;   // [light][shape]; see BuildLightLinks()
+  vector<vector<int>>  lightsForShapes;
+
 };
 
 
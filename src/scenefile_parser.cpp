@@ -43,6 +43,49 @@ bool IsValidMaterialName( const string &name, const vector<string> &validMateria
 
 
 
+// Reads the optional attributes which any shape can have:
+//         name: table    [several shapes can share a name; used for light linking]
+//         cast_shadows: false    [any YAML boolean: true/false, yes/no, on/off]
+void SetShapeAttributes( YAML::Node objNode, shared_ptr<Shape> shape, const int debugLevel )
+{
+  if (objNode["name"]) {
+    shape->name = objNode["name"].as<string>();
+    if (debugLevel > 1)
+      printf("      name = %s\n", shape->name.c_str());
+  }
+  if (objNode["cast_shadows"]) {
+    shape->castsShadows = objNode["cast_shadows"].as<bool>();
+    if ((debugLevel > 1) && (! shape->castsShadows))
+      printf("      shape does not cast shadows\n");
+  }
+}
+
+
+// Light linking: each shape name a light is linked to must belong to at least
+// one shape
+bool CheckLightLinks( shared_ptr<Scene> theScene )
+{
+  bool  allOK = true;
+  for (int i = 0; i < (int)theScene->lights.size(); ++i) {
+    for (const string &linkedName : theScene->lights[i]->linkedShapeNames) {
+      bool  nameFound = false;
+      for (auto &shape : theScene->shapes) {
+        if (shape->name == linkedName)
+          nameFound = true;
+      }
+      if (! nameFound) {
+        fprintf(stderr, "** ERROR in LoadSceneFromFile: Light #%d is linked to", i);
+        fprintf(stderr, " shape name \"%s\", which was not defined in scene file!\n",
+        		linkedName.c_str());
+        allOK = false;
+      }
+    }
+  }
+  return allOK;
+}
+
+
+
 float GetFileVersion( const string &sceneFilename )
 {
   float  versionNum = -1.0;
@@ -76,6 +119,7 @@ void AddSphereToScene( YAML::Node sphereNode, shared_ptr<Scene> theScene, const
   }
   
   newSphere = make_shared<Sphere>(Point(x,y,z), radius);
+  SetShapeAttributes(sphereNode, newSphere, debugLevel);
   theScene->AddShape(newSphere, transformPtr, materialName);
 }
 
@@ -154,6 +198,7 @@ void AddBoxToScene( YAML::Node boxNode, shared_ptr<Scene> theScene, const int de
   
   newBox = make_shared<Box>(Point(x1_obj,y1_obj,z1_obj), Point(x2_obj,y2_obj,z2_obj));
 //   newBox = make_shared<Box>(Point(x1,y1,z1), Point(x2,y2,z2));
+  SetShapeAttributes(boxNode, newBox, debugLevel);
   theScene->AddShape(newBox, transformPtr, materialName);
 }
 
@@ -184,6 +229,7 @@ void AddPlaneToScene( YAML::Node objNode, shared_ptr<Scene> theScene, const int
   }
 
   theScene->AddPlane(Point(x,y,z), Vector(n_x,n_y,n_z));
+  SetShapeAttributes(objNode, theScene->shapes.back(), debugLevel);
 }
 
 
@@ -192,10 +238,13 @@ void AddPlaneToScene( YAML::Node objNode, shared_ptr<Scene> theScene, const int
 //         position: [0.0, 20.0, -30.0]
 //         luminosity: 3.0
 //         color: [0.1, 0.1, 0.1]
+//         illuminates: [hero, table]   [optional: name or list of names of shapes
+//                                        the light is restricted to]
 
 void AddLightToScene( YAML::Node objNode, shared_ptr<Scene> theScene, const int debugLevel )
 {
   float  x, y, z, r, g, b, lum, radius;
+  int  nLightsBefore = (int)theScene->lights.size();
 
   string lightType = objNode["type"].as<string>();
   if (lightType == "point") {
@@ -279,9 +328,35 @@ void AddLightToScene( YAML::Node objNode, shared_ptr<Scene> theScene, const int
       printf("      rect light color = %f, %f, %f\n", r,g,b);
     theScene->AddRectLight(Point(x,y,z), xSize, zSize, Color(r,g,b), lum, nsamp);
   }
+  else if (lightType == "environment") {
+    // illumination from the scene background (map or constant color)
+    lum = 1.0;
+    int nsamp = 1;
+    if (objNode["luminosity"])
+      lum = objNode["luminosity"].as<float>();
+    if (objNode["nsamples"])
+      nsamp = objNode["nsamples"].as<int>();
+    if (debugLevel > 1)
+      printf("   environment light with luminosity = %f, nsamples = %d\n", lum, nsamp);
+    theScene->AddEnvironmentLight(lum, nsamp);
+  }
   else
     fprintf(stderr, "ERROR in AddLightToScene: Unrecognized light type (\"%s\")!\n",
     		lightType.c_str());
+  
+  // light linking
+  if ( (objNode["illuminates"]) && ((int)theScene->lights.size() > nLightsBefore) ) {
+    YAML::Node linkNode = objNode["illuminates"];
+    vector<string> &linkedNames = theScene->lights.back()->linkedShapeNames;
+    if (linkNode.IsSequence()) {
+      for (int i = 0; i < (int)linkNode.size(); ++i)
+        linkedNames.push_back(linkNode[i].as<string>());
+    }
+    else
+      linkedNames.push_back(linkNode.as<string>());
+    if (debugLevel > 1)
+      printf("      light is linked to %d shape name(s)\n", (int)linkedNames.size());
+  }
 }
 
 
@@ -436,6 +511,10 @@ void AddCameraToScene( YAML::Node objNode, shared_ptr<Scene> theScene, const int
   }
   if (objNode["n_blades"]) {
     nBlades = objNode["n_blades"].as<int>();
+    if (nBlades < 3) {
+      fprintf(stderr, "ERROR in AddCameraToScene: n_blades must be >= 3 (was %d)!\n", nBlades);
+      exit(1);
+    }
   }
   if (objNode["rotation"]) {
     apertureRotation = objNode["rotation"].as<float>();
@@ -497,6 +576,10 @@ shared_ptr<Scene> LoadSceneFromFile( const string &sceneFilename, const int debu
 		theScene->shapes[i]->SetMaterial(thisMaterial);
 	  } 
 	}
+	if (! CheckLightLinks(theScene)) {
+	  fprintf(stderr, "Exiting...\n\n");
+	  exit(1);
+	}
   }
   
   return theScene;
@@ -9,6 +9,10 @@ bool VetSceneFile( const std::string &sceneFilename );
 
 float GetFileVersion( const std::string &sceneFilename );
 
+void SetShapeAttributes( YAML::Node objNode, shared_ptr<Shape> shape, const int debugLevel=0 );
+
+bool CheckLightLinks( shared_ptr<Scene> theScene );
+
 void AddSphereToScene( YAML::Node sphereNode, shared_ptr<Scene> theScene, const int debugLevel=1 );
 
 void AddBoxToScene( YAML::Node objNode, shared_ptr<Scene> theScene, const int debugLevel=1 );
@@ -3,6 +3,7 @@
 #include <utility>  // for swap()
 #include <optional>
 
+#include "definitions.h"
 #include "geometry.h"
 #include "shapes.h"
 #include "render_utils.h"
@@ -211,3 +212,34 @@ std::optional<intersectionResult> Rectangle::intersect( const Point &rayorig, co
     return { };
 }
 
+
+
+int NearestIntersection( const std::vector<std::shared_ptr<Shape>> &shapes, 
+						const Point &rayorig, const Vector &raydir, float *t_nearest )
+{
+  int  nearestIndex = -1;
+  *t_nearest = kInfinity;
+  for (int i = 0; i < (int)shapes.size(); ++i) {
+    if (auto result = shapes[i]->intersect(rayorig, raydir); result) {
+      intersectionResult  intersection = result.value();
+      if (intersection.t_0 < 0)  // first intersection is *behind* ray origin, so use the second
+        intersection.t_0 = intersection.t_1;
+      if (intersection.t_0 < *t_nearest) {
+        *t_nearest = intersection.t_0;
+        nearestIndex = i;
+      }
+    }
+  }
+  return nearestIndex;
+}
+
+
+bool AnyIntersection( const std::vector<std::shared_ptr<Shape>> &shapes, 
+						const Point &rayorig, const Vector &raydir )
+{
+  for (int i = 0; i < (int)shapes.size(); ++i) {
+    if (shapes[i]->intersect(rayorig, raydir))
+      return true;
+  }
+  return false;
+}
@@ -2,7 +2,10 @@
 #define _SHAPES_H_
 
 #include <stdio.h>
+#include <string>
 #include <optional>
+#include <vector>
+#include <memory>
 #include "geometry.h"
 #include "transform.h"
 #include "color.h"
@@ -38,6 +41,15 @@ public:
   
   virtual Vector GetNormalAtPoint( const Point &hitPoint ) const = 0;
 
+  // Returns surface curvature (1/radius of curvature) at the point; used to widen
+  // ray cones on reflection. Flat surfaces return 0. (Like the bounding spheres
+  // below, this assumes the shape's transform is rigid; a scaling transform would
+  // change the curvature, which would then have to be divided by the scale.)
+  virtual float GetCurvature( const Point & ) const
+  {
+    return 0.0;
+  }
+
   virtual void SetMaterial( shared_ptr<Material> material )
   {
     shapeMaterial = material;
@@ -49,6 +61,25 @@ public:
     return shapeMaterial;
   }
 
+  // Sets center and radius of a sphere (in world coordinates) which encloses the
+  // shape; returns false if the shape is unbounded (or its extent is unknown).
+  // (Shape transforms are rigid -- translations and rotations -- so only the
+  // center needs to be transformed.)
+  virtual bool GetBoundingSphere( Point &, float & ) const
+  {
+    return false;
+  }
+
+  // Sets center and radius of a sphere (in world coordinates) which is entirely
+  // inside the (solid) shape; returns false if there is no such sphere
+  virtual bool GetInscribedSphere( Point &, float & ) const
+  {
+    return false;
+  }
+
+  // data members
+  string  name;   // optional; several shapes can share the same name (used for light linking)
+  bool  castsShadows = true;   // false = shape is ignored by shadow rays
   
 protected:
   bool  materialPresent = false;
@@ -86,6 +117,24 @@ public:
     return hitPoint - center;
   };
 
+  // (radius is in object coordinates, which have the same scale as world
+  // coordinates for the rigid transforms we support)
+  float GetCurvature( const Point & ) const
+  {
+    return 1.0 / radius;
+  };
+
+  bool GetBoundingSphere( Point &sphereCenter, float &sphereRadius ) const
+  {
+    sphereCenter = transformPresent ? WorldToObject->InverseTransform(center) : center;
+    sphereRadius = radius;
+    return true;
+  };
+
+  bool GetInscribedSphere( Point &sphereCenter, float &sphereRadius ) const
+  {
+    return GetBoundingSphere(sphereCenter, sphereRadius);
+  };
 
 }; 
 
@@ -115,6 +164,23 @@ public:
 
   Vector GetNormalAtPoint( const Point &hitPoint ) const;
 
+  bool GetBoundingSphere( Point &sphereCenter, float &sphereRadius ) const
+  {
+    Point  boxCenter = lowerCorner + 0.5*(upperCorner - lowerCorner);
+    sphereCenter = transformPresent ? WorldToObject->InverseTransform(boxCenter) : boxCenter;
+    sphereRadius = 0.5*(upperCorner - lowerCorner).Length();
+    return true;
+  };
+
+  bool GetInscribedSphere( Point &sphereCenter, float &sphereRadius ) const
+  {
+    Vector  size = upperCorner - lowerCorner;
+    Point  boxCenter = lowerCorner + 0.5*size;
+    sphereCenter = transformPresent ? WorldToObject->InverseTransform(boxCenter) : boxCenter;
+    sphereRadius = 0.5*fminf(size.x, fminf(size.y, size.z));
+    return true;
+  };
+
 };
 
 
@@ -181,4 +247,15 @@ public:
 }; 
 
 
+/// Returns the index of the nearest shape intersected by the ray (or -1 if there is
+/// none), and stores the distance along the ray to the intersection in t_nearest
+int NearestIntersection( const std::vector<std::shared_ptr<Shape>> &shapes, 
+						const Point &rayorig, const Vector &raydir, float *t_nearest );
+
+/// Returns true if the ray intersects any of the shapes (cheaper than
+/// NearestIntersection, since we can stop at the first intersection found)
+bool AnyIntersection( const std::vector<std::shared_ptr<Shape>> &shapes, 
+						const Point &rayorig, const Vector &raydir );
+
+
 #endif  // _SHAPES_H_
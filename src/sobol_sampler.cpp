@@ -0,0 +1,50 @@
+// Sampler which generates subsample positions from a 2D Sobol' sequence, with
+// nested uniform (Owen) scrambling. Each sampling dimension is scrambled (and
+// has its point order shuffled) with its own seed, so that the dimensions are
+// decorrelated while each remains well stratified -- the first 2^k points
+// of any dimension have exactly one point in every elementary interval of
+// area 1/2^k.
+
+#include <assert.h>
+#include <math.h>
+#include "sampler.h"
+#include "sobol_sampler.h"
+#include "low_discrepancy.h"
+
+
+SobolSampler::SobolSampler( const int nSamples )
+{
+  nSamples2D = nSamples;
+  nSamples1D = (int)ceil(sqrt((double)nSamples));
+  offsetsAllocated = false;
+}
+
+
+SobolSampler::~SobolSampler( )
+{
+  ;
+}
+
+
+void SobolSampler::GetOffsetCoords( const int n, float *xOffset, float *yOffset ) const
+{
+  GetOffsetCoords(n, 0, xOffset, yOffset);
+}
+
+
+void SobolSampler::GetOffsetCoords( const int n, const uint32_t pixelSeed, float *xOffset, 
+									float *yOffset ) const
+{
+  assert ((n >= 0) && (n < nSamples2D));
+
+  GetSample2D(n, SAMPLE_DIMENSION_PIXEL, pixelSeed, xOffset, yOffset);
+  *xOffset -= 0.5;
+  *yOffset -= 0.5;
+}
+
+
+void SobolSampler::GetSample2D( const int n, const int dimension, const uint32_t seed, 
+								float *u, float *v ) const
+{
+  SobolOwen2D(n, HashCombine(seed, dimension), u, v);
+}
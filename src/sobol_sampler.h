@@ -0,0 +1,35 @@
+// Header file for Sampler subclass which uses (Owen-scrambled) Sobol' points
+// for subsamples within each pixel.
+
+#ifndef _SOBOL_SAMPLER_H_
+#define _SOBOL_SAMPLER_H_
+
+#include "sampler.h"
+
+
+class SobolSampler : public Sampler
+{ 
+public:
+
+  /// nSamples = total number of subsamples per pixel (need not be a square;
+  /// powers of 2 are best)
+  SobolSampler( const int nSamples=1 );
+  ~SobolSampler( );
+
+  using Sampler::GetOffsetCoords;
+
+  /// Computes offset in x and y xOffset, yOffset for sample number n (unscrambled pattern)
+  void GetOffsetCoords( const int n, float *xOffset, float *yOffset ) const;
+
+  /// Computes offset in x and y xOffset, yOffset for sample number n, with the
+  /// pattern scrambled by pixelSeed
+  void GetOffsetCoords( const int n, const uint32_t pixelSeed, float *xOffset, 
+  						float *yOffset ) const;
+
+  /// Computes 2D sample (u,v) for sample number n of the specified sampling dimension
+  void GetSample2D( const int n, const int dimension, const uint32_t seed, 
+  					float *u, float *v ) const;
+}; 
+
+
+#endif  // _SOBOL_SAMPLER_H_
@@ -0,0 +1,230 @@
+// Code for reading and writing preprocessed (tiled, mip-mapped) texture files
+//
+// FILE LAYOUT:
+//    textureFileHeader (padded to a multiple of the page size)
+//    level 0 tiles, level 1 tiles, ... (each level starts on a page boundary)
+// Within a level, tile (tx,ty) starts at levelOffset + (ty*nTilesX + tx)*tileBytes,
+// and texel (x,y) within the tile is at ((y*tileSize) + x)*texelSize. Keeping
+// whole tiles contiguous means that a lookup only faults in the pages for the
+// tiles it touches when the file is memory-mapped (see MipMap::OpenTextureFile).
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "color.h"
+#include "mipmap.h"
+#include "texture_file.h"
+
+const char  TEXTURE_FILE_MAGIC[8] = {'P','T','X','T','E','X','1','\0'};
+const int64_t  FILE_ALIGNMENT = 4096;
+
+
+// IEEE half-precision conversions (round-to-nearest-even; values too large for
+// a half become infinity, tiny values flush through denormals to zero)
+uint16_t FloatToHalf( float value )
+{
+  uint32_t  bits;
+  memcpy(&bits, &value, sizeof(bits));
+  uint16_t  sign = (bits >> 16) & 0x8000;
+  int32_t  exponent = (int32_t)((bits >> 23) & 0xff) - 127 + 15;
+  uint32_t  mantissa = bits & 0x7fffff;
+
+  if (((bits >> 23) & 0xff) == 0xff)   // infinity or NaN
+    return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+  if (exponent >= 31)   // overflow --> infinity
+    return sign | 0x7c00;
+  if (exponent <= 0) {   // denormal or zero
+    if (exponent < -10)
+      return sign;
+    mantissa |= 0x800000;
+    int  shift = 14 - exponent;
+    uint32_t  halfMantissa = mantissa >> shift;
+    uint32_t  remainder = mantissa & ((1u << shift) - 1);
+    uint32_t  halfway = 1u << (shift - 1);
+    if ((remainder > halfway) || ((remainder == halfway) && (halfMantissa & 1)))
+      halfMantissa++;
+    return sign | halfMantissa;
+  }
+  uint32_t  halfBits = ((uint32_t)exponent << 10) | (mantissa >> 13);
+  uint32_t  remainder = mantissa & 0x1fff;
+  if ((remainder > 0x1000) || ((remainder == 0x1000) && (halfBits & 1)))
+    halfBits++;   // may carry into the exponent, which is still correct
+  return sign | (uint16_t)halfBits;
+}
+
+
+float HalfToFloat( uint16_t halfBits )
+{
+  uint32_t  sign = (uint32_t)(halfBits & 0x8000) << 16;
+  uint32_t  exponent = (halfBits >> 10) & 0x1f;
+  uint32_t  mantissa = halfBits & 0x3ff;
+  uint32_t  bits;
+
+  if (exponent == 0) {
+    if (mantissa == 0)
+      bits = sign;
+    else {   // denormal: renormalize
+      exponent = 127 - 15 + 1;
+      while ((mantissa & 0x400) == 0) {
+        mantissa <<= 1;
+        exponent--;
+      }
+      bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+    }
+  }
+  else if (exponent == 31)
+    bits = sign | 0x7f800000 | (mantissa << 13);
+  else
+    bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+  float  value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+
+int64_t AlignOffset( int64_t offset )
+{
+  return ((offset + FILE_ALIGNMENT - 1) / FILE_ALIGNMENT) * FILE_ALIGNMENT;
+}
+
+
+bool IsTextureFile( const std::string &filename )
+{
+  size_t nChars = filename.size();
+  size_t nExt = TEXTURE_FILE_EXTENSION.size();
+  return ((nChars > nExt) && (filename.compare(nChars - nExt, nExt, TEXTURE_FILE_EXTENSION) == 0));
+}
+
+
+int TexelSize( int encoding )
+{
+  if (encoding == TEXEL_HALF)
+    return 8;
+  return 4;
+}
+
+
+// RGBE encoding follows Greg Ward's original Radiance code: the three channels
+// share the exponent of the largest channel (negative values are clamped to 0)
+void EncodeTexel( const Color &c, int encoding, unsigned char *texel )
+{
+  float r = fmaxf(c.r, 0.0f);
+  float g = fmaxf(c.g, 0.0f);
+  float b = fmaxf(c.b, 0.0f);
+
+  if (encoding == TEXEL_HALF) {
+    uint16_t  halfTexel[4];
+    halfTexel[0] = FloatToHalf(r);
+    halfTexel[1] = FloatToHalf(g);
+    halfTexel[2] = FloatToHalf(b);
+    halfTexel[3] = 0;
+    memcpy(texel, halfTexel, sizeof(halfTexel));
+    return;
+  }
+
+  float maxValue = fmaxf(r, fmaxf(g, b));
+  if (maxValue < 1.0e-32) {
+    texel[0] = texel[1] = texel[2] = texel[3] = 0;
+  }
+  else {
+    int  exponent;
+    float scale = frexpf(maxValue, &exponent) * 256.0f / maxValue;
+    texel[0] = (unsigned char)(r * scale);
+    texel[1] = (unsigned char)(g * scale);
+    texel[2] = (unsigned char)(b * scale);
+    texel[3] = (unsigned char)(exponent + 128);
+  }
+}
+
+
+Color DecodeTexel( const unsigned char *texel, int encoding )
+{
+  if (encoding == TEXEL_HALF) {
+    uint16_t  halfTexel[4];
+    memcpy(halfTexel, texel, sizeof(halfTexel));
+    return Color(HalfToFloat(halfTexel[0]), HalfToFloat(halfTexel[1]), HalfToFloat(halfTexel[2]));
+  }
+
+  if (texel[3] == 0)
+    return Color(0);
+  float scale = ldexpf(1.0f, (int)texel[3] - (128 + 8));
+  return Color(texel[0]*scale, texel[1]*scale, texel[2]*scale);
+}
+
+
+
+bool WriteTextureFile( const std::string &filename, const MipMap &mipmap,
+						int encoding, int tileSize )
+{
+  textureFileHeader  header;
+  int  nLevels = mipmap.NLevels();
+  int  texelSize = TexelSize(encoding);
+  int64_t  tileBytes = (int64_t)tileSize*tileSize*texelSize;
+
+  if (nLevels > 32) {
+    fprintf(stderr, "ERROR in WriteTextureFile: too many mip-map levels (%d)!\n", nLevels);
+    return false;
+  }
+  // a mip-map opened from a texture file has no in-memory texels to write out
+  for (int n = 0; n < nLevels; n++) {
+    if (mipmap.Texels(n) == NULL) {
+      fprintf(stderr, "ERROR in WriteTextureFile: mip-map level %d has no in-memory texels!\n", n);
+      return false;
+    }
+  }
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, TEXTURE_FILE_MAGIC, sizeof(header.magic));
+  header.encoding = encoding;
+  header.tileSize = tileSize;
+  header.nLevels = nLevels;
+  header.wrapMode = mipmap.WrapMode();
+  int64_t  offset = AlignOffset(sizeof(header));
+  for (int n = 0; n < nLevels; n++) {
+    int  nTilesX = (mipmap.Width(n) + tileSize - 1) / tileSize;
+    int  nTilesY = (mipmap.Height(n) + tileSize - 1) / tileSize;
+    header.levelWidths[n] = mipmap.Width(n);
+    header.levelHeights[n] = mipmap.Height(n);
+    header.levelOffsets[n] = offset;
+    offset = AlignOffset(offset + nTilesX*nTilesY*tileBytes);
+  }
+
+  FILE *outFile = fopen(filename.c_str(), "wb");
+  if (outFile == NULL) {
+    fprintf(stderr, "ERROR in WriteTextureFile: unable to open \"%s\" for writing!\n",
+    		filename.c_str());
+    return false;
+  }
+  bool  okay = (fwrite(&header, sizeof(header), 1, outFile) == 1);
+
+  std::vector<unsigned char>  tile(tileBytes);
+  for (int n = 0; (n < nLevels) && okay; n++) {
+    int  width = mipmap.Width(n);
+    int  height = mipmap.Height(n);
+    const Color *texels = mipmap.Texels(n);
+    int  nTilesX = (width + tileSize - 1) / tileSize;
+    int  nTilesY = (height + tileSize - 1) / tileSize;
+    fseek(outFile, header.levelOffsets[n], SEEK_SET);
+    for (int ty = 0; ty < nTilesY; ty++) {
+      for (int tx = 0; tx < nTilesX; tx++) {
+        // padding texels (beyond the image edge) replicate the edge texels
+        for (int j = 0; j < tileSize; j++) {
+          int  y = std::min(ty*tileSize + j, height - 1);
+          for (int i = 0; i < tileSize; i++) {
+            int  x = std::min(tx*tileSize + i, width - 1);
+            EncodeTexel(texels[y*width + x], encoding, &tile[(j*tileSize + i)*texelSize]);
+          }
+        }
+        okay = okay && (fwrite(tile.data(), tileBytes, 1, outFile) == 1);
+      }
+    }
+  }
+  fclose(outFile);
+
+  if (! okay)
+    fprintf(stderr, "ERROR in WriteTextureFile: unable to write \"%s\"!\n", filename.c_str());
+  return okay;
+}
@@ -0,0 +1,60 @@
+// Code for reading and writing preprocessed texture files: tiled, mip-mapped
+// images with compact (RGBE or half-float) texels, intended to be memory-mapped
+// so that only the tiles actually touched during rendering are read from disk.
+// (Files are produced by the "maketex" program.)
+
+#ifndef _TEXTURE_FILE_H_
+#define _TEXTURE_FILE_H_
+
+#include <string>
+#include <stdint.h>
+#include "color.h"
+#include "mipmap.h"
+
+const std::string  TEXTURE_FILE_EXTENSION = ".ptx";
+
+// texel encodings
+const int  TEXEL_RGBE = 0;   // shared-exponent RGB, 4 bytes/texel
+const int  TEXEL_HALF = 1;   // half-float RGB (+ padding), 8 bytes/texel
+
+const int  DEFAULT_TILE_SIZE = 64;
+const int  MAX_TILE_SIZE = 4096;
+
+
+/// Header at the start of a texture file. Each level's tiles are stored in
+/// row-major order starting at levelOffsets[n]; each tile is always
+/// tileSize x tileSize texels (edge tiles are padded). wrapMode is the mode
+/// the pyramid was built with (MIPMAP_CLAMP or MIPMAP_WRAP_U).
+typedef struct {
+  char  magic[8];
+  int32_t  encoding;
+  int32_t  tileSize;
+  int32_t  nLevels;
+  int32_t  wrapMode;
+  int32_t  levelWidths[32];
+  int32_t  levelHeights[32];
+  int64_t  levelOffsets[32];
+} textureFileHeader;
+
+
+/// Returns true if the filename has the texture-file extension
+bool IsTextureFile( const std::string &filename );
+
+uint16_t FloatToHalf( float value );
+
+float HalfToFloat( uint16_t halfBits );
+
+/// Size of a single encoded texel (in bytes)
+int TexelSize( int encoding );
+
+void EncodeTexel( const Color &c, int encoding, unsigned char *texel );
+
+Color DecodeTexel( const unsigned char *texel, int encoding );
+
+/// Writes the full image pyramid of mipmap to a tiled texture file; returns
+/// true on success
+bool WriteTextureFile( const std::string &filename, const MipMap &mipmap,
+						int encoding=TEXEL_RGBE, int tileSize=DEFAULT_TILE_SIZE );
+
+
+#endif  // _TEXTURE_FILE_H_
@@ -0,0 +1,119 @@
+// Code for per-screen-tile light lists.
+//
+// A pre-pass traces a sparse grid of camera rays through each tile (including
+// its corners and edges, where the depth extremes of smooth surfaces occur) and
+// records the range of first-hit depths. Any surface point seen in the tile with
+// a depth inside that range lies inside the part of the tile's view frustum
+// between two planes of constant depth; this is a convex polyhedron whose corners
+// are the four corner rays of the tile at the minimum and maximum depths, so it
+// lies inside the bounding box of those eight points. Each light whose sphere of
+// influence overlaps the box is added to the tile's list.
+//
+// Surfaces seen by other camera rays in the tile (e.g., rays which hit a small
+// object that the grid missed) may lie outside the depth range; the caller has
+// to check for this and use all the lights in that case. So the grid only
+// affects how often the lists can be used, not the rendered image.
+
+#include <math.h>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+#include "definitions.h"
+#include "geometry.h"
+#include "shapes.h"
+#include "lights.h"
+#include "cameras.h"
+#include "tile_lights.h"
+
+// number of intervals along each side of a tile for the depth pre-pass grid
+// (4 => 25 rays per 16x16 tile)
+const int  DEPTH_GRID_STEPS = 4;
+
+
+bool SphereOverlapsBox( const Point &center, float radius, const Point &boxMin,
+						const Point &boxMax )
+{
+  float  distSquared = 0.0;
+  for (int i = 0; i < 3; i++) {
+    if (center[i] < boxMin[i])
+      distSquared += (boxMin[i] - center[i])*(boxMin[i] - center[i]);
+    else if (center[i] > boxMax[i])
+      distSquared += (center[i] - boxMax[i])*(center[i] - boxMax[i]);
+  }
+  return (distSquared <= radius*radius);
+}
+
+
+const vector<int> * TileLightsForDepth( const vector<int> *tileLights, float depthMin,
+										float depthMax, float hitDepth )
+{
+  if ((hitDepth < depthMin) || (hitDepth > depthMax))
+    return NULL;
+  return tileLights;
+}
+
+
+// Returns the depth (distance along -z) of the nearest intersection of a camera
+// ray (starting at the origin) with any shape, or -1 if there is none
+float FirstHitDepth( const Ray &cameraRay, const vector<shared_ptr<Shape>> &shapes )
+{
+  float  t_nearest;
+  if (NearestIntersection(shapes, cameraRay.o, cameraRay.dir, &t_nearest) < 0)
+    return -1.0;
+  return -(cameraRay.dir.z * t_nearest);
+}
+
+
+TileLightLists::TileLightLists( const Camera &camera, int width, int height,
+								const vector<shared_ptr<Shape>> &shapes,
+								const vector<shared_ptr<Light>> &lights )
+{
+  nTilesX = (width + RENDER_TILE_SIZE - 1) / RENDER_TILE_SIZE;
+  nTilesY = (height + RENDER_TILE_SIZE - 1) / RENDER_TILE_SIZE;
+  int  nTiles = nTilesX*nTilesY;
+  depthMin.assign(nTiles, kInfinity);
+  depthMax.assign(nTiles, -kInfinity);
+  tileLights.assign(nTiles, vector<int>());
+
+  #pragma omp parallel for schedule(dynamic)
+  for (int tile = 0; tile < nTiles; tile++) {
+    int  x0 = (tile % nTilesX)*RENDER_TILE_SIZE;
+    int  y0 = (tile / nTilesX)*RENDER_TILE_SIZE;
+    int  x1 = std::min(x0 + RENDER_TILE_SIZE, width);
+    int  y1 = std::min(y0 + RENDER_TILE_SIZE, height);
+    for (int j = 0; j <= DEPTH_GRID_STEPS; j++) {
+      for (int i = 0; i <= DEPTH_GRID_STEPS; i++) {
+        float  x = x0 + (x1 - x0)*i/(float)DEPTH_GRID_STEPS;
+        float  y = y0 + (y1 - y0)*j/(float)DEPTH_GRID_STEPS;
+        Vector  dir = camera.ImagePlaneDirection(x, y);
+        float  depth = FirstHitDepth(Ray(Point(0), dir), shapes);
+        if (depth >= 0.0) {
+          depthMin[tile] = fminf(depthMin[tile], depth);
+          depthMax[tile] = fmaxf(depthMax[tile], depth);
+        }
+      }
+    }
+    if (depthMin[tile] > depthMax[tile])   // nothing to light in this tile
+      continue;
+
+    // bounding box of the tile's frustum between depthMin and depthMax (the
+    // image-plane directions have z = -1, so a direction times depth is the point
+    // at that depth)
+    Point  boxMin(kInfinity, kInfinity, kInfinity);
+    Point  boxMax(-kInfinity, -kInfinity, -kInfinity);
+    for (int corner = 0; corner < 8; corner++) {
+      Vector  dir = camera.ImagePlaneDirection((corner & 1) ? x1 : x0, (corner & 2) ? y1 : y0);
+      Point  p = Point(0) + dir*((corner & 4) ? depthMax[tile] : depthMin[tile]);
+      boxMin = Point(fminf(boxMin.x, p.x), fminf(boxMin.y, p.y), fminf(boxMin.z, p.z));
+      boxMax = Point(fmaxf(boxMax.x, p.x), fmaxf(boxMax.y, p.y), fmaxf(boxMax.z, p.z));
+    }
+    Point  center;
+    float  radius;
+    for (int i = 0; i < (int)lights.size(); i++) {
+      if ((! lights[i]->GetInfluenceSphere(center, radius))
+      		|| SphereOverlapsBox(center, radius, boxMin, boxMax))
+        tileLights[tile].push_back(i);
+    }
+  }
+}
@@ -0,0 +1,60 @@
+// Code for per-screen-tile light lists: for each tile of the image, the lights
+// which can affect any surface seen (directly) by the camera in that tile.
+
+#ifndef _TILE_LIGHTS_H_
+#define _TILE_LIGHTS_H_
+
+#include <vector>
+#include <memory>
+
+#include "geometry.h"
+#include "shapes.h"
+#include "lights.h"
+#include "cameras.h"
+
+using namespace std;
+
+// width and height of image tiles, in pixels (also used for scheduling the render)
+const int  RENDER_TILE_SIZE = 16;
+
+
+/// Returns true if a sphere overlaps an axis-aligned box
+bool SphereOverlapsBox( const Point &center, float radius, const Point &boxMin,
+						const Point &boxMax );
+
+/// Returns tileLights if hitDepth (of a camera-ray hit in the tile) is inside
+/// [depthMin, depthMax], otherwise NULL (meaning all lights must be used)
+const vector<int> * TileLightsForDepth( const vector<int> *tileLights, float depthMin,
+										float depthMax, float hitDepth );
+
+
+class TileLightLists
+{
+  public:
+    /// Traces a sparse grid of camera rays through each tile to find the range
+    /// of first-hit depths (distance along the camera's -z axis) in each tile, then
+    /// lists the lights whose sphere of influence overlaps the part of the tile's
+    /// view frustum within that range. Lights with unlimited influence are in every
+    /// list. Requires a pinhole camera.
+    TileLightLists( const Camera &camera, int width, int height,
+    				const vector<shared_ptr<Shape>> &shapes,
+    				const vector<shared_ptr<Light>> &lights );
+
+    /// Tiles are numbered in row-major order, starting at the upper left. Since only
+    /// a few camera rays were traced, a tile's lights should only be used for
+    /// surfaces with depths inside [DepthMin(tile), DepthMax(tile)].
+    const vector<int> & Lights( int tile ) const { return tileLights[tile]; };
+    float DepthMin( int tile ) const { return depthMin[tile]; };
+    float DepthMax( int tile ) const { return depthMax[tile]; };
+
+    int NTilesX( ) const { return nTilesX; };
+    int NTilesY( ) const { return nTilesY; };
+
+  private:
+    int  nTilesX, nTilesY;
+    vector<float>  depthMin, depthMax;   // = +/- kInfinity if no camera ray hit anything
+    vector<vector<int>>  tileLights;
+};
+
+
+#endif  // _TILE_LIGHTS_H_
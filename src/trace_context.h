@@ -0,0 +1,51 @@
+// Per-camera-ray state passed down through RayTrace(), used (e.g.) to generate
+// low-discrepancy light samples that are decorrelated between pixels.
+
+#ifndef _TRACE_CONTEXT_H_
+#define _TRACE_CONTEXT_H_
+
+#include <stdint.h>
+#include <vector>
+#include "sampler.h"
+#include "color.h"
+#include "geometry.h"
+
+
+/// First-hit features of a pixel (e.g., guide buffers for denoising). RayTrace()
+/// adds each camera-ray hit to the sums (and RenderImage() adds the squared colors
+/// of the subsamples); NormalizePixelFeatures() then converts them to per-pixel values.
+typedef struct {
+  Color  albedo = Color(0);   // base color of the surface hit (mean over all subsamples)
+  Vector  normal = Vector(0);   // surface normal (unit length, or 0 if no hits)
+  float  depth = 0.0;   // distance along the camera ray (mean over hits)
+  float  coverage = 0.0;   // fraction of subsamples which hit something
+  Color  colorVariance = Color(0);   // variance of the pixel's mean color (estimated from
+                                     // the subsample colors, which RenderImage() adds here)
+  int  shapeIndex = -1;   // shape hit by the (last) camera ray which hit anything
+  bool  specularHit = false;   // did any camera ray hit a reflective/refractive surface?
+} pixelFeatures;
+
+
+/// Note that we initialize things inside the definition, which requires C++11
+typedef struct {
+  uint32_t  pixelSeed = 0;    // hash of the pixel coordinates
+  int  subsampleIndex = 0;    // index of the current camera ray within the pixel
+  int  nSubsamples = 1;       // number of camera rays per pixel
+  bool  perPixelLightSamples = false;   // area-light nsamples is per pixel, not per ray
+  float  lightCutoff = 0.0;   // skip shadow rays for light contributions below this
+  // lights for the current screen tile, valid for camera-ray hits with depths
+  // in [tileDepthMin, tileDepthMax] (see TileLightLists); NULL = not available
+  const std::vector<int>  *tileLights = nullptr;
+  float  tileDepthMin = 0.0, tileDepthMax = 0.0;
+  const Sampler  *sampler = nullptr;   // pixel sampler (also supplies light samples)
+  int  *lastOccluders = nullptr;   // per-thread cache: last shadowing shape for each light
+  std::vector<int>  *packetShapes = nullptr;   // per-thread scratch list for shadow-ray packets
+  pixelFeatures  *features = nullptr;   // if non-NULL, camera-ray hits are added to this
+  // if non-NULL, the lighting components of camera-ray colors are added to this
+  // (nLightingTerms values; see aovs.h)
+  Color  *lighting = nullptr;
+  int  nLightingTerms = 0;
+} traceContext;
+
+
+#endif  // _TRACE_CONTEXT_H_
@@ -19,6 +19,19 @@ Point Transform::operator()( const Point &p )
     return (Point(xp, yp, zp) / wp);
 }
 
+Point Transform::InverseTransform( const Point &p ) const
+{
+  float x = p.x, y = p.y, z = p.z;
+  float xp = invMatrix.m[0][0]*x + invMatrix.m[0][1]*y + invMatrix.m[0][2]*z + invMatrix.m[0][3];
+  float yp = invMatrix.m[1][0]*x + invMatrix.m[1][1]*y + invMatrix.m[1][2]*z + invMatrix.m[1][3];
+  float zp = invMatrix.m[2][0]*x + invMatrix.m[2][1]*y + invMatrix.m[2][2]*z + invMatrix.m[2][3];
+  float wp = invMatrix.m[3][0]*x + invMatrix.m[3][1]*y + invMatrix.m[3][2]*z + invMatrix.m[3][3];
+  if (wp == 1.0)
+    return Point(xp, yp, zp);
+  else
+    return (Point(xp, yp, zp) / wp);
+}
+
 Vector Transform::operator()( const Vector &p )
 {
   float x = p.x, y = p.y, z = p.z;
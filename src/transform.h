@@ -68,6 +68,8 @@ class Transform
     // apply transforms to Points and Vectors
     Point operator()( const Point &p );
     Vector operator()( const Vector &p );
+    // apply the inverse transform to a Point
+    Point InverseTransform( const Point &p ) const;
   
     Matrix4x4 matrix;
     Matrix4x4 invMatrix;
@@ -1,8 +1,8 @@
 #include <assert.h>
-#include <time.h>
+#include <stdlib.h>
 #include "sampler.h"
 #include "uniform_jitter_sampler.h"
-#include "mersenne_twister.h"
+#include "low_discrepancy.h"
 
 
 UniformJitterSampler::UniformJitterSampler( const int sampleRate )
@@ -11,25 +11,19 @@ UniformJitterSampler::UniformJitterSampler( const int sampleRate )
   nSamples2D = nSamples1D*nSamples1D;
   offsetsAllocated = false;
 
-  // seed RNG (replace time call with fixed integer to get repeatable
-  // sequence for testing purposes) -- activate this only for external
-  // testing; for general use, we init the RNG in main()
-//   unsigned long t = (unsigned long)time((time_t *)NULL);
-//   init_genrand(t);
-  
   xOffsets = (float *)calloc((size_t)nSamples2D, sizeof(double));
   yOffsets = (float *)calloc((size_t)nSamples2D, sizeof(double));
   offsetsAllocated = true;
 
-  // precompute and store the x and y offsets relative to pixel center
+  // precompute and store the x and y offsets of the grid-cell centers relative 
+  // to pixel center
   float oversamplePixFrac = 1.0/nSamples1D;
   pixFrac = oversamplePixFrac;
-  int oversampleOffset = nSamples1D / 2 + 1 - nSamples1D;
   int n = 0;
   for (int j = 0; j < nSamples1D; ++j) {
-    float yOff = oversamplePixFrac*(j + oversampleOffset);
+    float yOff = oversamplePixFrac*(j + 0.5) - 0.5;
     for (int i = 0; i < nSamples1D; ++i) {
-      float xOff = oversamplePixFrac*(i + oversampleOffset);
+      float xOff = oversamplePixFrac*(i + 0.5) - 0.5;
       xOffsets[n] = xOff;
       yOffsets[n] = yOff;
       n += 1;
@@ -56,13 +50,22 @@ UniformJitterSampler::~UniformJitterSampler( )
 ///        yy = y + y_off;
 ///        cameraRayDir = ComputeCameraRay(xx, yy, invWidth, invHeight, tanTheta, aspectRatio);
 ///        etc.
-/// In this jittered uniform oversampling version, each time this is called
-/// a new randomly offset version of the (x_off, y_off) position is generated
+/// (Uses the same jitter for every pixel; see the pixelSeed version below.)
 void UniformJitterSampler::GetOffsetCoords( const int n, float *xOffset, float *yOffset ) const
+{
+  GetOffsetCoords(n, 0, xOffset, yOffset);
+}
+
+
+/// In this jittered uniform oversampling version, the (x_off, y_off) position
+/// is randomly offset within its grid cell; the offset is a hash of pixelSeed
+/// and n, so it's different for each pixel but repeatable
+void UniformJitterSampler::GetOffsetCoords( const int n, const uint32_t pixelSeed, 
+											float *xOffset, float *yOffset ) const
 {
   assert ((n >= 0) && (n < nSamples2D) && (offsetsAllocated));
   
-  *xOffset = xOffsets[n] + (float)genrand_real1() - 0.5*pixFrac;
-  *yOffset = yOffsets[n] + (float)genrand_real1() - 0.5*pixFrac;
+  uint32_t  sampleHash = HashCombine(pixelSeed, n);
+  *xOffset = xOffsets[n] + (BitsToUnitFloat(PCGHash(sampleHash)) - 0.5)*pixFrac;
+  *yOffset = yOffsets[n] + (BitsToUnitFloat(PCGHash(sampleHash + 1)) - 0.5)*pixFrac;
 }
-
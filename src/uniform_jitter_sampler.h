@@ -15,8 +15,14 @@ public:
   UniformJitterSampler( const int sampleRate=1 );
   ~UniformJitterSampler( );
 
+  using Sampler::GetOffsetCoords;
+
   /// Computes offset in x and y xOffset, yOffset for sample number n
   void GetOffsetCoords( const int n, float *xOffset, float *yOffset ) const;
+
+  /// Same, but with the jitter decorrelated between pixels via pixelSeed
+  void GetOffsetCoords( const int n, const uint32_t pixelSeed, float *xOffset, 
+  						float *yOffset ) const;
   
 private:
   float  pixFrac;
@@ -15,8 +15,8 @@ public:
   UniformSampler( const int sampleRate=1 );
   ~UniformSampler( );
 
-  // No need to redefine do-nothing Update method
-  
+  using Sampler::GetOffsetCoords;
+
   /// Computes offset in x and y xOffset, yOffset for sample number n
   void GetOffsetCoords( const int n, float *xOffset, float *yOffset ) const;
 }; 
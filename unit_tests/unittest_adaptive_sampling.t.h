@@ -0,0 +1,96 @@
+// Unit tests for code in adaptive_sampling.cpp
+
+#include <cxxtest/TestSuite.h>
+
+#include <vector>
+#include <stdint.h>
+#include "definitions.h"
+#include "geometry.h"
+#include "color.h"
+#include "trace_context.h"
+#include "adaptive_sampling.h"
+
+using namespace std;
+
+const int  WIDTH = 10;
+const int  HEIGHT = 8;
+
+
+// Features for a pixel whose center ray hit shape 0, facing the camera
+pixelFeatures SurfaceFeatures( )
+{
+  pixelFeatures  features;
+  features.albedo = Color(0.5);
+  features.normal = Vector(0, 0, 1);
+  features.depth = 10.0;
+  features.coverage = 1.0;
+  features.shapeIndex = 0;
+  return features;
+}
+
+
+class NewTestSuite : public CxxTest::TestSuite
+{
+public:
+
+  void testSmoothImage( void )
+  {
+    vector<Color>  image(WIDTH*HEIGHT, Color(0.5));
+    vector<pixelFeatures>  features(WIDTH*HEIGHT, SurfaceFeatures());
+    vector<uint8_t>  refine;
+    int  nRefine = FindPixelsToRefine(image.data(), features.data(), WIDTH, HEIGHT, refine);
+
+    TS_ASSERT_EQUALS( nRefine, 0 );
+    TS_ASSERT_EQUALS( (int)refine.size(), WIDTH*HEIGHT );
+  }
+
+  void testShapeEdge( void )
+  {
+    // right half of image sees shape 1 (otherwise identical)
+    vector<Color>  image(WIDTH*HEIGHT, Color(0.5));
+    vector<pixelFeatures>  features(WIDTH*HEIGHT, SurfaceFeatures());
+    for (int y = 0; y < HEIGHT; y++) {
+      for (int x = WIDTH/2; x < WIDTH; x++)
+        features[y*WIDTH + x].shapeIndex = 1;
+    }
+    vector<uint8_t>  refine;
+    int  nRefine = FindPixelsToRefine(image.data(), features.data(), WIDTH, HEIGHT, refine);
+
+    // the two columns on either side of the edge
+    TS_ASSERT_EQUALS( nRefine, 2*HEIGHT );
+    TS_ASSERT_EQUALS( refine[3*WIDTH + WIDTH/2 - 1], 1 );
+    TS_ASSERT_EQUALS( refine[3*WIDTH + WIDTH/2], 1 );
+    TS_ASSERT_EQUALS( refine[3*WIDTH + WIDTH/2 - 2], 0 );
+    TS_ASSERT_EQUALS( refine[3*WIDTH + WIDTH/2 + 1], 0 );
+  }
+
+  void testNormalCrease( void )
+  {
+    vector<Color>  image(WIDTH*HEIGHT, Color(0.5));
+    vector<pixelFeatures>  features(WIDTH*HEIGHT, SurfaceFeatures());
+    for (int x = 0; x < WIDTH; x++)
+      features[(HEIGHT - 1)*WIDTH + x].normal = Vector(0, 1, 0);
+    vector<uint8_t>  refine;
+    int  nRefine = FindPixelsToRefine(image.data(), features.data(), WIDTH, HEIGHT, refine);
+
+    TS_ASSERT_EQUALS( nRefine, 2*WIDTH );
+    TS_ASSERT_EQUALS( refine[(HEIGHT - 2)*WIDTH], 1 );
+  }
+
+  void testColorEdgeAndSpecular( void )
+  {
+    // one dark pixel (e.g., a shadow edge) plus one pixel seeing a mirror
+    vector<Color>  image(WIDTH*HEIGHT, Color(0.5));
+    vector<pixelFeatures>  features(WIDTH*HEIGHT, SurfaceFeatures());
+    image[4*WIDTH + 4] = Color(0.05);
+    features[WIDTH + 8].specularHit = true;
+    vector<uint8_t>  refine;
+    int  nRefine = FindPixelsToRefine(image.data(), features.data(), WIDTH, HEIGHT, refine);
+
+    // the dark pixel and its 8 neighbors, plus the mirror pixel
+    TS_ASSERT_EQUALS( nRefine, 9 + 1 );
+    TS_ASSERT_EQUALS( refine[3*WIDTH + 3], 1 );
+    TS_ASSERT_EQUALS( refine[WIDTH + 8], 1 );
+    TS_ASSERT_EQUALS( refine[WIDTH + 7], 0 );
+  }
+};
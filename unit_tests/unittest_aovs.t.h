@@ -0,0 +1,109 @@
+// Unit tests for code in aovs.cpp
+
+#include <cxxtest/TestSuite.h>
+
+#include <string>
+#include <vector>
+#include "definitions.h"
+#include "color.h"
+#include "trace_context.h"
+#include "image_io.h"
+#include "aovs.h"
+
+using namespace std;
+
+
+// Returns the index of the channel with the given name, or -1 if there isn't one
+int FindChannel( const vector<exrChannel> &channels, const string &name )
+{
+  for (int i = 0; i < (int)channels.size(); i++) {
+    if (channels[i].name == name)
+      return i;
+  }
+  return -1;
+}
+
+// Value of a channel for pixel i
+float ChannelValue( const exrChannel &channel, int i )
+{
+  return *(const float *)((const char *)channel.data + i*channel.xStride);
+}
+
+
+class NewTestSuite : public CxxTest::TestSuite
+{
+public:
+
+  void testParseAOVNames( void )
+  {
+    TS_ASSERT_EQUALS( ParseAOVNames("depth"), AOV_DEPTH );
+    TS_ASSERT_EQUALS( ParseAOVNames("normal,id,lights"), AOV_NORMAL | AOV_OBJECT_ID | AOV_LIGHTS );
+    TS_ASSERT_EQUALS( ParseAOVNames("all"), AOV_ALL );
+    TS_ASSERT_EQUALS( ParseAOVNames("depth,bob"), -1 );
+    TS_ASSERT_EQUALS( ParseAOVNames(""), -1 );
+  }
+
+  void testLightingTerms( void )
+  {
+    AOVBuffers  noLighting(AOV_DEPTH | AOV_NORMAL, 4, 3, 2);
+    TS_ASSERT_EQUALS( noLighting.NLightingTerms(), 0 );
+    TS_ASSERT( noLighting.Lighting(0) == nullptr );
+
+    AOVBuffers  components(AOV_DIRECT, 4, 3, 2);
+    TS_ASSERT_EQUALS( components.NLightingTerms(), N_LIGHTING_COMPONENTS );
+
+    AOVBuffers  perLight(AOV_LIGHTS, 4, 3, 2);
+    TS_ASSERT_EQUALS( perLight.NLightingTerms(), N_LIGHTING_COMPONENTS + 2 );
+    TS_ASSERT_EQUALS( perLight.Lighting(5) - perLight.Lighting(0), 5*(N_LIGHTING_COMPONENTS + 2) );
+  }
+
+  void testNormalizeLighting( void )
+  {
+    AOVBuffers  aovs(AOV_DIRECT | AOV_BACKGROUND, 4, 3, 1);
+    aovs.ClearLighting(7);
+    aovs.Lighting(7)[LIGHTING_DIRECT] += Color(1.0, 2.0, 3.0);
+    aovs.Lighting(7)[LIGHTING_BACKGROUND] += Color(4.0);
+    aovs.NormalizeLighting(7, 4);
+
+    TS_ASSERT_DELTA( aovs.Lighting(7)[LIGHTING_DIRECT].r, 0.25, 1.0e-6 );
+    TS_ASSERT_DELTA( aovs.Lighting(7)[LIGHTING_DIRECT].b, 0.75, 1.0e-6 );
+    TS_ASSERT_DELTA( aovs.Lighting(7)[LIGHTING_BACKGROUND].g, 1.0, 1.0e-6 );
+    TS_ASSERT_DELTA( aovs.Lighting(7)[LIGHTING_EMISSION].g, 0.0, 1.0e-6 );
+  }
+
+  void testEXRChannels( void )
+  {
+    const int  nPixels = 2*2;
+    vector<Color>  image(nPixels, Color(0.5));
+    AOVBuffers  aovs(AOV_DEPTH | AOV_OBJECT_ID | AOV_LIGHTS, 2, 2, 2);
+    // pixel 1 sees shape 3 at distance 7.5; the others see nothing
+    aovs.Features()[1].coverage = 1.0;
+    aovs.Features()[1].depth = 7.5;
+    aovs.Features()[1].shapeIndex = 3;
+    for (int i = 0; i < nPixels; i++)
+      aovs.ClearLighting(i);
+    aovs.Lighting(2)[N_LIGHTING_COMPONENTS + 1] = Color(0.1, 0.2, 0.3);
+    vector<exrChannel>  channels;
+    aovs.GetEXRChannels(image.data(), channels);
+
+    // RGBA + depth + ID + 2 lights
+    TS_ASSERT_EQUALS( (int)channels.size(), 4 + 1 + 1 + 2*3 );
+    TS_ASSERT_EQUALS( FindChannel(channels, "direct.R"), -1 );
+    int  iG = FindChannel(channels, "G");
+    int  iA = FindChannel(channels, "A");
+    int  iDepth = FindChannel(channels, "depth.Z");
+    int  iID = FindChannel(channels, "id.V");
+    int  iLight = FindChannel(channels, "light1.B");
+    TS_ASSERT( (iG >= 0) && (iA >= 0) && (iDepth >= 0) && (iID >= 0) && (iLight >= 0) );
+    TS_ASSERT_DELTA( ChannelValue(channels[iG], 3), 0.5, 1.0e-6 );
+    TS_ASSERT_DELTA( ChannelValue(channels[iA], 1), 1.0, 1.0e-6 );
+    TS_ASSERT_DELTA( ChannelValue(channels[iA], 0), 0.0, 1.0e-6 );
+    TS_ASSERT_DELTA( ChannelValue(channels[iDepth], 1), 7.5, 1.0e-6 );
+    TS_ASSERT_EQUALS( ChannelValue(channels[iDepth], 0), kInfinity );
+    TS_ASSERT_DELTA( ChannelValue(channels[iID], 1), 4.0, 1.0e-6 );
+    TS_ASSERT_DELTA( ChannelValue(channels[iID], 2), 0.0, 1.0e-6 );
+    TS_ASSERT_DELTA( ChannelValue(channels[iLight], 2), 0.3, 1.0e-6 );
+    TS_ASSERT( channels[iDepth].fullFloat );
+    TS_ASSERT( ! channels[iLight].fullFloat );
+  }
+};
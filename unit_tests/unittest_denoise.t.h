@@ -0,0 +1,135 @@
+// Unit tests for code in denoise.cpp
+
+#include <cxxtest/TestSuite.h>
+
+#include <vector>
+#include <math.h>
+#include <stdint.h>
+#include "definitions.h"
+#include "geometry.h"
+#include "color.h"
+#include "trace_context.h"
+#include "denoise.h"
+
+using namespace std;
+
+const int  WIDTH = 20;
+const int  HEIGHT = 10;
+
+
+// Features for a pixel fully covered by a surface facing the camera
+pixelFeatures SurfaceFeatures( Color albedo, float variance )
+{
+  pixelFeatures  features;
+  features.albedo = albedo;
+  features.normal = Vector(0, 0, 1);
+  features.depth = 10.0;
+  features.coverage = 1.0;
+  features.colorVariance = Color(variance);
+  return features;
+}
+
+
+// RMS deviation of the red channel from value, for pixels at least 3 pixels from
+// the image edges
+float RMSDeviation( const vector<Color> &image, float value )
+{
+  float  sum = 0.0;
+  int  n = 0;
+  for (int y = 3; y < HEIGHT - 3; y++) {
+    for (int x = 3; x < WIDTH - 3; x++) {
+      float  deviation = image[y*WIDTH + x].r - value;
+      sum += deviation*deviation;
+      n++;
+    }
+  }
+  return sqrtf(sum / n);
+}
+
+
+class NewTestSuite : public CxxTest::TestSuite
+{
+public:
+
+  void testNormalizePixelFeatures( void )
+  {
+    // 4 subsamples, 2 of which hit a surface (with colors 0, 0, 1, 1)
+    pixelFeatures  features;
+    features.albedo = Color(1.0, 0.5, 0.0);
+    features.normal = Vector(0, 0, 2);
+    features.depth = 6.0;
+    features.coverage = 2.0;
+    features.colorVariance = Color(2.0);
+    NormalizePixelFeatures(features, 4, Color(0.5));
+
+    TS_ASSERT_DELTA( features.albedo.r, 0.25, 1.0e-6 );
+    TS_ASSERT_DELTA( features.albedo.g, 0.125, 1.0e-6 );
+    TS_ASSERT_DELTA( features.normal.z, 1.0, 1.0e-6 );
+    TS_ASSERT_DELTA( features.depth, 3.0, 1.0e-6 );
+    TS_ASSERT_DELTA( features.coverage, 0.5, 1.0e-6 );
+    // sample variance = (0.5 - 0.25)*4/3 = 1/3; variance of mean = 1/12
+    TS_ASSERT_DELTA( features.colorVariance.r, 1.0/12.0, 1.0e-6 );
+  }
+
+  void testConstantImageUnchanged( void )
+  {
+    vector<Color>  image(WIDTH*HEIGHT, Color(0.3, 0.4, 0.5));
+    vector<pixelFeatures>  features(WIDTH*HEIGHT, SurfaceFeatures(Color(0.5), 0.01));
+    DenoiseImage(image.data(), features.data(), WIDTH, HEIGHT, 3);
+
+    for (int i = 0; i < WIDTH*HEIGHT; i++) {
+      TS_ASSERT_DELTA( image[i].r, 0.3, 1.0e-5 );
+      TS_ASSERT_DELTA( image[i].b, 0.5, 1.0e-5 );
+    }
+  }
+
+  void testNoiseReduced( void )
+  {
+    // uniform noise in [0.4, 0.6) from a simple LCG (variance = 0.2^2/12)
+    vector<Color>  image(WIDTH*HEIGHT);
+    uint32_t  state = 12345;
+    for (int i = 0; i < WIDTH*HEIGHT; i++) {
+      state = state*1664525u + 1013904223u;
+      image[i] = Color(0.4 + 0.2*(state >> 8)/16777216.0);
+    }
+    vector<pixelFeatures>  features(WIDTH*HEIGHT, SurfaceFeatures(Color(0.5), 0.04/12.0));
+    float  rmsBefore = RMSDeviation(image, 0.5);
+    DenoiseImage(image.data(), features.data(), WIDTH, HEIGHT, 3);
+    float  rmsAfter = RMSDeviation(image, 0.5);
+
+    TS_ASSERT_LESS_THAN( rmsAfter, 0.7*rmsBefore );
+  }
+
+  void testFeatureEdgePreserved( void )
+  {
+    // left half: dark surface; right half: bright surface with different albedo
+    vector<Color>  image(WIDTH*HEIGHT);
+    vector<pixelFeatures>  features(WIDTH*HEIGHT);
+    for (int y = 0; y < HEIGHT; y++) {
+      for (int x = 0; x < WIDTH; x++) {
+        bool  left = (x < WIDTH/2);
+        image[y*WIDTH + x] = Color(left ? 0.1 : 0.8);
+        features[y*WIDTH + x] = SurfaceFeatures(Color(left ? 0.1 : 0.8), 1.0);
+      }
+    }
+    DenoiseImage(image.data(), features.data(), WIDTH, HEIGHT, 3);
+
+    TS_ASSERT_DELTA( image[5*WIDTH + WIDTH/2 - 1].r, 0.1, 1.0e-3 );
+    TS_ASSERT_DELTA( image[5*WIDTH + WIDTH/2].r, 0.8, 1.0e-3 );
+  }
+
+  void testBackgroundUnchanged( void )
+  {
+    vector<Color>  image(WIDTH*HEIGHT, Color(0.5));
+    vector<pixelFeatures>  features(WIDTH*HEIGHT, SurfaceFeatures(Color(0.5), 0.01));
+    // one background pixel (no surface hit), with a different color
+    image[5*WIDTH + 10] = Color(0.0, 0.0, 1.0);
+    features[5*WIDTH + 10] = pixelFeatures();
+    DenoiseImage(image.data(), features.data(), WIDTH, HEIGHT, 3);
+
+    TS_ASSERT_DELTA( image[5*WIDTH + 10].r, 0.0, 1.0e-6 );
+    TS_ASSERT_DELTA( image[5*WIDTH + 10].b, 1.0, 1.0e-6 );
+    // and its neighbors aren't affected by it
+    TS_ASSERT_DELTA( image[5*WIDTH + 11].b, 0.5, 1.0e-5 );
+  }
+};
@@ -0,0 +1,206 @@
+// Unit tests for code in environment_map.cpp
+
+#include <cxxtest/TestSuite.h>
+
+#include <stdio.h>
+#include <math.h>
+#include <vector>
+#include <string>
+using namespace std;
+
+#include "definitions.h"
+#include "geometry.h"
+#include "color.h"
+#include "image_io.h"
+#include "environment_map.h"
+
+const string  TEST_BAD_PNG_IMAGE("unit_tests/temp_bad_image.png");
+const string  TEST_BAD_EXR_IMAGE("unit_tests/temp_bad_image.exr");
+const string  TEST_SKYBOX_BASE("unit_tests/temp_sky_");
+
+
+// Writes a file which isn't a valid image (but has an image extension)
+void WriteBadImage( const string &filename )
+{
+  FILE *badFile = fopen(filename.c_str(), "w");
+  fprintf(badFile, "this is not an image\n");
+  fclose(badFile);
+}
+
+
+// The original (branching) version of GetUVforCube, as a reference for the
+// table-driven version
+void ReferenceUVforCube( const Vector &dir, int *imageIndex, float *u, float *v )
+{
+  float x = dir.x;
+  float y = dir.y;
+  float z = dir.z;
+  float absX = fabs(x);
+  float absY = fabs(y);
+  float absZ = fabs(z);
+  float maxAxis = 0.0, uc = 0.0, vc = 0.0;
+
+  if ((x > 0) && absX >= absY && absX >= absZ) {
+    maxAxis = absX;  uc = -z;  vc = -y;  *imageIndex = RIGHT_FACE;
+  }
+  if (!(x > 0) && absX >= absY && absX >= absZ) {
+    maxAxis = absX;  uc = z;  vc = -y;  *imageIndex = LEFT_FACE;
+  }
+  if ((y > 0) && absY >= absX && absY >= absZ) {
+    maxAxis = absY;  uc = x;  vc = z;  *imageIndex = TOP_FACE;
+  }
+  if (!(y > 0) && absY >= absX && absY >= absZ) {
+    maxAxis = absY;  uc = x;  vc = z;  *imageIndex = BOTTOM_FACE;
+  }
+  if ((z > 0) && absZ >= absX && absZ >= absY) {
+    maxAxis = absZ;  uc = x;  vc = -y;  *imageIndex = BACK_FACE;
+  }
+  if (!(z > 0) && absZ >= absX && absZ >= absY) {
+    maxAxis = absZ;  uc = -x;  vc = -y;  *imageIndex = FRONT_FACE;
+  }
+  *u = 0.5f * (uc / maxAxis + 1.0f);
+  *v = 0.5f * (vc / maxAxis + 1.0f);
+}
+
+
+class NewTestSuite : public CxxTest::TestSuite 
+{
+public:
+
+  void testGetUVforCube_AxisAligned( void )
+  {
+    int  face;
+    float  u, v;
+    GetUVforCube(Ray(Point(0), Vector(1, 0, 0)), &face, &u, &v);
+    TS_ASSERT_EQUALS( face, RIGHT_FACE );
+    TS_ASSERT_DELTA( u, 0.5, 1.0e-6 );
+    TS_ASSERT_DELTA( v, 0.5, 1.0e-6 );
+    GetUVforCube(Ray(Point(0), Vector(-1, 0, 0)), &face, &u, &v);
+    TS_ASSERT_EQUALS( face, LEFT_FACE );
+    GetUVforCube(Ray(Point(0), Vector(0, 1, 0)), &face, &u, &v);
+    TS_ASSERT_EQUALS( face, TOP_FACE );
+    GetUVforCube(Ray(Point(0), Vector(0, -1, 0)), &face, &u, &v);
+    TS_ASSERT_EQUALS( face, BOTTOM_FACE );
+    GetUVforCube(Ray(Point(0), Vector(0, 0, 1)), &face, &u, &v);
+    TS_ASSERT_EQUALS( face, BACK_FACE );
+    GetUVforCube(Ray(Point(0), Vector(0, 0, -1)), &face, &u, &v);
+    TS_ASSERT_EQUALS( face, FRONT_FACE );
+    TS_ASSERT_DELTA( u, 0.5, 1.0e-6 );
+    TS_ASSERT_DELTA( v, 0.5, 1.0e-6 );
+
+    // off-center on the right face: u runs from +z to -z, v from +y to -y
+    GetUVforCube(Ray(Point(0), Vector(1, 0.5, -0.5)), &face, &u, &v);
+    TS_ASSERT_EQUALS( face, RIGHT_FACE );
+    TS_ASSERT_DELTA( u, 0.75, 1.0e-6 );
+    TS_ASSERT_DELTA( v, 0.25, 1.0e-6 );
+  }
+
+  void testGetUVforCube_MatchesReference( void )
+  {
+    // axis-aligned and diagonal directions (including ties between axes, which
+    // go to z, then y), plus a grid of general directions
+    vector<Vector>  directions;
+    for (int i = -1; i <= 1; i++)
+      for (int j = -1; j <= 1; j++)
+        for (int k = -1; k <= 1; k++)
+          if ((i != 0) || (j != 0) || (k != 0))
+            directions.push_back(Vector(i, j, k));
+    for (int i = -4; i <= 4; i++)
+      for (int j = -4; j <= 4; j++)
+        for (int k = -4; k <= 4; k++)
+          if ((i != 0) || (j != 0) || (k != 0))
+            directions.push_back(Vector(i + 0.3, 0.7*j, k - 0.1));
+
+    for (const Vector &d : directions) {
+      int  face, refFace;
+      float  u, v, refU, refV;
+      Ray  theRay(Point(0), d);
+      GetUVforCube(theRay, &face, &u, &v);
+      ReferenceUVforCube(theRay.dir, &refFace, &refU, &refV);
+      TS_ASSERT_EQUALS( face, refFace );
+      TS_ASSERT_DELTA( u, refU, 1.0e-6 );
+      TS_ASSERT_DELTA( v, refV, 1.0e-6 );
+    }
+  }
+
+  void testGetDirectionForCube_RoundTrip( void )
+  {
+    for (int face = 0; face < 6; face++) {
+      for (int i = 0; i < 8; i++) {
+        for (int j = 0; j < 8; j++) {
+          float  u = (i + 0.5f)/8;
+          float  v = (j + 0.5f)/8;
+          Vector  dir;
+          int  newFace;
+          float  newU, newV;
+          GetDirectionForCube(face, u, v, &dir);
+          TS_ASSERT_DELTA( dir.Length(), 1.0, 1.0e-5 );
+          GetUVforCube(Ray(Point(0), dir), &newFace, &newU, &newV);
+          TS_ASSERT_EQUALS( newFace, face );
+          TS_ASSERT_DELTA( newU, u, 1.0e-5 );
+          TS_ASSERT_DELTA( newV, v, 1.0e-5 );
+        }
+      }
+    }
+    // ... and direction -> (face, u, v) -> direction
+    Vector  d = Normalize(Vector(0.3, -0.8, 0.5));
+    int  face;
+    float  u, v;
+    Vector  dir;
+    GetUVforCube(Ray(Point(0), d), &face, &u, &v);
+    GetDirectionForCube(face, u, v, &dir);
+    TS_ASSERT_DELTA( dir.x, d.x, 1.0e-5 );
+    TS_ASSERT_DELTA( dir.y, d.y, 1.0e-5 );
+    TS_ASSERT_DELTA( dir.z, d.z, 1.0e-5 );
+  }
+
+  // Failures in the background image-decoding tasks
+
+  void testLoadMipMapTask_Errors( void )
+  {
+    TS_ASSERT( LoadMipMapTask("unit_tests/nonexistent_image.png", MIPMAP_CLAMP) == nullptr );
+    TS_ASSERT( LoadMipMapTask("unit_tests/nonexistent_image.ptx", MIPMAP_CLAMP) == nullptr );
+    WriteBadImage(TEST_BAD_PNG_IMAGE);
+    TS_ASSERT( LoadMipMapTask(TEST_BAD_PNG_IMAGE, MIPMAP_CLAMP) == nullptr );
+    // (OpenEXR reports a bad file by throwing, which must not escape the task)
+    WriteBadImage(TEST_BAD_EXR_IMAGE);
+    TS_ASSERT_THROWS_NOTHING( LoadMipMapTask(TEST_BAD_EXR_IMAGE, MIPMAP_CLAMP) );
+    TS_ASSERT( LoadMipMapTask(TEST_BAD_EXR_IMAGE, MIPMAP_CLAMP) == nullptr );
+    remove(TEST_BAD_PNG_IMAGE.c_str());
+    remove(TEST_BAD_EXR_IMAGE.c_str());
+  }
+
+  void testWaitForImages_BadSphereMap( void )
+  {
+    // the error is reported by WaitForImages, and the environment falls back to
+    // its plain color
+    WriteBadImage(TEST_BAD_PNG_IMAGE);
+    Environment  pngEnvironment(TEST_BAD_PNG_IMAGE);
+    TS_ASSERT( ! pngEnvironment.WaitForImages() );
+    TS_ASSERT_EQUALS( pngEnvironment.GetEnvironmentColor(Ray(Point(0), Vector(0, 0, -1))), 
+    					Color(0) );
+    WriteBadImage(TEST_BAD_EXR_IMAGE);
+    Environment  exrEnvironment(TEST_BAD_EXR_IMAGE);
+    TS_ASSERT( ! exrEnvironment.WaitForImages() );
+    // nothing left to wait for
+    TS_ASSERT( exrEnvironment.WaitForImages() );
+    remove(TEST_BAD_PNG_IMAGE.c_str());
+    remove(TEST_BAD_EXR_IMAGE.c_str());
+  }
+
+  void testWaitForImages_Skybox( void )
+  {
+    Color  image[4] = {Color(1, 0, 0), Color(0, 1, 0), Color(0, 0, 1), Color(1)};
+    for (int i = 0; i < 6; i++)
+      SaveImagePNG(image, 2, 2, TEST_SKYBOX_BASE + skyboxFaceNames[i] + ".png", false);
+    Environment  goodEnvironment(TEST_SKYBOX_BASE, ".png");
+    TS_ASSERT( goodEnvironment.WaitForImages() );
+
+    // one undecodable face
+    WriteBadImage(TEST_SKYBOX_BASE + skyboxFaceNames[FRONT_FACE] + ".png");
+    Environment  badEnvironment(TEST_SKYBOX_BASE, ".png");
+    TS_ASSERT( ! badEnvironment.WaitForImages() );
+    for (int i = 0; i < 6; i++)
+      remove((TEST_SKYBOX_BASE + skyboxFaceNames[i] + ".png").c_str());
+  }
+};
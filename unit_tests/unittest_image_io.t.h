@@ -12,10 +12,38 @@ using namespace std;
 #include "utilities_pub.h"
 #include "definitions.h"
 #include "image_io.h"
+#include "exr_tile_writer.h"
 #include "color.h"
+#include "stb_image.h"
+#include "exr_compression.h"
+
+#include <OpenEXR/ImfInputFile.h>
+#include <OpenEXR/ImfHeader.h>
+#include <OpenEXR/ImfChannelList.h>
+#include <OpenEXR/ImfFrameBuffer.h>
 
 const string  TEST_TINY_PNG_IMAGE("tests/tiny_image.png");
 const string  TEST_TINY_PNG_REFERENCE_IMAGE("reference/tiny_image.png");
+const string  TEST_TILED_EXR_IMAGE("unit_tests/temp_tiled.exr");
+const string  TEST_EXR_IMAGE("unit_tests/temp_image.exr");
+
+
+// Reads one channel of a (width x height) OpenEXR file as floats; also returns the
+// channel's pixel type and the file's compression
+void ReadEXRChannel( const string &filename, const char *channelName, int width, 
+					int height, vector<float> &values, Imf::PixelType *pixelType, 
+					Imf::Compression *compression )
+{
+  Imf::InputFile  file(filename.c_str());
+  *compression = file.header().compression();
+  *pixelType = file.header().channels().findChannel(channelName)->type;
+  values.assign(width*height, 0.0f);
+  Imf::FrameBuffer  frameBuffer;
+  frameBuffer.insert(channelName, Imf::Slice(Imf::FLOAT, (char *)values.data(), 
+  					sizeof(float), sizeof(float)*width));
+  file.setFrameBuffer(frameBuffer);
+  file.readPixels(0, height - 1);
+}
 
 
 class NewTestSuite : public CxxTest::TestSuite 
@@ -69,4 +97,223 @@ class NewTestSuite : public CxxTest::TestSuite
     TS_ASSERT_DELTA(readImage[3].b, 0.499505, 1.0e-6);  // ignoring conversion/rounding, should be 0.5
   }
 
+  void testEncodePNGRoundTrip( void )
+  {
+    // big enough to be compressed in more than one chunk
+    int  width = 400;
+    int  height = 300;
+    vector<unsigned char>  pixels(3*width*height);
+    for (int y = 0; y < height; y++) {
+      for (int x = 0; x < width; x++) {
+        pixels[3*(y*width + x)] = (unsigned char)x;
+        pixels[3*(y*width + x) + 1] = (unsigned char)(x*y);
+        pixels[3*(y*width + x) + 2] = (unsigned char)((x*7 + y*13) % 5);
+      }
+    }
+    vector<unsigned char>  pngData;
+    TS_ASSERT( EncodePNG(pixels.data(), width, height, pngData) );
+
+    int  readWidth, readHeight, nChannels;
+    unsigned char *decoded = stbi_load_from_memory(pngData.data(), (int)pngData.size(), 
+    											&readWidth, &readHeight, &nChannels, 3);
+    TS_ASSERT( decoded != NULL );
+    TS_ASSERT_EQUALS(readWidth, width);
+    TS_ASSERT_EQUALS(readHeight, height);
+    int  nDifferent = 0;
+    for (int i = 0; i < 3*width*height; i++) {
+      if (decoded[i] != pixels[i])
+        nDifferent++;
+    }
+    TS_ASSERT_EQUALS(nDifferent, 0);
+    stbi_image_free(decoded);
+  }
+
+  void testTiledEXRWriterRoundTrip( void )
+  {
+    // 37x21 image with 16x16 tiles --> 3x2 tiles, with partial tiles at the edges
+    int  width = 37;
+    int  height = 21;
+    int  tileSize = 16;
+    vector<Color>  tilePixels(tileSize*tileSize);
+    TiledEXRWriter  writer(TEST_TILED_EXR_IMAGE, width, height, tileSize, 2);
+    TS_ASSERT( writer.IsOpen() );
+
+    // submit tiles in reverse order (all values are exactly representable as halfs)
+    for (int tile = 5; tile >= 0; tile--) {
+      int  tileX = tile % 3;
+      int  tileY = tile / 3;
+      for (int j = 0; j < tileSize; j++) {
+        for (int i = 0; i < tileSize; i++) {
+          int  x = tileX*tileSize + i;
+          int  y = tileY*tileSize + j;
+          tilePixels[j*tileSize + i] = Color(x, y, 0.5*(x + y));
+        }
+      }
+      TS_ASSERT( writer.SubmitTile(tileX, tileY, tilePixels.data()) );
+    }
+    TS_ASSERT( writer.Finish() );
+
+    int  readWidth, readHeight;
+    Color *readImage = ReadImageOpenEXR(TEST_TILED_EXR_IMAGE, readWidth, readHeight);
+    TS_ASSERT_EQUALS(readWidth, width);
+    TS_ASSERT_EQUALS(readHeight, height);
+    int  nDifferent = 0;
+    for (int y = 0; y < height; y++) {
+      for (int x = 0; x < width; x++) {
+        if (! (readImage[y*width + x] == Color(x, y, 0.5*(x + y))))
+          nDifferent++;
+      }
+    }
+    TS_ASSERT_EQUALS(nDifferent, 0);
+    delete [] readImage;
+    remove(TEST_TILED_EXR_IMAGE.c_str());
+  }
+
+  void testTiledEXRWriter_Errors( void )
+  {
+    vector<Color>  tilePixels(16*16);
+
+    TiledEXRWriter  badPathWriter("unit_tests/nonexistent_dir/temp.exr", 32, 32, 16, 2);
+    TS_ASSERT( ! badPathWriter.IsOpen() );
+    TS_ASSERT( ! badPathWriter.SubmitTile(0, 0, tilePixels.data()) );
+    TS_ASSERT( ! badPathWriter.Finish() );
+
+    // OpenEXR throws for a nonexistent tile; the writer should report the
+    // failure and refuse further tiles
+    TiledEXRWriter  writer(TEST_TILED_EXR_IMAGE, 32, 32, 16, 2);
+    TS_ASSERT( writer.IsOpen() );
+    TS_ASSERT( writer.SubmitTile(5, 0, tilePixels.data()) );
+    TS_ASSERT( ! writer.Finish() );
+    TS_ASSERT( ! writer.SubmitTile(0, 0, tilePixels.data()) );
+    remove(TEST_TILED_EXR_IMAGE.c_str());
+  }
+
+  void testParseEXRCompression( void )
+  {
+    TS_ASSERT_EQUALS( ParseEXRCompression("none"), EXR_COMPRESSION_NONE );
+    TS_ASSERT_EQUALS( ParseEXRCompression("zip"), EXR_COMPRESSION_ZIP );
+    TS_ASSERT_EQUALS( ParseEXRCompression("piz"), EXR_COMPRESSION_PIZ );
+    TS_ASSERT_EQUALS( ParseEXRCompression("dwaa"), EXR_COMPRESSION_DWAA );
+    TS_ASSERT_EQUALS( ParseEXRCompression("ZIP"), -1 );
+    TS_ASSERT_EQUALS( ParseEXRCompression("rle"), -1 );
+    TS_ASSERT_EQUALS( ParseEXRCompression(""), -1 );
+
+    TS_ASSERT_EQUALS( OpenEXRCompression(EXR_COMPRESSION_NONE), Imf::NO_COMPRESSION );
+    TS_ASSERT_EQUALS( OpenEXRCompression(EXR_COMPRESSION_ZIP), Imf::ZIP_COMPRESSION );
+    TS_ASSERT_EQUALS( OpenEXRCompression(EXR_COMPRESSION_PIZ), Imf::PIZ_COMPRESSION );
+    TS_ASSERT_EQUALS( OpenEXRCompression(EXR_COMPRESSION_DWAA), Imf::DWAA_COMPRESSION );
+  }
+
+  void testSaveImageOpenEXR_RoundTrip( void )
+  {
+    // each compression setting is recorded in the file, and the lossless ones
+    // reproduce the (half-representable) values exactly; alpha comes from a single
+    // value with zero stride, so it should be 1 everywhere
+    int  width = 19;
+    int  height = 11;
+    vector<Color>  image(width*height);
+    for (int y = 0; y < height; y++)
+      for (int x = 0; x < width; x++)
+        image[y*width + x] = Color(0.25 + x/32.0, 0.25 + y/32.0, 0.5);
+    int  compressions[4] = {EXR_COMPRESSION_NONE, EXR_COMPRESSION_ZIP, 
+    						EXR_COMPRESSION_PIZ, EXR_COMPRESSION_DWAA};
+    Imf::Compression  exrCompressions[4] = {Imf::NO_COMPRESSION, Imf::ZIP_COMPRESSION,
+    						Imf::PIZ_COMPRESSION, Imf::DWAA_COMPRESSION};
+    const char  *channelNames[3] = {"R", "G", "B"};
+    vector<float>  values;
+    Imf::PixelType  pixelType;
+    Imf::Compression  compression;
+
+    for (int n = 0; n < 4; n++) {
+      exrOutputOptions  exrOptions;
+      exrOptions.compression = compressions[n];
+      SaveImageOpenEXR(image.data(), width, height, TEST_EXR_IMAGE, exrOptions);
+      // DWAA is lossy for RGB channels
+      float  tolerance = (compressions[n] == EXR_COMPRESSION_DWAA) ? 0.02 : 0.0;
+      for (int k = 0; k < 3; k++) {
+        ReadEXRChannel(TEST_EXR_IMAGE, channelNames[k], width, height, values, &pixelType,
+        				&compression);
+        TS_ASSERT_EQUALS( compression, exrCompressions[n] );
+        TS_ASSERT_EQUALS( pixelType, Imf::HALF );
+        int  nDifferent = 0;
+        for (int i = 0; i < width*height; i++) {
+          if (fabs(values[i] - image[i][k]) > tolerance)
+            nDifferent++;
+        }
+        TS_ASSERT_EQUALS( nDifferent, 0 );
+      }
+      ReadEXRChannel(TEST_EXR_IMAGE, "A", width, height, values, &pixelType, &compression);
+      int  nNotOne = 0;
+      for (int i = 0; i < width*height; i++) {
+        if (values[i] != 1.0f)
+          nNotOne++;
+      }
+      TS_ASSERT_EQUALS( nNotOne, 0 );
+    }
+    remove(TEST_EXR_IMAGE.c_str());
+  }
+
+  void testSaveImageOpenEXR_FullFloat( void )
+  {
+    // 1 + 2^-20 isn't representable as a half, so only survives as a float
+    int  width = 3;
+    int  height = 2;
+    float  precise = 1.0f + 1.0f/1048576.0f;
+    vector<Color>  image(width*height, Color(precise, 2.0, 0.0));
+    vector<float>  values;
+    Imf::PixelType  pixelType;
+    Imf::Compression  compression;
+
+    exrOutputOptions  exrOptions;
+    exrOptions.fullFloat = true;
+    SaveImageOpenEXR(image.data(), width, height, TEST_EXR_IMAGE, exrOptions);
+    ReadEXRChannel(TEST_EXR_IMAGE, "R", width, height, values, &pixelType, &compression);
+    TS_ASSERT_EQUALS( pixelType, Imf::FLOAT );
+    TS_ASSERT_EQUALS( values[0], precise );
+    TS_ASSERT_EQUALS( values[width*height - 1], precise );
+    ReadEXRChannel(TEST_EXR_IMAGE, "A", width, height, values, &pixelType, &compression);
+    TS_ASSERT_EQUALS( pixelType, Imf::FLOAT );
+    TS_ASSERT_EQUALS( values[width*height - 1], 1.0f );
+
+    SaveImageOpenEXR(image.data(), width, height, TEST_EXR_IMAGE);
+    ReadEXRChannel(TEST_EXR_IMAGE, "R", width, height, values, &pixelType, &compression);
+    TS_ASSERT_EQUALS( pixelType, Imf::HALF );
+    TS_ASSERT_EQUALS( values[0], 1.0f );
+    remove(TEST_EXR_IMAGE.c_str());
+  }
+
+  void testSaveImageOpenEXRChannels_ZeroStride( void )
+  {
+    // a zero-stride channel repeats its single value; per-channel fullFloat
+    // overrides the (half) default
+    int  width = 4;
+    int  height = 3;
+    vector<float>  depth(width*height);
+    for (int i = 0; i < width*height; i++)
+      depth[i] = 100.0f + i/1024.0f;
+    float  constant = 0.75;
+    vector<exrChannel>  channels(2);
+    channels[0].name = "depth.Z";
+    channels[0].data = depth.data();
+    channels[0].fullFloat = true;
+    channels[1].name = "Y";
+    channels[1].data = &constant;
+    channels[1].xStride = 0;
+    vector<float>  values;
+    Imf::PixelType  pixelType;
+    Imf::Compression  compression;
+
+    SaveImageOpenEXRChannels(channels, width, height, TEST_EXR_IMAGE);
+    ReadEXRChannel(TEST_EXR_IMAGE, "depth.Z", width, height, values, &pixelType, &compression);
+    TS_ASSERT_EQUALS( pixelType, Imf::FLOAT );
+    TS_ASSERT_EQUALS( compression, Imf::ZIP_COMPRESSION );
+    for (int i = 0; i < width*height; i++)
+      TS_ASSERT_EQUALS( values[i], depth[i] );
+    ReadEXRChannel(TEST_EXR_IMAGE, "Y", width, height, values, &pixelType, &compression);
+    TS_ASSERT_EQUALS( pixelType, Imf::HALF );
+    for (int i = 0; i < width*height; i++)
+      TS_ASSERT_EQUALS( values[i], 0.75f );
+    remove(TEST_EXR_IMAGE.c_str());
+  }
+
 };
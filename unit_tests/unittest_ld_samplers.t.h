@@ -0,0 +1,147 @@
+// Unit tests for code in sobol_sampler.cpp, halton_sampler.cpp, and cmj_sampler.cpp
+
+#include <cxxtest/TestSuite.h>
+
+#include <vector>
+#include "sampler.h"
+#include "sobol_sampler.h"
+#include "halton_sampler.h"
+#include "cmj_sampler.h"
+
+using namespace std;
+
+
+// Returns true if each of the nStrata vertical strata and each of the nStrata
+// horizontal strata of the unit square contains exactly one of the samples
+bool OnePerStratum( const Sampler &sampler, int nStrata, int dimension, uint32_t seed )
+{
+  vector<int>  uCounts(nStrata, 0), vCounts(nStrata, 0);
+  float  u, v;
+  for (int n = 0; n < nStrata; n++) {
+    sampler.GetSample2D(n, dimension, seed, &u, &v);
+    if ((u < 0.0) || (u >= 1.0) || (v < 0.0) || (v >= 1.0))
+      return false;
+    uCounts[(int)(u*nStrata)] += 1;
+    vCounts[(int)(v*nStrata)] += 1;
+  }
+  for (int i = 0; i < nStrata; i++) {
+    if ((uCounts[i] != 1) || (vCounts[i] != 1))
+      return false;
+  }
+  return true;
+}
+
+
+class NewTestSuite : public CxxTest::TestSuite 
+{
+public:
+
+  void testCreation( void )
+  {
+    SobolSampler  sobol(16);
+    HaltonSampler  halton(12);
+    CMJSampler  cmj(7);
+    
+    TS_ASSERT_EQUALS( sobol.NSamples(), 16 );
+    TS_ASSERT_EQUALS( halton.NSamples(), 12 );
+    TS_ASSERT_EQUALS( cmj.NSamples(), 7 );
+  }
+
+  void testOffsetsInsidePixel( void )
+  {
+    SobolSampler  sobol(10);
+    HaltonSampler  halton(10);
+    CMJSampler  cmj(10);
+    Sampler *samplers[3] = {&sobol, &halton, &cmj};
+    float  xx, yy;
+    
+    for (int i = 0; i < 3; i++) {
+      for (int n = 0; n < 10; n++) {
+        samplers[i]->GetOffsetCoords(n, 12345u, &xx, &yy);
+        TS_ASSERT( (xx >= -0.5) && (xx < 0.5) );
+        TS_ASSERT( (yy >= -0.5) && (yy < 0.5) );
+      }
+    }
+  }
+
+  void testSobol_Stratification( void )
+  {
+    SobolSampler  sobol(16);
+    for (uint32_t seed = 1; seed < 5; seed++) {
+      TS_ASSERT( OnePerStratum(sobol, 16, SAMPLE_DIMENSION_PIXEL, seed) );
+      TS_ASSERT( OnePerStratum(sobol, 16, SAMPLE_DIMENSION_LENS, seed) );
+    }
+  }
+
+  void testHalton_RadicalInverse( void )
+  {
+    TS_ASSERT_DELTA( ScrambledRadicalInverse(2, 0, 0), 0.0, 1.0e-7 );
+    TS_ASSERT_DELTA( ScrambledRadicalInverse(2, 1, 0), 0.5, 1.0e-7 );
+    TS_ASSERT_DELTA( ScrambledRadicalInverse(2, 6, 0), 0.375, 1.0e-7 );
+    TS_ASSERT_DELTA( ScrambledRadicalInverse(3, 1, 0), 1.0/3.0, 1.0e-7 );
+    TS_ASSERT_DELTA( ScrambledRadicalInverse(3, 5, 0), 7.0/9.0, 1.0e-7 );
+    float  x = ScrambledRadicalInverse(2, 1, 999u);
+    TS_ASSERT( (x >= 0.0) && (x < 1.0) );
+  }
+
+  void testHalton_Unscrambled( void )
+  {
+    HaltonSampler  halton(4);
+    float  xx, yy;
+    
+    halton.GetOffsetCoords(1, &xx, &yy);
+    TS_ASSERT_DELTA( xx, 0.0, 1.0e-6 );
+    TS_ASSERT_DELTA( yy, 1.0/3.0 - 0.5, 1.0e-6 );
+  }
+
+  void testHalton_Stratification( void )
+  {
+    // first 2^k points are stratified in u, first 3^k in v (with or without
+    // scrambling)
+    HaltonSampler  halton(9);
+    float  u, v;
+    for (uint32_t seed = 0; seed < 4; seed++) {
+      vector<int>  uCounts(8, 0), vCounts(9, 0);
+      for (int n = 0; n < 8; n++) {
+        halton.GetSample2D(n, SAMPLE_DIMENSION_PIXEL, seed, &u, &v);
+        uCounts[(int)(u*8)] += 1;
+      }
+      for (int n = 0; n < 9; n++) {
+        halton.GetSample2D(n, SAMPLE_DIMENSION_PIXEL, seed, &u, &v);
+        vCounts[(int)(v*9)] += 1;
+      }
+      for (int i = 0; i < 8; i++)
+        TS_ASSERT_EQUALS( uCounts[i], 1 );
+      for (int i = 0; i < 9; i++)
+        TS_ASSERT_EQUALS( vCounts[i], 1 );
+    }
+  }
+
+  void testCMJ_Stratification( void )
+  {
+    // works for non-square sample counts, too (u is stratified into N strata
+    // when N = m x n, with m = floor(sqrt(N)) and n = ceil(N/m))
+    int  counts[3] = {12, 16, 20};
+    for (int i = 0; i < 3; i++) {
+      CMJSampler  cmj(counts[i]);
+      for (uint32_t seed = 0; seed < 4; seed++) {
+        TS_ASSERT( OnePerStratum(cmj, counts[i], SAMPLE_DIMENSION_PIXEL, seed) );
+        TS_ASSERT( OnePerStratum(cmj, counts[i], SAMPLE_DIMENSION_LIGHT, seed) );
+      }
+    }
+  }
+
+  void testDimensionsAreDecorrelated( void )
+  {
+    SobolSampler  sobol(4);
+    CMJSampler  cmj(4);
+    float  u1, v1, u2, v2;
+    
+    sobol.GetSample2D(0, SAMPLE_DIMENSION_PIXEL, 17u, &u1, &v1);
+    sobol.GetSample2D(0, SAMPLE_DIMENSION_LENS, 17u, &u2, &v2);
+    TS_ASSERT( (u1 != u2) || (v1 != v2) );
+    cmj.GetSample2D(0, SAMPLE_DIMENSION_PIXEL, 17u, &u1, &v1);
+    cmj.GetSample2D(0, SAMPLE_DIMENSION_LENS, 17u, &u2, &v2);
+    TS_ASSERT( (u1 != u2) || (v1 != v2) );
+  }
+};
@@ -0,0 +1,127 @@
+// Unit tests for code in light_bvh.cpp
+
+#include <cxxtest/TestSuite.h>
+
+#include <vector>
+#include <memory>
+#include "definitions.h"
+#include "geometry.h"
+#include "color.h"
+#include "lights.h"
+#include "light_bvh.h"
+#include "mersenne_twister.h"
+
+using namespace std;
+
+
+class NewTestSuite : public CxxTest::TestSuite 
+{
+public:
+
+  void testConstruction( void )
+  {
+    vector<shared_ptr<Light>> lights;
+    lights.push_back(make_shared<PointLight>(Color(1), 100.0, Point(0.0, 5.0, 0.0)));
+    lights.push_back(make_shared<DistantLight>(Vector(0.0, -1.0, 0.0), Color(1), 1.0));
+    lights.push_back(make_shared<SphericalLight>(Point(3.0, 5.0, 0.0), 1.0, Color(1), 1.0));
+    LightBVH lightTree = LightBVH(lights);
+
+    TS_ASSERT_EQUALS( lightTree.NLights(), 2 );
+    TS_ASSERT_EQUALS( lightTree.UnboundedLights().size(), 1 );
+    TS_ASSERT_EQUALS( lightTree.UnboundedLights()[0], 1 );
+  }
+
+  void testSampleLight_SingleLight( void )
+  {
+    vector<shared_ptr<Light>> lights;
+    lights.push_back(make_shared<PointLight>(Color(1), 100.0, Point(0.0, 5.0, 0.0)));
+    LightBVH lightTree = LightBVH(lights);
+    float pdf;
+
+    // light is above the surface
+    int index = lightTree.SampleLight(Point(0.0), Vector(0.0, 1.0, 0.0), 0.5, &pdf);
+    TS_ASSERT_EQUALS( index, 0 );
+    TS_ASSERT_DELTA( pdf, 1.0, 1.0e-6 );
+    // light is behind the surface
+    index = lightTree.SampleLight(Point(0.0), Vector(0.0, -1.0, 0.0), 0.5, &pdf);
+    TS_ASSERT_EQUALS( index, -1 );
+  }
+
+  void testSampleLight_Unbiased( void )
+  {
+    // Averaging f(light)/pdf over samples should give the sum of f over all
+    // lights that can reach the point; here f = 1, so the result should equal
+    // the number of lights above the surface
+    vector<shared_ptr<Light>> lights;
+    init_genrand(100);
+    int nAbove = 0;
+    for (int i = 0; i < 50; i++) {
+      Point pos(20*genrand_real1() - 10, 10*genrand_real1() - 2, 20*genrand_real1() - 10);
+      if (pos.y > 0)
+        nAbove++;
+      if (i % 2 == 0)
+        lights.push_back(make_shared<PointLight>(Color(1), 10.0*(i + 1), pos));
+      else
+        lights.push_back(make_shared<SphericalLight>(pos, 0.1, Color(0.5), 1.0));
+    }
+    LightBVH lightTree = LightBVH(lights);
+    TS_ASSERT_EQUALS( lightTree.NLights(), 50 );
+
+    int nSamples = 200000;
+    double sum = 0.0;
+    for (int n = 0; n < nSamples; n++) {
+      float pdf;
+      int index = lightTree.SampleLight(Point(0.0), Vector(0.0, 1.0, 0.0), genrand_real2(), &pdf);
+      TS_ASSERT( index >= 0 );
+      TS_ASSERT( lights[index]->GetBounds(pos_min, pos_max) );
+      // lights entirely below the surface are never chosen
+      TS_ASSERT( pos_max.y > 0 );
+      sum += 1.0 / pdf;
+    }
+    TS_ASSERT_DELTA( sum / nSamples, nAbove, 0.03*nAbove );
+  }
+
+  void testSampleLight_RectLightNormalCone( void )
+  {
+    // rect light at y = 5 facing down: points above it get no light from it
+    vector<shared_ptr<Light>> lights;
+    lights.push_back(make_shared<RectLight>(Point(0.0, 5.0, 0.0), 1.0, 1.0, Color(1), 10.0, 1));
+    LightBVH lightTree = LightBVH(lights);
+    float pdf;
+
+    int index = lightTree.SampleLight(Point(0.0), Vector(0.0, 1.0, 0.0), 0.5, &pdf);
+    TS_ASSERT_EQUALS( index, 0 );
+    TS_ASSERT_DELTA( pdf, 1.0, 1.0e-6 );
+    // point above the light, with the light in front of the surface
+    index = lightTree.SampleLight(Point(0.0, 10.0, 0.0), Vector(0.0, -1.0, 0.0), 0.5, &pdf);
+    TS_ASSERT_EQUALS( index, -1 );
+  }
+
+  void testSampleLight_RectAndPointLights( void )
+  {
+    // point above both lights: only the point light can reach it
+    vector<shared_ptr<Light>> lights;
+    lights.push_back(make_shared<RectLight>(Point(0.0, 5.0, 0.0), 1.0, 1.0, Color(1), 10.0, 1));
+    lights.push_back(make_shared<PointLight>(Color(1), 100.0, Point(3.0, 5.0, 0.0)));
+    LightBVH lightTree = LightBVH(lights);
+    float pdf;
+
+    for (int i = 0; i < 10; i++) {
+      int index = lightTree.SampleLight(Point(0.0, 10.0, 0.0), Vector(0.0, -1.0, 0.0), 
+      									(i + 0.5)/10.0, &pdf);
+      TS_ASSERT_EQUALS( index, 1 );
+      TS_ASSERT_DELTA( pdf, 1.0, 1.0e-6 );
+    }
+    // point below both lights: both can be chosen
+    bool  chosen[2] = {false, false};
+    for (int i = 0; i < 1000; i++) {
+      int index = lightTree.SampleLight(Point(0.0), Vector(0.0, 1.0, 0.0), (i + 0.5)/1000.0, &pdf);
+      TS_ASSERT( (index == 0) || (index == 1) );
+      chosen[index] = true;
+    }
+    TS_ASSERT( chosen[0] && chosen[1] );
+  }
+
+private:
+  Point pos_min, pos_max;
+};
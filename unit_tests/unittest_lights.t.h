@@ -117,6 +117,31 @@ public:
 
   }
 
+  void testPointLight_ContributionCutoff( void )
+  {
+    // luminosity chosen so that peak contribution (brightest channel) = 1 at r = 10
+    Color c = Color(0.5, 1.0, 0.5);
+    Point lightPos = Point(1.0, 2.0, 3.0);
+    PointLight thisPointLight = PointLight(c, 100.0*FOUR_PI*PI, lightPos);
+    Point center;
+    float radius;
+
+    // unlimited influence by default
+    TS_ASSERT( ! thisPointLight.GetInfluenceSphere(center, radius) );
+    thisPointLight.SetContributionCutoff(1.0);
+    TS_ASSERT( thisPointLight.GetInfluenceSphere(center, radius) );
+    TS_ASSERT_EQUALS( center, lightPos );
+    TS_ASSERT_DELTA( radius, 10.0, 1.0e-4 );
+    thisPointLight.SetContributionCutoff(0.01);
+    thisPointLight.GetInfluenceSphere(center, radius);
+    TS_ASSERT_DELTA( radius, 100.0, 1.0e-3 );
+
+    // lights without distance falloff keep unlimited influence
+    RectLight thisRectLight = RectLight(lightPos, 1.0, 1.0, c, 10.0);
+    thisRectLight.SetContributionCutoff(1.0);
+    TS_ASSERT( ! thisRectLight.GetInfluenceSphere(center, radius) );
+  }
+
 
 //   DistantLight( const Vec3f &lightDir, const Color &color, const float lum )
 //   {
@@ -204,7 +229,7 @@ public:
     p_hit = Point(0.0, 0.0, 0.0);
     Vector correctVectorFromLightToPhit = Vector(0.0, -1.0, 0.0);
     
-    thisRectLight.SetSeed(100);
+    init_genrand(100);
     thisRectLight.Illuminate(p_hit, dirFromLight, lightIntens, distance);
     // these values would be 0, -1, 0, and 10.0 for the center of the rectangle; these
     // approximate values are for the Mersenne Twister RNG initialized with seed = 100
@@ -218,6 +243,85 @@ public:
     TS_ASSERT_EQUALS( lightIntens, correctLightIntens );
     TS_ASSERT_DELTA( distance, correctDistance, 1.0e-4 );
 
+    // point above the (downward-facing) light gets no light
+    p_hit = Point(0.0, 20.0, 0.0);
+    thisRectLight.Illuminate(p_hit, dirFromLight, lightIntens, distance);
+    TS_ASSERT_EQUALS( lightIntens, Color(0) );
+  }
+
+
+  // Tests for SphericalLight class
+
+  void testSphericalLight_Illuminate( void )
+  {
+    // sphere of radius 1 at distance 10: all samples should lie within the cone
+    // the sphere subtends, and land on its near surface
+    Color c = Color(1.0, 0.5, 0.5);
+    Point lightPos = Point(0.0, 10.0, 0.0);
+    SphericalLight thisSphereLight = SphericalLight(lightPos, 1.0, c, 2.0, 10);
+    Point p_hit = Point(0.0, 0.0, 0.0);
+    Vector dirFromLight;
+    Color lightIntens;
+    float distance;
+    float cosThetaMax = sqrtf(1.0 - 1.0/100.0);
+
+    init_genrand(100);
+    for (int i = 0; i < 1000; i++) {
+      thisSphereLight.Illuminate(p_hit, dirFromLight, lightIntens, distance);
+      TS_ASSERT( Dot(-dirFromLight, Vector(0.0, 1.0, 0.0)) >= cosThetaMax - 1.0e-6 );
+      Point lightPoint = p_hit - dirFromLight*distance;
+      TS_ASSERT_DELTA( (lightPoint - lightPos).Length(), 1.0, 1.0e-3 );
+      TS_ASSERT( lightPoint.y < 10.0 );
+      TS_ASSERT_DELTA( lightIntens.r, 2.0, 1.0e-6 );
+    }
   }
 
+  // Tests for EnvironmentLight class
+
+  void testEnvironmentLight_ConstantEnvironment( void )
+  {
+    // uniform environment with radiance = 1: irradiance on a surface = pi, and
+    // samples should be (approximately) uniformly distributed over the sphere
+    shared_ptr<Environment> env = make_shared<Environment>(Color(1.0));
+    EnvironmentLight thisEnvLight = EnvironmentLight(env, 1.0, 16);
+    Point p_hit = Point(0.0, 0.0, 0.0);
+    Vector normal = Vector(0.0, 1.0, 0.0);
+    Vector dirFromLight;
+    Color lightIntens;
+    float distance;
+    
+    TS_ASSERT_EQUALS( thisEnvLight.lightType, LIGHT_ENVIRONMENT );
+    TS_ASSERT_EQUALS( thisEnvLight.NSamples(), 16 );
+    thisEnvLight.BuildDistribution();
+    init_genrand(100);
+    int nSamples = 200000;
+    int nAbove = 0;
+    double irradiance = 0.0;
+    for (int i = 0; i < nSamples; i++) {
+      thisEnvLight.Illuminate(p_hit, dirFromLight, lightIntens, distance);
+      TS_ASSERT_DELTA( dirFromLight.Length(), 1.0, 1.0e-5 );
+      float cosTheta = Dot(normal, -dirFromLight);
+      if (cosTheta > 0) {
+        irradiance += lightIntens.r * cosTheta;
+        nAbove++;
+      }
+    }
+    TS_ASSERT_EQUALS( distance, kInfinity );
+    TS_ASSERT_DELTA( irradiance / nSamples, PI, 0.02*PI );
+    TS_ASSERT_DELTA( (float)nAbove / nSamples, 0.5, 0.01 );
+  }
+
+  void testEnvironmentLight_BlackEnvironment( void )
+  {
+    shared_ptr<Environment> env = make_shared<Environment>(Color(0.0));
+    EnvironmentLight thisEnvLight = EnvironmentLight(env, 1.0);
+    Vector dirFromLight;
+    Color lightIntens;
+    float distance;
+    
+    thisEnvLight.BuildDistribution();
+    thisEnvLight.Illuminate(Point(0.0, 0.0, 0.0), dirFromLight, lightIntens, distance);
+    TS_ASSERT_EQUALS( lightIntens.r, 0.0 );
+    TS_ASSERT_EQUALS( lightIntens.g, 0.0 );
+  }
 };
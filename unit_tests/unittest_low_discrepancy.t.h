@@ -0,0 +1,77 @@
+// Unit tests for code in low_discrepancy.cpp
+
+#include <cxxtest/TestSuite.h>
+
+#include <stdint.h>
+#include <vector>
+#include "low_discrepancy.h"
+
+using namespace std;
+
+
+class NewTestSuite : public CxxTest::TestSuite 
+{
+public:
+
+  void testReverseBits( void )
+  {
+    TS_ASSERT_EQUALS( ReverseBits(0u), 0u );
+    TS_ASSERT_EQUALS( ReverseBits(1u), 0x80000000u );
+    TS_ASSERT_EQUALS( ReverseBits(0x80000000u), 1u );
+    TS_ASSERT_EQUALS( ReverseBits(0x0000000fu), 0xf0000000u );
+    TS_ASSERT_EQUALS( ReverseBits(ReverseBits(0x12345678u)), 0x12345678u );
+  }
+
+  void testBitsToUnitFloat( void )
+  {
+    TS_ASSERT_EQUALS( BitsToUnitFloat(0u), 0.0f );
+    TS_ASSERT_EQUALS( BitsToUnitFloat(0x80000000u), 0.5f );
+    TS_ASSERT( BitsToUnitFloat(0xffffffffu) < 1.0f );
+  }
+
+  void testHashes_Deterministic( void )
+  {
+    TS_ASSERT_EQUALS( PCGHash(12345u), PCGHash(12345u) );
+    TS_ASSERT_DIFFERS( PCGHash(12345u), PCGHash(12346u) );
+    TS_ASSERT_EQUALS( HashCombine(1u, 2u), HashCombine(1u, 2u) );
+    // order of combination matters (so pixel (x,y) differs from pixel (y,x))
+    TS_ASSERT_DIFFERS( HashCombine(PCGHash(3u), 7u), HashCombine(PCGHash(7u), 3u) );
+  }
+
+  void testSobolOwen2D_Deterministic( void )
+  {
+    float  u1, v1, u2, v2;
+    SobolOwen2D(5, 42u, &u1, &v1);
+    SobolOwen2D(5, 42u, &u2, &v2);
+    TS_ASSERT_EQUALS( u1, u2 );
+    TS_ASSERT_EQUALS( v1, v2 );
+    // different seeds should give different points
+    SobolOwen2D(5, 43u, &u2, &v2);
+    TS_ASSERT( (u1 != u2) || (v1 != v2) );
+  }
+
+  void testSobolOwen2D_Stratification( void )
+  {
+    // The first 16 points (for any seed) should have exactly one point in each
+    // of the 1/16 x 1 strata, each of the 1 x 1/16 strata, and each cell of
+    // the 4 x 4 grid
+    const int  nPoints = 16;
+    for (uint32_t seed = 0; seed < 10; seed++) {
+      vector<int>  uStrata(nPoints, 0), vStrata(nPoints, 0), grid(nPoints, 0);
+      for (int i = 0; i < nPoints; i++) {
+        float  u, v;
+        SobolOwen2D(i, PCGHash(seed), &u, &v);
+        TS_ASSERT( (u >= 0.0f) && (u < 1.0f) );
+        TS_ASSERT( (v >= 0.0f) && (v < 1.0f) );
+        uStrata[(int)(u*nPoints)] += 1;
+        vStrata[(int)(v*nPoints)] += 1;
+        grid[4*(int)(v*4) + (int)(u*4)] += 1;
+      }
+      for (int j = 0; j < nPoints; j++) {
+        TS_ASSERT_EQUALS( uStrata[j], 1 );
+        TS_ASSERT_EQUALS( vStrata[j], 1 );
+        TS_ASSERT_EQUALS( grid[j], 1 );
+      }
+    }
+  }
+};
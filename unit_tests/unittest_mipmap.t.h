@@ -0,0 +1,108 @@
+// Unit tests for code in mipmap.cpp
+
+#include <cxxtest/TestSuite.h>
+
+#include "color.h"
+#include "mipmap.h"
+
+
+class NewTestSuite : public CxxTest::TestSuite 
+{
+public:
+
+  void testBuild_Levels( void )
+  {
+    MipMap mipmap;
+    Color *image = new Color[4*4];
+    for (int i = 0; i < 16; i++)
+      image[i] = Color(i);
+    mipmap.Build(image, 4, 4);
+
+    TS_ASSERT_EQUALS( mipmap.NLevels(), 3 );
+    TS_ASSERT_EQUALS( mipmap.Width(1), 2 );
+    TS_ASSERT_EQUALS( mipmap.Height(1), 2 );
+    TS_ASSERT_EQUALS( mipmap.Width(2), 1 );
+    // level 1, texel (0,0) = mean of texels 0, 1, 4, 5 of level 0
+    TS_ASSERT_DELTA( mipmap.Texels(1)[0].r, 2.5, 1.0e-6 );
+    TS_ASSERT_DELTA( mipmap.Texels(1)[3].r, 12.5, 1.0e-6 );
+    // top level = mean of entire image
+    TS_ASSERT_DELTA( mipmap.Texels(2)[0].r, 7.5, 1.0e-6 );
+  }
+
+  void testBuild_NonSquare( void )
+  {
+    MipMap mipmap;
+    Color *image = new Color[5*2];
+    for (int i = 0; i < 10; i++)
+      image[i] = Color(1.0);
+    mipmap.Build(image, 5, 2);
+
+    // 5x2 --> 3x1 --> 2x1 --> 1x1
+    TS_ASSERT_EQUALS( mipmap.NLevels(), 4 );
+    TS_ASSERT_EQUALS( mipmap.Width(1), 3 );
+    TS_ASSERT_EQUALS( mipmap.Height(1), 1 );
+    TS_ASSERT_EQUALS( mipmap.Width(3), 1 );
+    TS_ASSERT_DELTA( mipmap.Texels(1)[2].g, 1.0, 1.0e-6 );
+  }
+
+  void testLookup_Constant( void )
+  {
+    MipMap mipmap;
+    Color *image = new Color[8*8];
+    for (int i = 0; i < 64; i++)
+      image[i] = Color(0.25, 0.5, 0.75);
+    mipmap.Build(image, 8, 8);
+
+    float widths[4] = {0.0, 1.0, 3.0, 100.0};
+    for (int i = 0; i < 4; i++) {
+      Color c = mipmap.Lookup(0.3, 0.7, widths[i]);
+      TS_ASSERT_DELTA( c.r, 0.25, 1.0e-6 );
+      TS_ASSERT_DELTA( c.g, 0.5, 1.0e-6 );
+      TS_ASSERT_DELTA( c.b, 0.75, 1.0e-6 );
+    }
+  }
+
+  void testLookup_Bilinear( void )
+  {
+    MipMap mipmap;
+    Color *image = new Color[2*1];
+    image[0] = Color(0.0);
+    image[1] = Color(1.0);
+    mipmap.Build(image, 2, 1);
+
+    // texel centers are at u = 0.25 and 0.75
+    TS_ASSERT_DELTA( mipmap.Lookup(0.25, 0.5, 0.0).r, 0.0, 1.0e-6 );
+    TS_ASSERT_DELTA( mipmap.Lookup(0.5, 0.5, 0.0).r, 0.5, 1.0e-6 );
+    TS_ASSERT_DELTA( mipmap.Lookup(0.75, 0.5, 0.0).r, 1.0, 1.0e-6 );
+    // very wide footprint --> mean of image
+    TS_ASSERT_DELTA( mipmap.Lookup(0.25, 0.5, 10.0).r, 0.5, 1.0e-6 );
+  }
+
+  void testLookup_WrapU( void )
+  {
+    MipMap mipmap;
+    Color *image = new Color[2*1];
+    image[0] = Color(0.0);
+    image[1] = Color(1.0);
+    mipmap.Build(image, 2, 1, MIPMAP_WRAP_U);
+
+    // halfway between last texel and (wrapped) first texel
+    TS_ASSERT_DELTA( mipmap.Lookup(1.0, 0.5, 0.0).r, 0.5, 1.0e-6 );
+    TS_ASSERT_DELTA( mipmap.Lookup(0.0, 0.5, 0.0).r, 0.5, 1.0e-6 );
+  }
+
+  void testBuild_WrapU( void )
+  {
+    MipMap mipmap, clampedMipmap;
+    Color *image = new Color[3*1];
+    Color *image2 = new Color[3*1];
+    for (int i = 0; i < 3; i++)
+      image[i] = image2[i] = Color(i);
+    mipmap.Build(image, 3, 1, MIPMAP_WRAP_U);
+    clampedMipmap.Build(image2, 3, 1);
+
+    // last texel of level 1 = mean of last and (wrapped) first texel of level 0
+    TS_ASSERT_DELTA( mipmap.Texels(1)[1].r, 1.0, 1.0e-6 );
+    TS_ASSERT_DELTA( clampedMipmap.Texels(1)[1].r, 2.0, 1.0e-6 );
+  }
+};
@@ -6,13 +6,22 @@
 #include <fstream>
 #include <vector>
 #include <string>
+#include <set>
+#include <tuple>
 #include <math.h>
 using namespace std;
 
+#include "spdlog/spdlog.h"
+#include "spdlog/sinks/null_sink.h"
+
 #include "utilities_pub.h"
 #include "definitions.h"
 #include "image_io.h"
 #include "color.h"
+#include "shapes.h"
+#include "scene.h"
+#include "option_structs.h"
+#include "render.h"
 
 const string  TEST_TINY_PNG_IMAGE("tests/tiny_image.png");
 const string  TEST_TINY_PNG_REFERENCE_IMAGE("reference/tiny_image.png");
@@ -69,4 +78,213 @@ class NewTestSuite : public CxxTest::TestSuite
     TS_ASSERT_DELTA(readImage[3].b, 0.499505, 1.0e-6);  // ignoring conversion/rounding, should be 0.5
   }
 
+
+  // Visibility-only modes (alpha mask, object IDs, depth)
+
+  void testNearestIntersection( void )
+  {
+    vector<shared_ptr<Shape>>  shapes;
+    shapes.push_back(make_shared<Sphere>(Point(0, 0, -10), 1.0));
+    shapes.push_back(make_shared<Sphere>(Point(0, 0, -5), 1.0));
+    shapes.push_back(make_shared<Sphere>(Point(0, 0, 0), 1.0));   // contains ray origin
+    float  t_nearest;
+    
+    // ray starting inside shape 2 --> its far side is nearest
+    int index = NearestIntersection(shapes, Point(0), Vector(0, 0, -1), &t_nearest);
+    TS_ASSERT_EQUALS( index, 2 );
+    TS_ASSERT_DELTA( t_nearest, 1.0, 1.0e-5 );
+    // without shape 2, shape 1 is nearest
+    shapes.pop_back();
+    index = NearestIntersection(shapes, Point(0), Vector(0, 0, -1), &t_nearest);
+    TS_ASSERT_EQUALS( index, 1 );
+    TS_ASSERT_DELTA( t_nearest, 4.0, 1.0e-5 );
+    // nothing along the ray
+    index = NearestIntersection(shapes, Point(0), Vector(0, 1, 0), &t_nearest);
+    TS_ASSERT_EQUALS( index, -1 );
+    TS_ASSERT_EQUALS( t_nearest, kInfinity );
+  }
+
+  void testAnyIntersection( void )
+  {
+    vector<shared_ptr<Shape>>  shapes;
+    TS_ASSERT( ! AnyIntersection(shapes, Point(0), Vector(0, 0, -1)) );
+    shapes.push_back(make_shared<Sphere>(Point(0, 0, -10), 1.0));
+    shapes.push_back(make_shared<Sphere>(Point(0, 10, 0), 1.0));
+    TS_ASSERT( AnyIntersection(shapes, Point(0), Vector(0, 0, -1)) );
+    TS_ASSERT( AnyIntersection(shapes, Point(0), Vector(0, 1, 0)) );
+    TS_ASSERT( ! AnyIntersection(shapes, Point(0), Vector(1, 0, 0)) );
+    TS_ASSERT( ! AnyIntersection(shapes, Point(0), Vector(0, 0, 1)) );
+  }
+
+  // Shadow rays and the last-occluder cache
+
+  void testTraceShadowRay_CachedOccluder( void )
+  {
+    // light straight up (+y) at distance 10; shape 1 is between the point and
+    // the light, shapes 0 and 2 are off to the side
+    vector<shared_ptr<Shape>>  shapes;
+    shapes.push_back(make_shared<Sphere>(Point(5, 5, 0), 1.0));
+    shapes.push_back(make_shared<Sphere>(Point(0, 5, 0), 1.0));
+    shapes.push_back(make_shared<Sphere>(Point(-5, 5, 0), 1.0));
+    Vector  up(0, 1, 0);
+    int  lastOccluder = -1;
+
+    // nothing cached: the full loop finds shape 1 and caches it
+    TS_ASSERT( TraceShadowRay(up, 10.0, shapes, Point(0), up, &lastOccluder, NULL, false) );
+    TS_ASSERT_EQUALS( lastOccluder, 1 );
+    // cached opaque blocker (not even in the subset being tested)
+    vector<int>  subset = {0, 2};
+    TS_ASSERT( TraceShadowRay(up, 10.0, shapes, Point(0), up, &lastOccluder, &subset, false) );
+    TS_ASSERT_EQUALS( lastOccluder, 1 );
+    // cached shape no longer blocks (point moved sideways): fall through to the
+    // full loop, which finds shape 0 and caches it
+    TS_ASSERT( TraceShadowRay(up, 10.0, shapes, Point(5, 0, 0), up, &lastOccluder, NULL, false) );
+    TS_ASSERT_EQUALS( lastOccluder, 0 );
+    // nothing blocks: the cache is left alone
+    TS_ASSERT( ! TraceShadowRay(up, 10.0, shapes, Point(10, 0, 0), up, &lastOccluder, NULL, false) );
+    TS_ASSERT_EQUALS( lastOccluder, 0 );
+    // the blocker is beyond the light
+    lastOccluder = -1;
+    TS_ASSERT( ! TraceShadowRay(up, 3.0, shapes, Point(0), up, &lastOccluder, NULL, false) );
+    TS_ASSERT_EQUALS( lastOccluder, -1 );
+  }
+
+  void testTraceShadowRay2_Translucent( void )
+  {
+    // shape 0 (translucent) is nearer the point than shape 1 (opaque); both are
+    // between the point and the light
+    vector<shared_ptr<Shape>>  shapes;
+    shapes.push_back(make_shared<Sphere>(Point(0, 3, 0), 1.0));
+    shapes.push_back(make_shared<Sphere>(Point(0, 7, 0), 1.0));
+    shared_ptr<Material>  glass = make_shared<Material>();
+    glass->translucent = true;
+    shapes[0]->SetMaterial(glass);
+    Vector  up(0, 1, 0);
+    float  attenuation;
+    int  lastOccluder = -1;
+
+    // only the opaque shape is cached
+    TS_ASSERT( TraceShadowRay2(up, 10.0, shapes, Point(0), up, &attenuation, &lastOccluder, 
+    							NULL, false) );
+    TS_ASSERT_EQUALS( lastOccluder, 1 );
+    // light between the two shapes: the cached opaque shape no longer blocks, and
+    // the translucent one doesn't, so the ray is unblocked -- and the translucent
+    // shape isn't cached
+    TS_ASSERT( ! TraceShadowRay2(up, 5.0, shapes, Point(0), up, &attenuation, &lastOccluder, 
+    							NULL, false) );
+    TS_ASSERT_EQUALS( lastOccluder, 1 );
+    lastOccluder = -1;
+    TS_ASSERT( ! TraceShadowRay2(up, 5.0, shapes, Point(0), up, &attenuation, &lastOccluder, 
+    							NULL, false) );
+    TS_ASSERT_EQUALS( lastOccluder, -1 );
+    // ... whereas TraceShadowRay treats it as opaque
+    TS_ASSERT( TraceShadowRay(up, 5.0, shapes, Point(0), up, &lastOccluder, NULL, false) );
+    TS_ASSERT_EQUALS( lastOccluder, 0 );
+  }
+
+  void testObjectIDColor( void )
+  {
+    // colors are repeatable, never black, and (almost always) distinct for
+    // different IDs -- including IDs > 255
+    TS_ASSERT_EQUALS( ObjectIDColor(300), ObjectIDColor(300) );
+    set<tuple<int, int, int>>  byteColors;
+    for (int id = 1; id <= 1000; id++) {
+      Color c = ObjectIDColor(id);
+      TS_ASSERT( (c.r >= 0.2) && (c.g >= 0.2) && (c.b >= 0.2) );
+      TS_ASSERT( (c.r <= 1.0) && (c.g <= 1.0) && (c.b <= 1.0) );
+      byteColors.insert(make_tuple((int)(255*c.r), (int)(255*c.g), (int)(255*c.b)));
+    }
+    TS_ASSERT( byteColors.size() >= 995 );
+  }
+
+  void testScaleVisibilityImage_ObjectIDs( void )
+  {
+    Color  image[4] = {Color(0), Color(1), Color(256), Color(511)};
+    ScaleVisibilityImage(image, 2, 2, OBJECT_ID_MAP);
+    TS_ASSERT_EQUALS( image[0], Color(0) );
+    TS_ASSERT_EQUALS( image[1], ObjectIDColor(1) );
+    TS_ASSERT_EQUALS( image[2], ObjectIDColor(256) );
+    TS_ASSERT_EQUALS( image[3], ObjectIDColor(511) );
+    TS_ASSERT( ! (image[2] == image[3]) );
+  }
+
+  void testScaleVisibilityImage_Depth( void )
+  {
+    // depths are divided by the largest depth; no intersection = white
+    Color  image[4] = {Color(2.0), Color(4.0), Color(1.0), Color(kInfinity)};
+    ScaleVisibilityImage(image, 2, 2, DEPTH_MAP);
+    TS_ASSERT_DELTA( image[0].r, 0.5, 1.0e-6 );
+    TS_ASSERT_DELTA( image[1].r, 1.0, 1.0e-6 );
+    TS_ASSERT_DELTA( image[2].g, 0.25, 1.0e-6 );
+    TS_ASSERT_EQUALS( image[3], Color(1) );
+  }
+
+  void testRenderImage_VisibilityModes( void )
+  {
+    // big sphere (index 0) at z = -10, small sphere (index 1) in front of it; the
+    // central pixel sees the small sphere, the pixel above it sees the big one, and
+    // the corner pixel sees nothing
+    if (! spdlog::get("rt_logger"))
+      spdlog::null_logger_mt("rt_logger");
+    shared_ptr<Scene> scene = make_shared<Scene>();
+    scene->AddSphere(Point(0, 0, -10), 1.0);
+    scene->AddSphere(Point(0, 0, -5), 0.1);
+    int  nX = 9;
+    int  nY = 9;
+    int  iCenter = 4*nX + 4;
+    int  iAbove = 3*nX + 4;
+    Color  image[81];
+    traceOptions  options;
+    options.oversampling = 2;
+
+    options.mode = ALPHA_MASK;
+    RenderImage(scene, image, nX, nY, options);
+    TS_ASSERT_EQUALS( image[iCenter], Color(1) );
+    TS_ASSERT_EQUALS( image[iAbove], Color(1) );
+    TS_ASSERT_EQUALS( image[0], Color(0) );
+
+    options.mode = OBJECT_ID_MAP;
+    RenderImage(scene, image, nX, nY, options);
+    TS_ASSERT_EQUALS( image[iCenter], Color(2) );
+    TS_ASSERT_EQUALS( image[iAbove], Color(1) );
+    TS_ASSERT_EQUALS( image[0], Color(0) );
+
+    options.mode = DEPTH_MAP;
+    RenderImage(scene, image, nX, nY, options);
+    TS_ASSERT_DELTA( image[iCenter].r, 4.9, 1.0e-4 );
+    TS_ASSERT( (image[iAbove].r > 9.0) && (image[iAbove].r < 10.0) );
+    TS_ASSERT_EQUALS( image[0].r, kInfinity );
+  }
+
+  void testRenderImage_Seed( void )
+  {
+    // with a jittered sampler, the alpha mask along the edge of a sphere depends
+    // on the render seed (and only on the seed)
+    if (! spdlog::get("rt_logger"))
+      spdlog::null_logger_mt("rt_logger");
+    shared_ptr<Scene> scene = make_shared<Scene>();
+    scene->AddSphere(Point(0, 0, -10), 1.5);
+    const int  nPix = 15*15;
+    Color  image1[nPix], image2[nPix], image3[nPix];
+    traceOptions  options;
+    options.mode = ALPHA_MASK;
+    options.oversampling = 4;
+    options.samplerName = SAMPLER_UNIFORM_JITTER;
+
+    options.rngSeed = 1;
+    RenderImage(scene, image1, 15, 15, options);
+    RenderImage(scene, image2, 15, 15, options);
+    options.rngSeed = 2;
+    RenderImage(scene, image3, 15, 15, options);
+    int  nSame = 0, nDifferent = 0;
+    for (int i = 0; i < nPix; i++) {
+      if (image1[i] == image2[i])
+        nSame++;
+      if (! (image1[i] == image3[i]))
+        nDifferent++;
+    }
+    TS_ASSERT_EQUALS( nSame, nPix );
+    TS_ASSERT( nDifferent > 0 );
+  }
+
 };
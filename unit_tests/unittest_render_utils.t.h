@@ -286,4 +286,159 @@ class ComputeFresnelTestSuite : public CxxTest::TestSuite
     TS_ASSERT_DELTA( outgoing.z, 0.0, 1.0e-6 );
   }
 
+  void testUnitDisk_ConcentricSample( void )
+  {
+    Vector offset = UnitDisk_ConcentricSample(0.5, 0.5);
+    TS_ASSERT_DELTA( offset.x, 0.0, 1.0e-6 );
+    TS_ASSERT_DELTA( offset.y, 0.0, 1.0e-6 );
+    // edges of the square map to the unit circle
+    offset = UnitDisk_ConcentricSample(1.0, 0.5);
+    TS_ASSERT_DELTA( offset.x, 1.0, 1.0e-6 );
+    TS_ASSERT_DELTA( offset.y, 0.0, 1.0e-6 );
+    offset = UnitDisk_ConcentricSample(1.0, 1.0);
+    TS_ASSERT_DELTA( offset.x, 0.7071067811865476, 1.0e-6 );
+    TS_ASSERT_DELTA( offset.y, 0.7071067811865476, 1.0e-6 );
+    offset = UnitDisk_ConcentricSample(0.5, 0.0);
+    TS_ASSERT_DELTA( offset.x, 0.0, 1.0e-6 );
+    TS_ASSERT_DELTA( offset.y, -1.0, 1.0e-6 );
+    
+    // area-preserving: a quarter of a 16x16 grid of samples should fall within
+    // half the radius
+    int  nInside = 0;
+    for (int j = 0; j < 16; j++) {
+      for (int i = 0; i < 16; i++) {
+        offset = UnitDisk_ConcentricSample((i + 0.5)/16.0, (j + 0.5)/16.0);
+        TS_ASSERT( offset.x*offset.x + offset.y*offset.y < 1.0 );
+        if (offset.x*offset.x + offset.y*offset.y < 0.25)
+          nInside++;
+      }
+    }
+    TS_ASSERT_EQUALS( nInside, 64 );
+  }
+
+  void testMakePolygonTriangleCDF( void )
+  {
+    // square with vertices at (+-1, 0), (0, +-1) --> four equal triangles
+    float  vertices[8] = {1.0, 0.0, 0.0, 1.0, -1.0, 0.0, 0.0, -1.0};
+    float  cdf[5];
+    MakePolygonTriangleCDF(4, vertices, cdf);
+    TS_ASSERT_DELTA( cdf[0], 0.0, 1.0e-6 );
+    TS_ASSERT_DELTA( cdf[1], 0.25, 1.0e-6 );
+    TS_ASSERT_DELTA( cdf[2], 0.5, 1.0e-6 );
+    TS_ASSERT_DELTA( cdf[4], 1.0, 1.0e-6 );
+  }
+
+  void testUnitPolygon_Sample( void )
+  {
+    float  vertices[8] = {1.0, 0.0, 0.0, 1.0, -1.0, 0.0, 0.0, -1.0};
+    float  cdf[5];
+    MakePolygonTriangleCDF(4, vertices, cdf);
+
+    // u = 0 --> center; otherwise, inside the polygon
+    Vector offset = UnitPolygon_Sample(0.0, 0.3, 4, vertices, cdf);
+    TS_ASSERT_DELTA( offset.x, 0.0, 1.0e-6 );
+    TS_ASSERT_DELTA( offset.y, 0.0, 1.0e-6 );
+    // top of the first triangle's range --> its outer edge
+    offset = UnitPolygon_Sample(0.2499999, 0.5, 4, vertices, cdf);
+    TS_ASSERT_DELTA( offset.x, 0.5, 1.0e-4 );
+    TS_ASSERT_DELTA( offset.y, 0.5, 1.0e-4 );
+    for (int j = 0; j < 16; j++) {
+      for (int i = 0; i < 16; i++) {
+        offset = UnitPolygon_Sample((i + 0.5)/16.0, (j + 0.5)/16.0, 4, vertices, cdf);
+        TS_ASSERT( InsidePolygon(offset.x, offset.y, 4, vertices) );
+      }
+    }
+  }
+
+  void testSphereOverlapsCone( void )
+  {
+    // cone along +z with 45-degree half-angle, out to distance 10
+    Point  apex(0,0,0);
+    Vector  axis(0,0,1);
+    float  c = 0.7071067811865476;
+
+    // on the axis; beyond the far end; behind the apex
+    TS_ASSERT( SphereOverlapsCone(Point(0,0,5), 1.0, apex, axis, c, c, 10.0) );
+    TS_ASSERT( ! SphereOverlapsCone(Point(0,0,12), 1.0, apex, axis, c, c, 10.0) );
+    TS_ASSERT( ! SphereOverlapsCone(Point(0,0,-2), 1.0, apex, axis, c, c, 10.0) );
+    // apex inside the sphere
+    TS_ASSERT( SphereOverlapsCone(Point(0,0,-0.5), 1.0, apex, axis, c, c, 10.0) );
+    // off to the side: distance from center (5,0,2) to the cone surface is
+    // 3/sqrt(2) = 2.12
+    TS_ASSERT( ! SphereOverlapsCone(Point(5,0,2), 2.0, apex, axis, c, c, 10.0) );
+    TS_ASSERT( SphereOverlapsCone(Point(5,0,2), 2.2, apex, axis, c, c, 10.0) );
+  }
+
+  void testSphereBlocksCone( void )
+  {
+    // narrow cone along +z (sin(angle) = 0.1)
+    Point  apex(0,0,0);
+    Vector  axis(0,0,1);
+    float  s = 0.1;
+    float  c = sqrtf(1.0 - s*s);
+
+    // sphere on the axis subtends a larger angle than the cone
+    TS_ASSERT( SphereBlocksCone(Point(0,0,5), 1.0, apex, axis, c, s, 10.0) );
+    // ... but not if it's farther than minDistance
+    TS_ASSERT( ! SphereBlocksCone(Point(0,0,5), 1.0, apex, axis, c, s, 4.0) );
+    // too small to cover the cone
+    TS_ASSERT( ! SphereBlocksCone(Point(0,0,5), 0.4, apex, axis, c, s, 10.0) );
+    // off-axis, covering only part of the cone
+    TS_ASSERT( ! SphereBlocksCone(Point(0.8,0,5), 1.0, apex, axis, c, s, 10.0) );
+    // apex inside the sphere
+    TS_ASSERT( ! SphereBlocksCone(Point(0,0,0.5), 1.0, apex, axis, c, s, 10.0) );
+  }
+
+
+  void testLightSampleRange_PerRay( void )
+  {
+    int  first, end, step;
+    float  weight;
+    // each ray traces all nSamples samples, continuing the same sequence
+    LightSampleRange(4, 2, 8, false, 12345, &first, &end, &step, &weight);
+    TS_ASSERT_EQUALS( first, 8 );
+    TS_ASSERT_EQUALS( end, 12 );
+    TS_ASSERT_EQUALS( step, 1 );
+    TS_ASSERT_DELTA( weight, 0.25, 1.0e-6 );
+    // a single sample is always per ray, even with a per-pixel budget
+    LightSampleRange(1, 3, 8, true, 12345, &first, &end, &step, &weight);
+    TS_ASSERT_EQUALS( first, 3 );
+    TS_ASSERT_EQUALS( end, 4 );
+    TS_ASSERT_DELTA( weight, 1.0, 1.0e-6 );
+  }
+
+  void testLightSampleRange_PerPixel( void )
+  {
+    // over the N rays of a pixel, each sample index 0 ... nSamples-1 must be used
+    // exactly once, for fewer samples than rays and for more, and for shifts which
+    // would overflow if added to the ray index
+    int  nSubsamplesList[3] = {4, 9, 16};
+    int  nSamplesList[4] = {2, 5, 16, 37};
+    uint32_t  shifts[4] = {0, 7, 0x7fffffff, 0xffffffff};
+    int  first, end, step;
+    float  weight;
+    for (int N : nSubsamplesList) {
+      for (int nSamples : nSamplesList) {
+        for (uint32_t shift : shifts) {
+          vector<int>  timesUsed(nSamples, 0);
+          int  nOutOfRange = 0;
+          for (int s = 0; s < N; s++) {
+            LightSampleRange(nSamples, s, N, true, shift, &first, &end, &step, &weight);
+            TS_ASSERT_EQUALS( step, N );
+            TS_ASSERT_DELTA( weight, (float)N / nSamples, 1.0e-6 );
+            for (int k = first; k < end; k += step) {
+              if ((k < 0) || (k >= nSamples))
+                nOutOfRange++;
+              else
+                timesUsed[k]++;
+            }
+          }
+          TS_ASSERT_EQUALS( nOutOfRange, 0 );
+          for (int k = 0; k < nSamples; k++)
+            TS_ASSERT_EQUALS( timesUsed[k], 1 );
+        }
+      }
+    }
+  }
+
 };
@@ -0,0 +1,146 @@
+// Unit tests for light linking and shadow-caster lists (scene.h), and for the
+// scene-file attributes which control them (scenefile_parser.cpp)
+
+#include <cxxtest/TestSuite.h>
+
+#include <vector>
+#include <string>
+#include <memory>
+using namespace std;
+
+#include "definitions.h"
+#include "geometry.h"
+#include "color.h"
+#include "shapes.h"
+#include "lights.h"
+#include "scene.h"
+#include "scenefile_parser.h"
+
+
+class NewTestSuite : public CxxTest::TestSuite 
+{
+public:
+
+  void testSetShapeAttributes_CastShadows( void )
+  {
+    shared_ptr<Scene> scene = make_shared<Scene>();
+    AddSphereToScene(YAML::Load("{position: [0, 0, 0], radius: 1.0}"), scene, 0);
+    AddSphereToScene(YAML::Load("{position: [0, 0, 0], radius: 1.0, cast_shadows: false}"), 
+    					scene, 0);
+    AddSphereToScene(YAML::Load("{position: [0, 0, 0], radius: 1.0, cast_shadows: no}"), 
+    					scene, 0);
+    AddSphereToScene(YAML::Load("{position: [0, 0, 0], radius: 1.0, cast_shadows: true}"), 
+    					scene, 0);
+    AddSphereToScene(YAML::Load("{position: [0, 0, 0], radius: 1.0, name: hero}"), scene, 0);
+
+    TS_ASSERT_EQUALS( scene->shapes[0]->castsShadows, true );
+    TS_ASSERT_EQUALS( scene->shapes[1]->castsShadows, false );
+    TS_ASSERT_EQUALS( scene->shapes[2]->castsShadows, false );
+    TS_ASSERT_EQUALS( scene->shapes[3]->castsShadows, true );
+    TS_ASSERT_EQUALS( scene->shapes[4]->name, "hero" );
+  }
+
+  void testCheckLightLinks( void )
+  {
+    shared_ptr<Scene> scene = make_shared<Scene>();
+    AddSphereToScene(YAML::Load("{position: [0, 0, 0], radius: 1.0, name: hero}"), scene, 0);
+    scene->AddPointLight(Point(0, 10, 0), Color(1), 1.0);
+    TS_ASSERT( CheckLightLinks(scene) );
+    scene->lights[0]->linkedShapeNames.push_back("hero");
+    TS_ASSERT( CheckLightLinks(scene) );
+    scene->lights[0]->linkedShapeNames.push_back("villain");
+    TS_ASSERT( ! CheckLightLinks(scene) );
+  }
+
+  void testBuildLightLinks( void )
+  {
+    Scene  scene;
+    scene.AddSphere(Point(0, 0, 0), 1.0);
+    scene.AddSphere(Point(5, 0, 0), 1.0);
+    scene.AddSphere(Point(10, 0, 0), 1.0);
+    scene.shapes[0]->name = "hero";
+    scene.shapes[2]->name = "hero";
+    scene.AddPointLight(Point(0, 10, 0), Color(1), 1.0);
+    scene.AddPointLight(Point(5, 10, 0), Color(1), 1.0);
+
+    // no links --> every light illuminates every shape
+    scene.BuildLightLinks();
+    TS_ASSERT( scene.LightsForShape(1) == NULL );
+    TS_ASSERT( scene.LightIlluminatesShape(0, 1) );
+
+    // light 0 linked to the shapes named "hero"; light 1 illuminates everything
+    scene.lights[0]->linkedShapeNames.push_back("hero");
+    scene.BuildLightLinks();
+    TS_ASSERT( scene.LightIlluminatesShape(0, 0) );
+    TS_ASSERT( ! scene.LightIlluminatesShape(0, 1) );
+    TS_ASSERT( scene.LightIlluminatesShape(0, 2) );
+    TS_ASSERT( scene.LightIlluminatesShape(1, 1) );
+    const vector<int> *lightsForShape = scene.LightsForShape(1);
+    TS_ASSERT( lightsForShape != NULL );
+    TS_ASSERT_EQUALS( lightsForShape->size(), 1 );
+    TS_ASSERT_EQUALS( (*lightsForShape)[0], 1 );
+    TS_ASSERT_EQUALS( scene.LightsForShape(2)->size(), 2 );
+  }
+
+  void testShadowCasters_NonCastingShapes( void )
+  {
+    Scene  scene;
+    scene.AddSphere(Point(0, 0, 0), 1.0);
+    scene.AddSphere(Point(5, 0, 0), 1.0);
+    scene.AddPointLight(Point(0, 10, 0), Color(1), 1.0);
+
+    // all shapes cast shadows --> no list needed
+    scene.BuildShadowCasterLists();
+    TS_ASSERT( scene.ShadowCasters(0) == NULL );
+
+    scene.shapes[0]->castsShadows = false;
+    scene.BuildShadowCasterLists();
+    const vector<int> *casters = scene.ShadowCasters(0);
+    TS_ASSERT( casters != NULL );
+    TS_ASSERT_EQUALS( casters->size(), 1 );
+    TS_ASSERT_EQUALS( (*casters)[0], 1 );
+  }
+
+  void testShadowCasters_InfluenceRadius( void )
+  {
+    // point light at y = 10 with influence radius 5: only the sphere overlapping
+    // the sphere of influence can cast shadows
+    Scene  scene;
+    scene.AddSphere(Point(0, 7, 0), 1.0);
+    scene.AddSphere(Point(20, 0, 0), 1.0);
+    scene.AddSphere(Point(0, 4.5, 0), 1.0);   // overlaps the edge of the sphere of influence
+    scene.AddPointLight(Point(0, 10, 0), Color(1), 1.0);
+    scene.AddPointLight(Point(0, 10, 0), Color(1), 1.0);
+    scene.lights[0]->influenceRadius = 5.0;
+
+    scene.BuildShadowCasterLists();
+    const vector<int> *casters = scene.ShadowCasters(0);
+    TS_ASSERT( casters != NULL );
+    TS_ASSERT_EQUALS( casters->size(), 2 );
+    TS_ASSERT_EQUALS( (*casters)[0], 0 );
+    TS_ASSERT_EQUALS( (*casters)[1], 2 );
+    // second light has unlimited influence
+    TS_ASSERT( scene.ShadowCasters(1) == NULL );
+  }
+
+  void testShadowCasters_RectLight( void )
+  {
+    // downward-facing rect light at y = 5: shapes entirely above it can't cast
+    // shadows from it (the lists are built as part of the normal scene setup)
+    Scene  scene;
+    scene.AddSphere(Point(0, 0, 0), 1.0);
+    scene.AddSphere(Point(0, 10, 0), 1.0);
+    scene.AddSphere(Point(3, 5.5, 0), 1.0);   // straddles the light's plane
+    scene.AddRectLight(Point(0, 5, 0), 2.0, 2.0, Color(1), 1.0, 1);
+    scene.AddPointLight(Point(0, 5, 0), Color(1), 1.0);
+
+    scene.PrepareForRender();
+    const vector<int> *casters = scene.ShadowCasters(0);
+    TS_ASSERT( casters != NULL );
+    TS_ASSERT_EQUALS( casters->size(), 2 );
+    TS_ASSERT_EQUALS( (*casters)[0], 0 );
+    TS_ASSERT_EQUALS( (*casters)[1], 2 );
+    // point light shines in all directions, with unlimited influence
+    TS_ASSERT( scene.ShadowCasters(1) == NULL );
+  }
+};
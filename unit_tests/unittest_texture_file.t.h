@@ -0,0 +1,233 @@
+// Unit tests for code in texture_file.cpp
+
+#include <cxxtest/TestSuite.h>
+
+#include <stdio.h>
+#include "color.h"
+#include "mipmap.h"
+#include "texture_file.h"
+
+const std::string  TEST_TEXTURE_FILE = "unit_tests/temp_texture.ptx";
+
+
+class NewTestSuite : public CxxTest::TestSuite 
+{
+public:
+
+  void testIsTextureFile( void )
+  {
+    TS_ASSERT( IsTextureFile("sky.ptx") );
+    TS_ASSERT( IsTextureFile("/some/path/sky.ptx") );
+    TS_ASSERT( ! IsTextureFile("sky.png") );
+    TS_ASSERT( ! IsTextureFile(".ptx") );
+  }
+
+  void testHalfConversion( void )
+  {
+    TS_ASSERT_EQUALS( FloatToHalf(0.0), 0x0000 );
+    TS_ASSERT_EQUALS( FloatToHalf(1.0), 0x3c00 );
+    TS_ASSERT_EQUALS( FloatToHalf(-2.0), 0xc000 );
+    TS_ASSERT_EQUALS( FloatToHalf(65504.0), 0x7bff );
+    TS_ASSERT_EQUALS( FloatToHalf(1.0e6), 0x7c00 );
+    TS_ASSERT_EQUALS( HalfToFloat(0x3c00), 1.0 );
+    TS_ASSERT_EQUALS( HalfToFloat(0x3555), HalfToFloat(FloatToHalf(1.0/3.0)) );
+    // smallest denormal
+    TS_ASSERT_EQUALS( HalfToFloat(0x0001), 5.9604645e-8f );
+    TS_ASSERT_EQUALS( FloatToHalf(5.9604645e-8f), 0x0001 );
+  }
+
+  void testEncodeDecode_RGBE( void )
+  {
+    unsigned char  texel[4];
+    Color  c(0.25, 1.5, 100.0);
+
+    EncodeTexel(c, TEXEL_RGBE, texel);
+    Color  result = DecodeTexel(texel, TEXEL_RGBE);
+    // precision is relative to the largest channel
+    TS_ASSERT_DELTA( result.r, c.r, 0.5 );
+    TS_ASSERT_DELTA( result.g, c.g, 0.5 );
+    TS_ASSERT_DELTA( result.b, c.b, 0.5 );
+
+    EncodeTexel(Color(0), TEXEL_RGBE, texel);
+    result = DecodeTexel(texel, TEXEL_RGBE);
+    TS_ASSERT_EQUALS( result.r, 0.0 );
+    TS_ASSERT_EQUALS( result.b, 0.0 );
+  }
+
+  void testEncodeDecode_Half( void )
+  {
+    unsigned char  texel[8];
+    Color  c(0.25, 1.5, 100.0);
+
+    EncodeTexel(c, TEXEL_HALF, texel);
+    Color  result = DecodeTexel(texel, TEXEL_HALF);
+    TS_ASSERT_EQUALS( result.r, 0.25 );
+    TS_ASSERT_EQUALS( result.g, 1.5 );
+    TS_ASSERT_EQUALS( result.b, 100.0 );
+  }
+
+  void testWriteAndOpen( void )
+  {
+    MipMap  mipmap, fileMipmap;
+    // 5x3 image with tile size = 2 --> partial tiles at edges
+    Color *image = new Color[5*3];
+    for (int i = 0; i < 15; i++)
+      image[i] = Color(i, 0.5*i, 1.0);
+    mipmap.Build(image, 5, 3, MIPMAP_WRAP_U);
+
+    TS_ASSERT( WriteTextureFile(TEST_TEXTURE_FILE, mipmap, TEXEL_HALF, 2) );
+    TS_ASSERT( fileMipmap.OpenTextureFile(TEST_TEXTURE_FILE, MIPMAP_WRAP_U) );
+    TS_ASSERT_EQUALS( fileMipmap.NLevels(), mipmap.NLevels() );
+    TS_ASSERT_EQUALS( fileMipmap.Width(0), 5 );
+    TS_ASSERT_EQUALS( fileMipmap.Height(0), 3 );
+    TS_ASSERT( fileMipmap.Texels(0) == NULL );
+
+    // all of these values are exactly representable as halfs
+    float  uvPairs[4][2] = {{0.1, 0.1}, {0.5, 0.5}, {0.9, 0.833333}, {0.0, 0.0}};
+    for (int n = 0; n < 4; n++) {
+      float  u = uvPairs[n][0];
+      float  v = uvPairs[n][1];
+      for (int level = 0; level < mipmap.NLevels(); level++) {
+        Color  c1 = mipmap.Bilinear(level, u, v);
+        Color  c2 = fileMipmap.Bilinear(level, u, v);
+        TS_ASSERT_DELTA( c2.r, c1.r, 1.0e-5 );
+        TS_ASSERT_DELTA( c2.g, c1.g, 1.0e-5 );
+      }
+    }
+    remove(TEST_TEXTURE_FILE.c_str());
+  }
+
+  void testWriteAndOpen_WrapMode( void )
+  {
+    MipMap  wrapMipmap, clampMipmap, fileMipmap1, fileMipmap2;
+    Color *image1 = new Color[3*2];
+    Color *image2 = new Color[3*2];
+    for (int i = 0; i < 6; i++)
+      image1[i] = image2[i] = Color(i);
+    wrapMipmap.Build(image1, 3, 2, MIPMAP_WRAP_U);
+    clampMipmap.Build(image2, 3, 2, MIPMAP_CLAMP);
+
+    // wrap mode is stored in the file, so lookups wrap even if the caller
+    // doesn't ask for it
+    TS_ASSERT( WriteTextureFile(TEST_TEXTURE_FILE, wrapMipmap, TEXEL_HALF, 2) );
+    TS_ASSERT( fileMipmap1.OpenTextureFile(TEST_TEXTURE_FILE, MIPMAP_CLAMP) );
+    TS_ASSERT_EQUALS( fileMipmap1.WrapMode(), MIPMAP_WRAP_U );
+    TS_ASSERT_DELTA( fileMipmap1.Bilinear(1, 0.0, 0.5).r, wrapMipmap.Bilinear(1, 0.0, 0.5).r, 1.0e-5 );
+    TS_ASSERT( WriteTextureFile(TEST_TEXTURE_FILE, clampMipmap, TEXEL_HALF, 2) );
+    TS_ASSERT( fileMipmap2.OpenTextureFile(TEST_TEXTURE_FILE, MIPMAP_CLAMP) );
+    TS_ASSERT_EQUALS( fileMipmap2.WrapMode(), MIPMAP_CLAMP );
+    remove(TEST_TEXTURE_FILE.c_str());
+  }
+
+  void testOpen_BadEncoding( void )
+  {
+    MipMap  mipmap, fileMipmap;
+    textureFileHeader  header;
+    Color *image = new Color[2*2];
+    for (int i = 0; i < 4; i++)
+      image[i] = Color(1.0);
+    mipmap.Build(image, 2, 2);
+    TS_ASSERT( WriteTextureFile(TEST_TEXTURE_FILE, mipmap, TEXEL_RGBE, 2) );
+
+    // overwrite the header with an unknown encoding
+    FILE *textureFile = fopen(TEST_TEXTURE_FILE.c_str(), "r+b");
+    TS_ASSERT( fread(&header, sizeof(header), 1, textureFile) == 1 );
+    header.encoding = 7;
+    fseek(textureFile, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, textureFile);
+    fclose(textureFile);
+    TS_ASSERT( ! fileMipmap.OpenTextureFile(TEST_TEXTURE_FILE) );
+    remove(TEST_TEXTURE_FILE.c_str());
+  }
+
+  // writes a valid 4x4 texture file, then overwrites one header field
+  void WriteCorruptedFile( int32_t *field, int32_t value, textureFileHeader &header )
+  {
+    MipMap  mipmap;
+    Color *image = new Color[4*4];
+    for (int i = 0; i < 16; i++)
+      image[i] = Color(1.0);
+    mipmap.Build(image, 4, 4);
+    TS_ASSERT( WriteTextureFile(TEST_TEXTURE_FILE, mipmap, TEXEL_RGBE, 2) );
+
+    FILE *textureFile = fopen(TEST_TEXTURE_FILE.c_str(), "r+b");
+    TS_ASSERT( fread(&header, sizeof(header), 1, textureFile) == 1 );
+    *field = value;
+    fseek(textureFile, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, textureFile);
+    fclose(textureFile);
+  }
+
+  void testOpen_BadLevelSizes( void )
+  {
+    MipMap  fileMipmap1, fileMipmap2, fileMipmap3, fileMipmap4;
+    textureFileHeader  header;
+
+    WriteCorruptedFile(&header.levelWidths[0], 0, header);
+    TS_ASSERT( ! fileMipmap1.OpenTextureFile(TEST_TEXTURE_FILE) );
+    WriteCorruptedFile(&header.levelHeights[1], -2, header);
+    TS_ASSERT( ! fileMipmap2.OpenTextureFile(TEST_TEXTURE_FILE) );
+    // level 1 of a 4x4 pyramid must be 2x2
+    WriteCorruptedFile(&header.levelWidths[1], 3, header);
+    TS_ASSERT( ! fileMipmap3.OpenTextureFile(TEST_TEXTURE_FILE) );
+    TS_ASSERT_EQUALS( fileMipmap3.NLevels(), 0 );
+    WriteCorruptedFile(&header.tileSize, MAX_TILE_SIZE + 1, header);
+    TS_ASSERT( ! fileMipmap4.OpenTextureFile(TEST_TEXTURE_FILE) );
+    remove(TEST_TEXTURE_FILE.c_str());
+  }
+
+  void testOpen_BadLevelOffset( void )
+  {
+    MipMap  mipmap, fileMipmap1, fileMipmap2, fileMipmap3;
+    textureFileHeader  header;
+    Color *image = new Color[4*4];
+    for (int i = 0; i < 16; i++)
+      image[i] = Color(1.0);
+    mipmap.Build(image, 4, 4);
+    TS_ASSERT( WriteTextureFile(TEST_TEXTURE_FILE, mipmap, TEXEL_RGBE, 2) );
+    FILE *textureFile = fopen(TEST_TEXTURE_FILE.c_str(), "r+b");
+    TS_ASSERT( fread(&header, sizeof(header), 1, textureFile) == 1 );
+    fseek(textureFile, 0, SEEK_END);
+    int64_t  fileSize = ftell(textureFile);
+
+    // offset past the end of the file
+    header.levelOffsets[1] = fileSize + 1000000;
+    fseek(textureFile, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, textureFile);
+    fflush(textureFile);
+    TS_ASSERT( ! fileMipmap1.OpenTextureFile(TEST_TEXTURE_FILE) );
+    // negative offset
+    header.levelOffsets[1] = -64;
+    fseek(textureFile, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, textureFile);
+    fflush(textureFile);
+    TS_ASSERT( ! fileMipmap2.OpenTextureFile(TEST_TEXTURE_FILE) );
+    // offset inside the file, but the level would run past its end
+    header.levelOffsets[1] = fileSize - 4;
+    fseek(textureFile, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, textureFile);
+    fclose(textureFile);
+    TS_ASSERT( ! fileMipmap3.OpenTextureFile(TEST_TEXTURE_FILE) );
+    remove(TEST_TEXTURE_FILE.c_str());
+  }
+
+  void testWrite_FileBackedMipMap( void )
+  {
+    MipMap  mipmap, fileMipmap;
+    Color *image = new Color[2*2];
+    for (int i = 0; i < 4; i++)
+      image[i] = Color(1.0);
+    mipmap.Build(image, 2, 2);
+    TS_ASSERT( WriteTextureFile(TEST_TEXTURE_FILE, mipmap, TEXEL_RGBE, 2) );
+    TS_ASSERT( fileMipmap.OpenTextureFile(TEST_TEXTURE_FILE) );
+    TS_ASSERT( fileMipmap.Texels(0) == NULL );
+    TS_ASSERT( ! WriteTextureFile("unit_tests/temp_texture2.ptx", fileMipmap, TEXEL_RGBE, 2) );
+    remove(TEST_TEXTURE_FILE.c_str());
+  }
+
+  void testOpen_BadFile( void )
+  {
+    MipMap  mipmap;
+    TS_ASSERT( ! mipmap.OpenTextureFile("unit_tests/nonexistent_file.ptx") );
+  }
+};
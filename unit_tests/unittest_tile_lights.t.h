@@ -0,0 +1,86 @@
+// Unit tests for code in tile_lights.cpp
+
+#include <cxxtest/TestSuite.h>
+
+#include <vector>
+#include <memory>
+using namespace std;
+
+#include "definitions.h"
+#include "geometry.h"
+#include "color.h"
+#include "shapes.h"
+#include "lights.h"
+#include "cameras.h"
+#include "scene.h"
+#include "tile_lights.h"
+
+
+class NewTestSuite : public CxxTest::TestSuite 
+{
+public:
+
+  void testSphereOverlapsBox( void )
+  {
+    Point  boxMin(0, 0, 0);
+    Point  boxMax(2, 2, 2);
+    // center inside the box
+    TS_ASSERT( SphereOverlapsBox(Point(1, 1, 1), 0.1, boxMin, boxMax) );
+    // box inside the sphere
+    TS_ASSERT( SphereOverlapsBox(Point(1, 1, 1), 10.0, boxMin, boxMax) );
+    // touching a face, and just missing it
+    TS_ASSERT( SphereOverlapsBox(Point(3, 1, 1), 1.0, boxMin, boxMax) );
+    TS_ASSERT( ! SphereOverlapsBox(Point(3, 1, 1), 0.99, boxMin, boxMax) );
+    // near a corner: the distance is to the corner, not to the faces
+    TS_ASSERT( ! SphereOverlapsBox(Point(3, 3, 3), 1.5, boxMin, boxMax) );
+    TS_ASSERT( SphereOverlapsBox(Point(3, 3, 3), 1.8, boxMin, boxMax) );
+    // outside along a negative axis
+    TS_ASSERT( ! SphereOverlapsBox(Point(1, -5, 1), 4.0, boxMin, boxMax) );
+  }
+
+  void testTileLightLists( void )
+  {
+    // 32x32 image = 2x2 tiles; a large sphere fills the view at depths of ~10,
+    // so the upper-left tile (0) sees x < 0, y > 0 and the upper-right tile (1)
+    // sees x > 0, y > 0
+    Scene  scene;
+    scene.AddSphere(Point(0, 0, -1000), 990.0);
+    scene.AddPointLight(Point(-3, 3, -10.5), Color(1), 1.0);   // overlaps tile 0 only
+    scene.lights[0]->influenceRadius = 1.0;
+    scene.AddPointLight(Point(3, 3, -10.5), Color(1), 1.0);    // overlaps tile 1 only
+    scene.lights[1]->influenceRadius = 1.0;
+    scene.AddPointLight(Point(0, 100, 0), Color(1), 1.0);   // unlimited influence
+    Camera  camera(90.0, 32, 32);
+    TileLightLists  tileLists(camera, 32, 32, scene.shapes, scene.lights);
+
+    TS_ASSERT_EQUALS( tileLists.NTilesX(), 2 );
+    TS_ASSERT_EQUALS( tileLists.NTilesY(), 2 );
+    TS_ASSERT_DELTA( tileLists.DepthMin(0), 10.0, 0.1 );
+    TS_ASSERT( tileLists.DepthMax(0) > tileLists.DepthMin(0) );
+    vector<int>  tile0 = tileLists.Lights(0);
+    vector<int>  tile1 = tileLists.Lights(1);
+    TS_ASSERT_EQUALS( tile0.size(), 2 );
+    TS_ASSERT_EQUALS( tile0[0], 0 );
+    TS_ASSERT_EQUALS( tile0[1], 2 );
+    TS_ASSERT_EQUALS( tile1.size(), 2 );
+    TS_ASSERT_EQUALS( tile1[0], 1 );
+    TS_ASSERT_EQUALS( tile1[1], 2 );
+    // the lower tiles only get the unlimited light
+    TS_ASSERT_EQUALS( tileLists.Lights(2).size(), 1 );
+    TS_ASSERT_EQUALS( tileLists.Lights(3).size(), 1 );
+  }
+
+  void testTileLightsForDepth( void )
+  {
+    // hits outside the tile's depth range (or without a tile list) use all lights
+    vector<int>  lights = {0, 2};
+    TS_ASSERT( TileLightsForDepth(&lights, 10.0, 12.0, 11.0) == &lights );
+    TS_ASSERT( TileLightsForDepth(&lights, 10.0, 12.0, 10.0) == &lights );
+    TS_ASSERT( TileLightsForDepth(&lights, 10.0, 12.0, 12.0) == &lights );
+    TS_ASSERT( TileLightsForDepth(&lights, 10.0, 12.0, 9.9) == NULL );
+    TS_ASSERT( TileLightsForDepth(&lights, 10.0, 12.0, 12.1) == NULL );
+    TS_ASSERT( TileLightsForDepth(NULL, 10.0, 12.0, 11.0) == NULL );
+    // a tile where the depth pre-pass hit nothing
+    TS_ASSERT( TileLightsForDepth(&lights, kInfinity, -kInfinity, 11.0) == NULL );
+  }
+};